@@ -5,8 +5,14 @@
 #include <aws/sqs/SQSErrors.h>
 #include <aws/sqs/SQSServiceClientModel.h>
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
+#include "aws/sqs/model/SendMessageBatchRequest.h"
+#include "aws/sqs/model/SendMessageBatchRequestEntry.h"
 #include "aws/sqs/model/SendMessageRequest.h"
 #include "trantor/utils/LogStream.h"
 #include "trantor/utils/Logger.h"
@@ -18,20 +24,78 @@ class AsyncCallerContext;
 }  // namespace Aws
 
 namespace delivery {
+struct AwsSqsClient::PendingSends {
+  void start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++sends;
+  }
+
+  void finish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--sends == 0) {
+      done.notify_all();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t sends = 0;
+};
+
 void AwsSqsClient::sendMessage(const std::string& message_body) const {
   Aws::SQS::Model::SendMessageRequest req;
   req.SetMessageBody(message_body);
   req.SetQueueUrl(url_);
 
+  pending_sends_->start();
   client_.SendMessageAsync(
-      req,
-      [](const Aws::SQS::SQSClient*, const Aws::SQS::Model::SendMessageRequest&,
-         const Aws::SQS::Model::SendMessageOutcome& outcome,
-         const std::shared_ptr<const Aws::Client::AsyncCallerContext>&) {
+      req, [pending_sends = pending_sends_](
+               const Aws::SQS::SQSClient*,
+               const Aws::SQS::Model::SendMessageRequest&,
+               const Aws::SQS::Model::SendMessageOutcome& outcome,
+               const std::shared_ptr<const Aws::Client::AsyncCallerContext>&) {
+        if (!outcome.IsSuccess()) {
+          LOG_ERROR << "Response error from SQS: "
+                    << outcome.GetError().GetMessage();
+        }
+        pending_sends->finish();
+      });
+}
+
+void AwsSqsClient::sendMessageBatch(
+    const std::vector<std::string>& message_bodies) const {
+  Aws::SQS::Model::SendMessageBatchRequest req;
+  req.SetQueueUrl(url_);
+  // IDs only have to be unique within the batch.
+  for (size_t i = 0; i < message_bodies.size(); ++i) {
+    Aws::SQS::Model::SendMessageBatchRequestEntry entry;
+    entry.SetId(std::to_string(i));
+    entry.SetMessageBody(message_bodies[i]);
+    req.AddEntries(std::move(entry));
+  }
+
+  pending_sends_->start();
+  client_.SendMessageBatchAsync(
+      req, [pending_sends = pending_sends_](
+               const Aws::SQS::SQSClient*,
+               const Aws::SQS::Model::SendMessageBatchRequest&,
+               const Aws::SQS::Model::SendMessageBatchOutcome& outcome,
+               const std::shared_ptr<const Aws::Client::AsyncCallerContext>&) {
         if (!outcome.IsSuccess()) {
           LOG_ERROR << "Response error from SQS: "
                     << outcome.GetError().GetMessage();
+        } else {
+          for (const auto& failed : outcome.GetResult().GetFailed()) {
+            LOG_ERROR << "Failed to send SQS message: " << failed.GetMessage();
+          }
         }
+        pending_sends->finish();
       });
 }
+
+void AwsSqsClient::waitForSends() const {
+  std::unique_lock<std::mutex> lock(pending_sends_->mutex);
+  pending_sends_->done.wait(lock,
+                            [this]() { return pending_sends_->sends == 0; });
+}
 }  // namespace delivery
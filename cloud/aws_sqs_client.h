@@ -2,8 +2,10 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "execution/stages/sqs_client.h"
 
@@ -18,12 +20,21 @@ class AwsSqsClient : public SqsClient {
  public:
   explicit AwsSqsClient(
       std::pair<const Aws::SQS::SQSClient&, const std::string&> client_and_url)
-      : client_(client_and_url.first), url_(client_and_url.second) {}
+      : client_(client_and_url.first),
+        url_(client_and_url.second),
+        pending_sends_(std::make_shared<PendingSends>()) {}
 
   void sendMessage(const std::string& message_body) const override;
+  void sendMessageBatch(
+      const std::vector<std::string>& message_bodies) const override;
+  void waitForSends() const override;
 
  private:
+  struct PendingSends;
+
   const Aws::SQS::SQSClient& client_;
   const std::string& url_;
+  // Shared with the callbacks of sends in flight.
+  std::shared_ptr<PendingSends> pending_sends_;
 };
 }  // namespace delivery
@@ -7,17 +7,19 @@
 #include <aws/monitoring/model/Dimension.h>
 #include <aws/monitoring/model/MetricDatum.h>
 #include <aws/monitoring/model/StandardUnit.h>
-#include <stdint.h>
+#include <stddef.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
-#include <mutex>
+#include <string>
 #include <utility>
 
 #include "aws/monitoring/model/PutMetricDataRequest.h"
 #include "execution/stages/monitoring_client.h"
 #include "trantor/utils/LogStream.h"
 #include "trantor/utils/Logger.h"
-#include "utils/time.h"
+#include "utils/sharded_counters.h"
 
 namespace Aws {
 namespace Client {
@@ -26,21 +28,20 @@ class AsyncCallerContext;
 }  // namespace Aws
 
 namespace delivery {
-// This was ported as a constant because we haven't changed its value in over a
-// year of being a config field.
-const int batch_period_millis = 1'000 * 15;
-
 const std::string monitoring_namespace = "delivery/stats";
 
-// To reduce costs, we don't want to write data to Cloudwatch for every request.
-// This state is shared among all of these clients to safely aggregate their
-// counts and batch the writes.
-struct State {
-  std::mutex mutex;
-  MonitoringData data;
-  uint64_t next_batch_cutoff = millisForDuration();
+// Indices into the counters shared among all of these clients.
+enum MonitoringCounter : size_t {
+  writes_counter,
+  request_insertion_count_counter,
+  feature_count_counter,
+  num_monitoring_counters,
 };
-static State static_state_;
+
+ShardedCounters& sharedCounters() {
+  static ShardedCounters counters(num_monitoring_counters);
+  return counters;
+}
 
 Aws::CloudWatch::Model::MetricDatum makeBaseDatum(const std::string& platform) {
   Aws::CloudWatch::Model::MetricDatum ret;
@@ -53,51 +54,66 @@ Aws::CloudWatch::Model::MetricDatum makeBaseDatum(const std::string& platform) {
 }
 
 void CloudwatchMonitoringClient::write(const MonitoringData& data) {
-  std::unique_lock<std::mutex> guard(static_state_.mutex);
-  static_state_.data.request_insertion_count += data.request_insertion_count;
-  static_state_.data.feature_count += data.feature_count;
+  auto& counters = sharedCounters();
+  counters.add(writes_counter, 1);
+  counters.add(request_insertion_count_counter, data.request_insertion_count);
+  counters.add(feature_count_counter, data.feature_count);
+}
 
-  uint64_t now = millisForDuration();
-  // If it's not time for the next batch write, settle for just aggregating
-  // counts.
-  if (now < static_state_.next_batch_cutoff) {
-    return;
+void logOutcome(const Aws::CloudWatch::Model::PutMetricDataOutcome& outcome) {
+  if (!outcome.IsSuccess()) {
+    LOG_ERROR << "Response error from Cloudwatch: "
+              << outcome.GetError().GetMessage();
   }
+}
 
-  // If it is time for the next batch write:
-  // - Steal the shared data
-  // - Iterate the cutoff time
-  // - Give up the lock before dealing with AWS
-  int request_insertion_count = 0;
-  std::swap(request_insertion_count,
-            static_state_.data.request_insertion_count);
-  int feature_count = 0;
-  std::swap(feature_count, static_state_.data.feature_count);
-  static_state_.next_batch_cutoff = now + batch_period_millis;
-  guard.unlock();
+// Returns false if there's nothing to write.
+bool makeRequest(const std::string& platform,
+                 Aws::CloudWatch::Model::PutMetricDataRequest& req) {
+  auto counts = sharedCounters().collect();
+  // Like when writes triggered the batches, nothing is written while idle.
+  // Counters are reset one at a time, so a write racing with collect() can
+  // land in some counters but not in `writes_counter`. Check them all rather
+  // than dropping those counts.
+  if (std::all_of(counts.begin(), counts.end(),
+                  [](int64_t count) { return count == 0; })) {
+    return false;
+  }
+  auto request_insertion_count = counts[request_insertion_count_counter];
+  auto feature_count = counts[feature_count_counter];
 
-  Aws::CloudWatch::Model::PutMetricDataRequest req;
   req.SetNamespace(monitoring_namespace);
   Aws::CloudWatch::Model::MetricDatum request_insertion_count_datum =
-      makeBaseDatum(platform_);
+      makeBaseDatum(platform);
   request_insertion_count_datum.SetMetricName("RequestInsertionCountCpp");
   request_insertion_count_datum.SetValue(request_insertion_count);
   req.AddMetricData(std::move(request_insertion_count_datum));
   Aws::CloudWatch::Model::MetricDatum feature_count_datum =
-      makeBaseDatum(platform_);
+      makeBaseDatum(platform);
   feature_count_datum.SetMetricName("FeatureCountCpp");
   feature_count_datum.SetValue(feature_count);
   req.AddMetricData(std::move(feature_count_datum));
+  return true;
+}
 
+void CloudwatchMonitoringClient::flush() {
+  Aws::CloudWatch::Model::PutMetricDataRequest req;
+  if (!makeRequest(platform_, req)) {
+    return;
+  }
   client_.PutMetricDataAsync(
       req, [](const Aws::CloudWatch::CloudWatchClient*,
               const Aws::CloudWatch::Model::PutMetricDataRequest&,
               const Aws::CloudWatch::Model::PutMetricDataOutcome& outcome,
               const std::shared_ptr<const Aws::Client::AsyncCallerContext>&) {
-        if (!outcome.IsSuccess()) {
-          LOG_ERROR << "Response error from Cloudwatch: "
-                    << outcome.GetError().GetMessage();
-        }
+        logOutcome(outcome);
       });
 }
+
+void CloudwatchMonitoringClient::flushAndWait() {
+  Aws::CloudWatch::Model::PutMetricDataRequest req;
+  if (makeRequest(platform_, req)) {
+    logOutcome(client_.PutMetricData(req));
+  }
+}
 }  // namespace delivery
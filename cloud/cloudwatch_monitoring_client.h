@@ -14,14 +14,29 @@ class CloudWatchClient;
 }  // namespace Aws
 
 namespace delivery {
+// To reduce costs, we don't want to write data to Cloudwatch for every request.
+// write() only aggregates data across all of these clients, and flush() writes
+// it out.
 class CloudwatchMonitoringClient : public MonitoringClient {
  public:
+  // This was ported as a constant because we haven't changed its value in over
+  // a year of being a config field.
+  static constexpr int batch_period_millis = 1'000 * 15;
+
   explicit CloudwatchMonitoringClient(Aws::CloudWatch::CloudWatchClient& client,
                                       const std::string& platform)
       : client_(client), platform_(platform) {}
 
   void write(const MonitoringData& data) override;
 
+  // Writes out what was aggregated since the last flush. This should be called
+  // every `batch_period_millis` by a single flusher, off the request path.
+  void flush();
+
+  // Like flush(), but returns once Cloudwatch has responded, such as on
+  // shutdown.
+  void flushAndWait();
+
  private:
   Aws::CloudWatch::CloudWatchClient& client_;
   const std::string& platform_;
@@ -12,7 +12,6 @@
 #include <aws/dynamodb/model/KeysAndAttributes.h>
 
 #include <algorithm>
-#include <atomic>
 #include <ext/alloc_traits.h>
 #include <map>
 #include <memory>
@@ -21,9 +20,12 @@
 
 #include "aws/dynamodb/model/BatchGetItemRequest.h"
 #include "aws/dynamodb/model/GetItemRequest.h"
+#include "drogon/HttpAppFramework.h"
 #include "execution/stages/feature_store_client.h"
+#include "trantor/net/EventLoop.h"
 #include "trantor/utils/LogStream.h"
 #include "trantor/utils/Logger.h"
+#include "utils/time.h"
 
 namespace Aws {
 namespace Client {
@@ -68,7 +70,7 @@ void DynamoDBFeatureStoreClient::read(
   req.AddKey(key_column, value);
 
   dynamodb_client_.GetItemAsync(
-      req, [key_column, cb](
+      req, [key, key_column, cb](
                const Aws::DynamoDB::DynamoDBClient*,
                const Aws::DynamoDB::Model::GetItemRequest&,
                const Aws::DynamoDB::Model::GetItemOutcome& outcome,
@@ -79,6 +81,9 @@ void DynamoDBFeatureStoreClient::read(
         } else {
           LOG_ERROR << "Response error from DynamoDB: "
                     << outcome.GetError().GetMessage();
+          // The key may exist, so don't let it be treated as missing.
+          result.key = key;
+          result.unprocessed = true;
         }
         // This request can be marked successful even if the single key being
         // requested is not found.
@@ -111,67 +116,290 @@ std::vector<FeatureStoreResult> removeEmptyKeys(
   return res;
 }
 
-void DynamoDBFeatureStoreClient::readBatch(
-    const std::string& table, const std::string& key_column,
-    const std::vector<std::string>& keys, const std::string& columns,
-    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
-  // For many keys, we will have to send multiple requests because of DynamoDB
-  // limitations.
-  size_t num_batches = numBatches(keys.size());
+std::vector<std::string> unprocessedKeys(
+    const Aws::Map<Aws::String, Aws::DynamoDB::Model::KeysAndAttributes>&
+        unprocessed,
+    const std::string& table, const std::string& key_column) {
+  std::vector<std::string> keys;
+  auto it = unprocessed.find(table);
+  if (it == unprocessed.end()) {
+    return keys;
+  }
+  keys.reserve(it->second.GetKeys().size());
+  for (const auto& key : it->second.GetKeys()) {
+    auto value = key.find(key_column);
+    if (value != key.end()) {
+      keys.emplace_back(value->second.GetS());
+    }
+  }
+  return keys;
+}
 
-  // We make a counter to share among all the requests so that the callback only
-  // happens once.
-  auto num_callbacks = std::make_shared<std::atomic<size_t>>(num_batches);
-  auto results = std::make_shared<std::vector<FeatureStoreResult>>();
-  // Can't just reserve here because the callbacks need to access by index.
-  results->resize(keys.size());
+uint64_t retryDelayMillis(int attempt) {
+  return 10 << std::min(attempt, 10);
+}
 
-  for (size_t i = 0; i < num_batches; ++i) {
-    // [start, stop)
-    size_t start_index = i * dynamodb_batch_limit;
-    size_t stop_index =
-        std::min(start_index + dynamodb_batch_limit, keys.size());
+namespace {
+bool pastDeadline(uint64_t deadline_millis, uint64_t now) {
+  return deadline_millis != 0 && now >= deadline_millis;
+}
+}  // namespace
+
+void BatchLimiter::run(uint64_t deadline_millis, std::function<void()>&& send,
+                       std::function<void()>&& expire) {
+  if (pastDeadline(deadline_millis, millisSinceEpoch())) {
+    expire();
+    return;
+  }
+  bool queue_full = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (in_flight_ < limit_) {
+      ++in_flight_;
+    } else if (queue_.size() < max_queued_) {
+      queue_.push_back({deadline_millis, std::move(send), std::move(expire)});
+      return;
+    } else {
+      queue_full = true;
+    }
+  }
+  if (queue_full) {
+    expire();
+  } else {
+    send();
+  }
+}
 
-    Aws::DynamoDB::Model::BatchGetItemRequest req;
-    Aws::DynamoDB::Model::KeysAndAttributes maps;
-    maps.SetProjectionExpression(columns);
-    for (size_t j = start_index; j < stop_index; ++j) {
-      Aws::Map<Aws::String, Aws::DynamoDB::Model::AttributeValue> map;
-      Aws::DynamoDB::Model::AttributeValue value;
-      value.SetS(keys[j]);
-      map.emplace(key_column, value);
-      maps.AddKeys(map);
+void BatchLimiter::release(bool throttled) {
+  std::vector<std::function<void()>> sends;
+  std::vector<std::function<void()>> expired;
+  const uint64_t now = millisSinceEpoch();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_flight_;
+    if (throttled) {
+      limit_ = std::max<size_t>(limit_ / 2, 1);
+    } else if (limit_ < max_in_flight_) {
+      ++limit_;
+    }
+    while (in_flight_ < limit_ && !queue_.empty()) {
+      auto queued = std::move(queue_.front());
+      queue_.pop_front();
+      if (pastDeadline(queued.deadline_millis, now)) {
+        expired.emplace_back(std::move(queued.expire));
+        continue;
+      }
+      sends.emplace_back(std::move(queued.send));
+      ++in_flight_;
     }
-    req.AddRequestItems(table, maps);
+  }
+  // These can call back into the limiter, so don't hold the lock.
+  for (auto& expire : expired) {
+    expire();
+  }
+  for (auto& send : sends) {
+    send();
+  }
+}
+
+size_t BatchLimiter::limit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return limit_;
+}
 
-    dynamodb_client_.BatchGetItemAsync(
+size_t BatchLimiter::inFlight() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return in_flight_;
+}
+
+size_t BatchLimiter::queued() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+BatchLimiter& dynamoDBBatchLimiter() {
+  static BatchLimiter limiter(dynamodb_max_in_flight_batches,
+                              dynamodb_max_queued_batches);
+  return limiter;
+}
+
+bool retryBeforeDeadline(uint64_t deadline_millis, uint64_t delay_millis) {
+  return deadline_millis == 0 ||
+         millisSinceEpoch() + delay_millis < deadline_millis;
+}
+
+void scheduleRetry(trantor::EventLoop* loop, uint64_t delay_millis,
+                   std::function<void()>&& retry) {
+  if (loop == nullptr) {
+    loop = drogon::app().getLoop();
+  }
+  loop->runAfter(static_cast<double>(delay_millis) / 1'000, std::move(retry));
+}
+
+namespace {
+// Shared by all batches of a readBatch() call. Retries can outlive the client
+// which started them, so everything they need is copied here.
+struct BatchReadState {
+  const Aws::DynamoDB::DynamoDBClient* dynamodb_client = nullptr;
+  std::string table;
+  std::string key_column;
+  std::string columns;
+  uint64_t deadline_millis = 0;
+  trantor::EventLoop* loop = nullptr;
+  std::function<void(std::vector<FeatureStoreResult>)> cb;
+
+  std::mutex mutex;
+  std::vector<FeatureStoreResult> results;
+  // Batches which haven't finished yet. A retry takes over its batch's place.
+  size_t remaining_batches = 0;
+};
+
+void sendBatch(std::shared_ptr<BatchReadState> state,
+               std::vector<std::string> keys, int attempt);
+
+void finishBatch(const std::shared_ptr<BatchReadState>& state) {
+  std::vector<FeatureStoreResult> results;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (--state->remaining_batches > 0) {
+      return;
+    }
+    results = std::move(state->results);
+  }
+  // Keys which didn't exist can come back as empty results, so we remove any
+  // such results to simplify downstream processing.
+  state->cb(removeEmptyKeys(std::move(results)));
+}
+
+// Reports `unprocessed` as such, so they aren't mistaken for missing keys.
+void finishUnprocessed(const std::shared_ptr<BatchReadState>& state,
+                       std::vector<std::string> unprocessed) {
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    for (auto& key : unprocessed) {
+      auto& result = state->results.emplace_back();
+      result.key = std::move(key);
+      result.unprocessed = true;
+    }
+  }
+  finishBatch(state);
+}
+
+// Retries `unprocessed` if there's time left before the deadline. Otherwise,
+// reports them as unprocessed.
+void retryOrFinishBatch(const std::shared_ptr<BatchReadState>& state,
+                        std::vector<std::string> unprocessed, int attempt,
+                        bool retryable) {
+  if (unprocessed.empty()) {
+    finishBatch(state);
+    return;
+  }
+  uint64_t delay = retryDelayMillis(attempt);
+  if (retryable && retryBeforeDeadline(state->deadline_millis, delay)) {
+    scheduleRetry(state->loop, delay,
+                  [state, keys = std::move(unprocessed), attempt]() {
+                    sendBatch(state, keys, attempt + 1);
+                  });
+    return;
+  }
+  finishUnprocessed(state, std::move(unprocessed));
+}
+
+void sendBatch(std::shared_ptr<BatchReadState> state,
+               std::vector<std::string> keys, int attempt) {
+  Aws::DynamoDB::Model::BatchGetItemRequest req;
+  Aws::DynamoDB::Model::KeysAndAttributes maps;
+  maps.SetProjectionExpression(state->columns);
+  for (const auto& key : keys) {
+    Aws::Map<Aws::String, Aws::DynamoDB::Model::AttributeValue> map;
+    Aws::DynamoDB::Model::AttributeValue value;
+    value.SetS(key);
+    map.emplace(state->key_column, value);
+    maps.AddKeys(map);
+  }
+  req.AddRequestItems(state->table, maps);
+
+  // Batches which can't be sent in time are reported as unprocessed.
+  auto expire = [state, keys]() { finishUnprocessed(state, keys); };
+  auto send = [state, req, keys, attempt]() {
+    state->dynamodb_client->BatchGetItemAsync(
         req,
-        [table, key_column, results, start_index, num_callbacks, cb](
+        [state, keys, attempt](
             const Aws::DynamoDB::DynamoDBClient*,
             const Aws::DynamoDB::Model::BatchGetItemRequest&,
             const Aws::DynamoDB::Model::BatchGetItemOutcome& outcome,
             const std::shared_ptr<const Aws::Client::AsyncCallerContext>&) {
-          if (outcome.IsSuccess()) {
-            // We can receive less than we requested if any of the IDs did not
-            // exist.
-            const Aws::Vector<
-                Aws::Map<Aws::String, Aws::DynamoDB::Model::AttributeValue>>&
-                responses = outcome.GetResult().GetResponses().at(table);
-            for (size_t k = 0; k < responses.size(); ++k) {
-              (*results)[start_index + k] =
-                  processAttributes(key_column, responses[k]);
-            }
-          } else {
+          if (!outcome.IsSuccess()) {
             LOG_ERROR << "Response error from DynamoDB: "
                       << outcome.GetError().GetMessage();
+            auto error_type = outcome.GetError().GetErrorType();
+            bool throttled =
+                error_type == Aws::DynamoDB::DynamoDBErrors::
+                                  PROVISIONED_THROUGHPUT_EXCEEDED ||
+                error_type == Aws::DynamoDB::DynamoDBErrors::THROTTLING;
+            dynamoDBBatchLimiter().release(throttled);
+            retryOrFinishBatch(state, keys, attempt, throttled);
+            return;
           }
-          if (--(*num_callbacks) == 0) {
-            // Since we allocated enough results for all of the expected keys
-            // but some might not have existed, we remove any such results to
-            // simplify downstream processing.
-            cb(removeEmptyKeys(std::move(*results)));
+          const auto& result = outcome.GetResult();
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            // We can receive less than we requested if any of the IDs did not
+            // exist.
+            auto responses = result.GetResponses().find(state->table);
+            if (responses != result.GetResponses().end()) {
+              for (const auto& response : responses->second) {
+                state->results.emplace_back(
+                    processAttributes(state->key_column, response));
+              }
+            }
           }
+          // DynamoDB returns keys it didn't get to, such as when throttled,
+          // instead of failing the whole batch.
+          auto unprocessed = unprocessedKeys(result.GetUnprocessedKeys(),
+                                             state->table, state->key_column);
+          dynamoDBBatchLimiter().release(!unprocessed.empty());
+          retryOrFinishBatch(state, std::move(unprocessed), attempt,
+                             /*retryable=*/true);
         });
+  };
+  dynamoDBBatchLimiter().run(state->deadline_millis, std::move(send),
+                             std::move(expire));
+}
+}  // namespace
+
+void DynamoDBFeatureStoreClient::readBatch(
+    const std::string& table, const std::string& key_column,
+    const std::vector<std::string>& keys, const std::string& columns,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
+  // For many keys, we will have to send multiple requests because of DynamoDB
+  // limitations.
+  size_t num_batches = numBatches(keys.size());
+  if (num_batches == 0) {
+    cb({});
+    return;
+  }
+
+  auto state = std::make_shared<BatchReadState>();
+  state->dynamodb_client = &dynamodb_client_;
+  state->table = table;
+  state->key_column = key_column;
+  state->columns = columns;
+  state->deadline_millis = deadline_millis_;
+  state->loop = loop_;
+  state->cb = std::move(cb);
+  state->results.reserve(keys.size());
+  state->remaining_batches = num_batches;
+
+  for (size_t i = 0; i < num_batches; ++i) {
+    // [start, stop)
+    size_t start_index = i * dynamodb_batch_limit;
+    size_t stop_index =
+        std::min(start_index + dynamodb_batch_limit, keys.size());
+    sendBatch(state,
+              std::vector<std::string>(keys.begin() + start_index,
+                                       keys.begin() + stop_index),
+              /*attempt=*/0);
   }
 }
 }  // namespace delivery
@@ -8,18 +8,25 @@
 #include <aws/core/utils/memory/stl/AWSString.h>
 #include <stddef.h>
 
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "execution/stages/feature_store_client.h"
 
+namespace trantor {
+class EventLoop;
+}
 namespace Aws {
 namespace DynamoDB {
 class DynamoDBClient;
 namespace Model {
 class AttributeValue;
-}
+class KeysAndAttributes;
+}  // namespace Model
 }  // namespace DynamoDB
 }  // namespace Aws
 
@@ -27,12 +34,62 @@ namespace delivery {
 // DynamoDB has a hard limit of 100 items per batch request:
 // https://docs.aws.amazon.com/amazondynamodb/latest/APIReference/API_BatchGetItem.html
 const int dynamodb_batch_limit = 100;
+// The most batch requests which may be in flight at once in this process.
+const size_t dynamodb_max_in_flight_batches = 64;
+// The most batch requests which may wait for a slot at once in this process.
+const size_t dynamodb_max_queued_batches = 256;
+
+// Caps how many batch requests are in flight across the process. The cap
+// halves whenever DynamoDB throttles and grows by one per unthrottled batch, so
+// fan-out backs off under throttling instead of making it worse.
+class BatchLimiter {
+ public:
+  BatchLimiter(size_t max_in_flight, size_t max_queued)
+      : max_in_flight_(max_in_flight),
+        max_queued_(max_queued),
+        limit_(max_in_flight) {}
+
+  // Invokes `send` now if under the cap, or else once a slot frees up. Every
+  // send must be followed by exactly one call to release(). If the queue is
+  // full, or `deadline_millis` (0 for none) passes before `send` would run,
+  // `expire` is invoked instead, since no one would wait for the result.
+  void run(uint64_t deadline_millis, std::function<void()>&& send,
+           std::function<void()>&& expire);
+  void release(bool throttled);
+
+  size_t limit();
+  size_t inFlight();
+  size_t queued();
+
+ private:
+  struct QueuedSend {
+    uint64_t deadline_millis = 0;
+    std::function<void()> send;
+    std::function<void()> expire;
+  };
+
+  const size_t max_in_flight_;
+  const size_t max_queued_;
+  std::mutex mutex_;
+  size_t limit_;
+  size_t in_flight_ = 0;
+  std::deque<QueuedSend> queue_;
+};
+
+// Shared by every DynamoDBFeatureStoreClient in the process.
+BatchLimiter& dynamoDBBatchLimiter();
 
 class DynamoDBFeatureStoreClient : public FeatureStoreClient {
  public:
+  // Unprocessed keys are retried until `deadline_millis` (0 for none), after
+  // which they are reported as unprocessed. Retries are delayed on `loop`, or
+  // on the main loop when none is given.
   explicit DynamoDBFeatureStoreClient(
-      const Aws::DynamoDB::DynamoDBClient& dynamodb_client)
-      : dynamodb_client_(dynamodb_client) {}
+      const Aws::DynamoDB::DynamoDBClient& dynamodb_client,
+      uint64_t deadline_millis = 0, trantor::EventLoop* loop = nullptr)
+      : dynamodb_client_(dynamodb_client),
+        deadline_millis_(deadline_millis),
+        loop_(loop) {}
 
   // DynamoDB is NoSQL so it doesn't really have columns. It has "attributes",
   // but we can think of them like columns.
@@ -47,6 +104,8 @@ class DynamoDBFeatureStoreClient : public FeatureStoreClient {
 
  private:
   const Aws::DynamoDB::DynamoDBClient& dynamodb_client_;
+  uint64_t deadline_millis_;
+  trantor::EventLoop* loop_;
 };
 
 // Declared here for testing.
@@ -54,6 +113,20 @@ FeatureStoreResult processAttributes(
     const std::string& key,
     const Aws::Map<Aws::String, Aws::DynamoDB::Model::AttributeValue>& map);
 size_t numBatches(size_t num_keys);
+std::vector<std::string> unprocessedKeys(
+    const Aws::Map<Aws::String, Aws::DynamoDB::Model::KeysAndAttributes>&
+        unprocessed,
+    const std::string& table, const std::string& key_column);
 std::vector<FeatureStoreResult> removeEmptyKeys(
     std::vector<FeatureStoreResult> results);
+// Exponential backoff with a 10ms base for the given 0-indexed retry.
+uint64_t retryDelayMillis(int attempt);
+// Whether a retry after `delay_millis` still lands before `deadline_millis` (0
+// for none).
+bool retryBeforeDeadline(uint64_t deadline_millis, uint64_t delay_millis);
+// Runs `retry` after `delay_millis` on `loop`, or on the main loop when no loop
+// was given. Retries are never sent right away, so DynamoDB gets a chance to
+// stop throttling.
+void scheduleRetry(trantor::EventLoop* loop, uint64_t delay_millis,
+                   std::function<void()>&& retry);
 }  // namespace delivery
@@ -43,6 +43,55 @@ void SwRedisClient::hGetAll(
       });
 }
 
+void SwRedisClient::hMGet(
+    const std::string &key, const std::vector<std::string> &fields,
+    std::function<void(std::vector<std::optional<std::string>>)> &&cb) {
+  // The command interface for a variable number of args requires us to form a
+  // container including the command itself.
+  std::vector<std::string> command_terms;
+  command_terms.reserve(2 + fields.size());
+  command_terms.emplace_back("hmget");
+  command_terms.emplace_back(key);
+  command_terms.insert(command_terms.end(), fields.begin(), fields.end());
+  client_.command<std::vector<std::optional<std::string>>>(
+      command_terms.begin(), command_terms.end(),
+      [cb](sw::redis::Future<std::vector<std::optional<std::string>>> &&fut) {
+        try {
+          cb(fut.get());
+        } catch (const sw::redis::TimeoutError &err) {
+          LOG_INFO << "Timed out during HMGET: " << err.what();
+          cb({});
+        } catch (const sw::redis::Error &err) {
+          LOG_ERROR << "Failed to HMGET: " << err.what();
+          cb({});
+        }
+      });
+}
+
+void SwRedisClient::mGet(
+    const std::vector<std::string> &keys,
+    std::function<void(std::vector<std::optional<std::string>>)> &&cb) {
+  // The command interface for a variable number of args requires us to form a
+  // container including the command itself.
+  std::vector<std::string> command_terms;
+  command_terms.reserve(1 + keys.size());
+  command_terms.emplace_back("mget");
+  command_terms.insert(command_terms.end(), keys.begin(), keys.end());
+  client_.command<std::vector<std::optional<std::string>>>(
+      command_terms.begin(), command_terms.end(),
+      [cb](sw::redis::Future<std::vector<std::optional<std::string>>> &&fut) {
+        try {
+          cb(fut.get());
+        } catch (const sw::redis::TimeoutError &err) {
+          LOG_INFO << "Timed out during MGET: " << err.what();
+          cb({});
+        } catch (const sw::redis::Error &err) {
+          LOG_ERROR << "Failed to MGET: " << err.what();
+          cb({});
+        }
+      });
+}
+
 void SwRedisClient::rPush(const std::string &key,
                           const std::vector<std::string> &values,
                           std::function<void(int64_t)> &&cb) {
@@ -84,6 +133,20 @@ void SwRedisClient::expire(const std::string &key, int64_t ttl) {
   });
 }
 
+void SwRedisClient::pSetEx(const std::string &key, int64_t ttl_millis,
+                           const std::string &value) {
+  client_.command<void>(
+      "psetex", key, ttl_millis, value, [](sw::redis::Future<void> &&fut) {
+        try {
+          fut.get();
+        } catch (const sw::redis::TimeoutError &err) {
+          LOG_INFO << "Timed out during PSETEX: " << err.what();
+        } catch (const sw::redis::Error &err) {
+          LOG_ERROR << "Failed to PSETEX: " << err.what();
+        }
+      });
+}
+
 void SwRedisClient::lTrim(const std::string &key, int64_t start, int64_t stop) {
   client_.command<void>(
       "ltrim", key, start, stop, [](sw::redis::Future<void> &&fut) {
@@ -96,4 +159,24 @@ void SwRedisClient::lTrim(const std::string &key, int64_t start, int64_t stop) {
         }
       });
 }
+
+void SwRedisClient::del(const std::vector<std::string> &keys) {
+  // The command interface for a variable number of args requires us to form a
+  // container including the command itself.
+  std::vector<std::string> command_terms;
+  command_terms.reserve(1 + keys.size());
+  command_terms.emplace_back("del");
+  command_terms.insert(command_terms.end(), keys.begin(), keys.end());
+  client_.command<long long>(  // NOLINT(google-runtime-int)
+      command_terms.begin(), command_terms.end(),
+      [](sw::redis::Future<long long> &&fut) {  // NOLINT(google-runtime-int)
+        try {
+          fut.get();
+        } catch (const sw::redis::TimeoutError &err) {
+          LOG_INFO << "Timed out during DEL: " << err.what();
+        } catch (const sw::redis::Error &err) {
+          LOG_ERROR << "Failed to DEL: " << err.what();
+        }
+      });
+}
 }  // namespace delivery
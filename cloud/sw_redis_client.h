@@ -8,6 +8,7 @@
 #include <stdint.h>
 
 #include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -28,10 +29,19 @@ class SwRedisClient : public RedisClient {
               std::function<void(std::vector<std::string>)>&& cb) override;
   void hGetAll(const std::string& key,
                std::function<void(std::vector<std::string>)>&& cb) override;
+  void hMGet(const std::string& key, const std::vector<std::string>& fields,
+             std::function<void(std::vector<std::optional<std::string>>)>&& cb)
+      override;
+  void mGet(const std::vector<std::string>& keys,
+            std::function<void(std::vector<std::optional<std::string>>)>&& cb)
+      override;
   void rPush(const std::string& key, const std::vector<std::string>& values,
              std::function<void(int64_t)>&& cb) override;
   void expire(const std::string& key, int64_t ttl) override;
+  void pSetEx(const std::string& key, int64_t ttl_millis,
+              const std::string& value) override;
   void lTrim(const std::string& key, int64_t start, int64_t stop) override;
+  void del(const std::vector<std::string>& keys) override;
 
  private:
   sw::redis::AsyncRedis& client_;
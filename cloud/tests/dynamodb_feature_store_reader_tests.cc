@@ -2,16 +2,24 @@
 #include <aws/core/utils/memory/stl/AWSMap.h>
 #include <aws/core/utils/memory/stl/AWSString.h>
 #include <aws/dynamodb/model/AttributeValue.h>
+#include <aws/dynamodb/model/KeysAndAttributes.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "cloud/dynamodb_feature_store_reader.h"
+#include "drogon/HttpAppFramework.h"
 #include "execution/stages/feature_store_client.h"
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "trantor/net/EventLoop.h"
+#include "utils/time.h"
 
 namespace delivery {
 TEST(DynamoDBFeatureStoreClientTest, ProcessAttributesEmpty) {
@@ -64,4 +72,112 @@ TEST(DynamoDBFeatureStoreClientTest, RemoveEmptyKeys) {
   EXPECT_EQ(processed[0].key, "a");
   EXPECT_EQ(processed[1].key, "c");
 }
+
+TEST(DynamoDBFeatureStoreClientTest, UnprocessedKeys) {
+  Aws::Map<Aws::String, Aws::DynamoDB::Model::KeysAndAttributes> unprocessed;
+  EXPECT_TRUE(unprocessedKeys(unprocessed, "table", "pk").empty());
+
+  Aws::DynamoDB::Model::KeysAndAttributes keys;
+  for (const std::string id : {"a", "b"}) {
+    Aws::Map<Aws::String, Aws::DynamoDB::Model::AttributeValue> key;
+    Aws::DynamoDB::Model::AttributeValue value;
+    value.SetS(id);
+    key["pk"] = value;
+    keys.AddKeys(key);
+  }
+  unprocessed["table"] = keys;
+  EXPECT_THAT(unprocessedKeys(unprocessed, "table", "pk"),
+              testing::ElementsAre("a", "b"));
+  EXPECT_TRUE(unprocessedKeys(unprocessed, "other_table", "pk").empty());
+}
+
+TEST(DynamoDBFeatureStoreClientTest, RetryDelayMillis) {
+  EXPECT_EQ(retryDelayMillis(0), 10);
+  EXPECT_EQ(retryDelayMillis(1), 20);
+  EXPECT_EQ(retryDelayMillis(3), 80);
+  // Capped so it can't overflow.
+  EXPECT_EQ(retryDelayMillis(100), retryDelayMillis(10));
+}
+
+TEST(DynamoDBFeatureStoreClientTest, RetryBeforeDeadline) {
+  EXPECT_TRUE(retryBeforeDeadline(/*deadline_millis=*/0, /*delay_millis=*/10));
+  EXPECT_TRUE(retryBeforeDeadline(millisSinceEpoch() + 1'000, 10));
+  EXPECT_FALSE(retryBeforeDeadline(millisSinceEpoch() + 5, 10));
+}
+
+// Throttled batches from a client without a loop are still retried after a
+// delay, on the main loop, rather than right away.
+TEST(DynamoDBFeatureStoreClientTest, ScheduleRetryWithoutLoop) {
+  bool retried = false;
+  const uint64_t start_millis = millisSinceEpoch();
+  uint64_t retried_millis = 0;
+  scheduleRetry(/*loop=*/nullptr, /*delay_millis=*/10,
+                [&retried, &retried_millis]() {
+                  retried = true;
+                  retried_millis = millisSinceEpoch();
+                  drogon::app().getLoop()->quit();
+                });
+  EXPECT_FALSE(retried);
+  drogon::app().getLoop()->loop();
+  EXPECT_TRUE(retried);
+  EXPECT_GT(retried_millis, start_millis);
+}
+
+TEST(DynamoDBFeatureStoreClientTest, BatchLimiter) {
+  BatchLimiter limiter(/*max_in_flight=*/4, /*max_queued=*/4);
+  int sent = 0;
+  for (int i = 0; i < 6; ++i) {
+    limiter.run(/*deadline_millis=*/0, [&sent]() { ++sent; },
+                []() { FAIL(); });
+  }
+  EXPECT_EQ(sent, 4);
+  EXPECT_EQ(limiter.inFlight(), 4);
+  EXPECT_EQ(limiter.queued(), 2);
+
+  // Throttling halves the cap, so nothing queued is sent yet.
+  limiter.release(/*throttled=*/true);
+  EXPECT_EQ(limiter.limit(), 2);
+  EXPECT_EQ(sent, 4);
+  limiter.release(/*throttled=*/true);
+  limiter.release(/*throttled=*/true);
+  EXPECT_EQ(limiter.limit(), 1);
+  EXPECT_EQ(limiter.inFlight(), 1);
+  EXPECT_EQ(sent, 4);
+
+  // Unthrottled batches grow the cap back.
+  limiter.release(/*throttled=*/false);
+  EXPECT_EQ(limiter.limit(), 2);
+  EXPECT_EQ(sent, 6);
+  EXPECT_EQ(limiter.inFlight(), 2);
+  EXPECT_EQ(limiter.queued(), 0);
+  limiter.release(/*throttled=*/false);
+  limiter.release(/*throttled=*/false);
+  EXPECT_EQ(limiter.limit(), 4);
+  EXPECT_EQ(limiter.inFlight(), 0);
+}
+
+TEST(DynamoDBFeatureStoreClientTest, BatchLimiterExpire) {
+  BatchLimiter limiter(/*max_in_flight=*/1, /*max_queued=*/1);
+  int sent = 0;
+  int expired = 0;
+  auto send = [&sent]() { ++sent; };
+  auto expire = [&expired]() { ++expired; };
+  const uint64_t deadline = millisSinceEpoch() + 20;
+  limiter.run(deadline, send, expire);
+  limiter.run(deadline, send, expire);
+  // The queue is full.
+  limiter.run(deadline, send, expire);
+  EXPECT_EQ(sent, 1);
+  EXPECT_EQ(expired, 1);
+
+  // Nothing is sent once the deadline passes, even with a free slot.
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  limiter.release(/*throttled=*/false);
+  EXPECT_EQ(sent, 1);
+  EXPECT_EQ(expired, 2);
+  EXPECT_EQ(limiter.inFlight(), 0);
+  EXPECT_EQ(limiter.queued(), 0);
+  limiter.run(deadline, send, expire);
+  EXPECT_EQ(expired, 3);
+}
 }  // namespace delivery
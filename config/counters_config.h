@@ -28,6 +28,27 @@ struct CountersCacheConfig {
   int64_t user_counts_size = 0;
   int64_t query_counts_size = 0;
   int64_t item_query_counts_size = 0;
+  // Lifetimes of cached entries per table. 0 means the default.
+  int64_t global_rates_ttl_millis = 0;
+  int64_t item_counts_ttl_millis = 0;
+  int64_t user_counts_ttl_millis = 0;
+  int64_t query_counts_ttl_millis = 0;
+  int64_t item_query_counts_ttl_millis = 0;
+  // Up to this fraction of each TTL is randomly added per entry.
+  double ttl_jitter = 0.1;
+  // Admission policies per table, "lru" or "tinyLfu". Empty means LRU.
+  std::string global_rates_admission;
+  std::string item_counts_admission;
+  std::string user_counts_admission;
+  std::string query_counts_admission;
+  std::string item_query_counts_admission;
+  // Byte limits on the approximate memory used per table, in addition to the
+  // sizes. 0 means there's no byte limit.
+  int64_t global_rates_max_bytes = 0;
+  int64_t item_counts_max_bytes = 0;
+  int64_t user_counts_max_bytes = 0;
+  int64_t query_counts_max_bytes = 0;
+  int64_t item_query_counts_max_bytes = 0;
 
   constexpr static auto properties = std::make_tuple(
       property(&CountersCacheConfig::global_rates_size, "globalRatesSize"),
@@ -35,7 +56,38 @@ struct CountersCacheConfig {
       property(&CountersCacheConfig::user_counts_size, "userCountsSize"),
       property(&CountersCacheConfig::query_counts_size, "queryCountsSize"),
       property(&CountersCacheConfig::item_query_counts_size,
-               "itemQueryCountsSize"));
+               "itemQueryCountsSize"),
+      property(&CountersCacheConfig::global_rates_ttl_millis,
+               "globalRatesTtlMillis"),
+      property(&CountersCacheConfig::item_counts_ttl_millis,
+               "itemCountsTtlMillis"),
+      property(&CountersCacheConfig::user_counts_ttl_millis,
+               "userCountsTtlMillis"),
+      property(&CountersCacheConfig::query_counts_ttl_millis,
+               "queryCountsTtlMillis"),
+      property(&CountersCacheConfig::item_query_counts_ttl_millis,
+               "itemQueryCountsTtlMillis"),
+      property(&CountersCacheConfig::ttl_jitter, "ttlJitter"),
+      property(&CountersCacheConfig::global_rates_admission,
+               "globalRatesAdmission"),
+      property(&CountersCacheConfig::item_counts_admission,
+               "itemCountsAdmission"),
+      property(&CountersCacheConfig::user_counts_admission,
+               "userCountsAdmission"),
+      property(&CountersCacheConfig::query_counts_admission,
+               "queryCountsAdmission"),
+      property(&CountersCacheConfig::item_query_counts_admission,
+               "itemQueryCountsAdmission"),
+      property(&CountersCacheConfig::global_rates_max_bytes,
+               "globalRatesMaxBytes"),
+      property(&CountersCacheConfig::item_counts_max_bytes,
+               "itemCountsMaxBytes"),
+      property(&CountersCacheConfig::user_counts_max_bytes,
+               "userCountsMaxBytes"),
+      property(&CountersCacheConfig::query_counts_max_bytes,
+               "queryCountsMaxBytes"),
+      property(&CountersCacheConfig::item_query_counts_max_bytes,
+               "itemQueryCountsMaxBytes"));
 };
 
 struct CountersConfig {
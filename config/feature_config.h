@@ -24,6 +24,12 @@ struct SparseFeaturesConfig {
   // The proportion [0, 1] of requests that will have their stranger features
   // recorded.
   double stranger_feature_sampling_rate = 0;
+  // If positive, stranger features are sent from across requests in batches
+  // at least this often, and paths which were sent in the last dedupe TTL
+  // aren't sent again. Otherwise, each sampled request sends its own.
+  uint64_t stranger_feature_batch_window_millis = 0;
+  uint64_t stranger_feature_dedupe_ttl_millis = 60 * 60 * 1'000;
+  uint64_t stranger_feature_dedupe_size = 1'000'000;
 
   // This is a list of paths to features we want to compute distribution stat
   // features around.
@@ -38,6 +44,12 @@ struct SparseFeaturesConfig {
                "featureIDQueueConfig"),
       property(&SparseFeaturesConfig::stranger_feature_sampling_rate,
                "featureIDLogSamplingRate"),
+      property(&SparseFeaturesConfig::stranger_feature_batch_window_millis,
+               "featureIDBatchWindowMillis"),
+      property(&SparseFeaturesConfig::stranger_feature_dedupe_ttl_millis,
+               "featureIDDedupeTtlMillis"),
+      property(&SparseFeaturesConfig::stranger_feature_dedupe_size,
+               "featureIDDedupeSize"),
       property(&SparseFeaturesConfig::distribution_feature_paths,
                "distributionFeaturePaths"));
 };
@@ -2,22 +2,63 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "config/json.h"
 
 namespace delivery {
+// Values for FeatureStoreConfig::backend.
+const std::string dynamodb_feature_store_backend = "dynamodb";
+const std::string redis_feature_store_backend = "redis";
+
 struct FeatureStoreConfig {
   std::string table;
   std::string primary_key;
   uint64_t type = 0;
   std::vector<std::string> feature_columns = {"features"};
+  // Where rows are read from. Redis rows are hashes of their columns.
+  std::string backend = dynamodb_feature_store_backend;
+  // Only used by the Redis backend. The timeout is in milliseconds.
+  std::string redis_url;
+  std::string redis_timeout = "50";
+  // Only used by the DynamoDB backend. Misses from concurrent requests are
+  // sent together in batches of up to `max_batch_keys` keys, waiting up to
+  // this long for a batch to fill. 0 sends each request's misses on their own.
+  uint64_t batch_window_micros = 0;
+  uint64_t max_batch_keys = 100;
+  // Set to "zstd" if column values may be zstd-compressed. Values compressed
+  // with a dictionary need the same dictionary to be at the path.
+  std::string compression;
+  std::string compression_dictionary_path;
+  // Cached entries are treated as missing after the hard TTL. Entries older
+  // than the soft TTL are still served, but trigger a background refresh. A
+  // soft TTL of 0 disables refreshing before expiry.
+  uint64_t soft_ttl_millis = 0;
+  uint64_t hard_ttl_millis = 1'000 * 60 * 15;
+  // How long keys missing from feature store are cached for, if there's a
+  // negative cache. 0 means the hard TTL.
+  uint64_t negative_ttl_millis = 0;
+  // Up to this fraction of each TTL is randomly added per entry.
+  double ttl_jitter = 0.1;
 
   constexpr static auto properties = std::make_tuple(
       property(&FeatureStoreConfig::table, "table"),
       property(&FeatureStoreConfig::primary_key, "pk"),
       property(&FeatureStoreConfig::type, "type"),
-      property(&FeatureStoreConfig::feature_columns, "featureColumns"));
+      property(&FeatureStoreConfig::feature_columns, "featureColumns"),
+      property(&FeatureStoreConfig::backend, "backend"),
+      property(&FeatureStoreConfig::redis_url, "redisUrl"),
+      property(&FeatureStoreConfig::redis_timeout, "redisTimeout"),
+      property(&FeatureStoreConfig::batch_window_micros, "batchWindowMicros"),
+      property(&FeatureStoreConfig::max_batch_keys, "maxBatchKeys"),
+      property(&FeatureStoreConfig::compression, "compression"),
+      property(&FeatureStoreConfig::compression_dictionary_path,
+               "compressionDictionaryPath"),
+      property(&FeatureStoreConfig::soft_ttl_millis, "softTtlMillis"),
+      property(&FeatureStoreConfig::hard_ttl_millis, "hardTtlMillis"),
+      property(&FeatureStoreConfig::negative_ttl_millis, "negativeTtlMillis"),
+      property(&FeatureStoreConfig::ttl_jitter, "ttlJitter"));
 };
 }  // namespace delivery
@@ -27,6 +27,11 @@ struct PagingConfig {
   // refresh). In seconds.
   int64_t ttl = 300;
 
+  // When positive, executions which run the full feature pipeline also
+  // allocate leftover insertions to this many of the following pages. Requests
+  // for those pages can then respond straight from paging.
+  int64_t num_preallocated_pages = 0;
+
   constexpr static auto properties = std::make_tuple(
       property(&PagingConfig::url, "url"),
       property(&PagingConfig::read_url, "readURL"),
@@ -34,6 +39,8 @@ struct PagingConfig {
       property(&PagingConfig::non_key_properties, "nonKeyProperties"),
       property(&PagingConfig::limit_to_req_insertions,
                "limitToRequestInsertions"),
-      property(&PagingConfig::ttl, "ttl"));
+      property(&PagingConfig::ttl, "ttl"),
+      property(&PagingConfig::num_preallocated_pages,
+               "numPreallocatedPages"));
 };
 }  // namespace delivery
@@ -30,6 +30,41 @@ struct PlatformConfig {
   // This is the number of items to be cached from content feature store.
   // Specified at this level of the config because said cache is global state.
   uint64_t feature_store_content_cache_size = 100'000;
+  // "lru" or "tinyLfu". TinyLFU keeps requests for many long-tail items from
+  // evicting hot ones.
+  std::string feature_store_content_cache_admission = "lru";
+  // Entries are also evicted to keep the cache's approximate memory under
+  // this. 0 means there's no byte limit.
+  uint64_t feature_store_content_cache_max_bytes = 0;
+  // The same, for the cache of user features.
+  uint64_t feature_store_non_content_cache_size = 10'000;
+  uint64_t feature_store_non_content_cache_max_bytes = 0;
+  // Keys missing from feature store can be cached separately, in fixed-size
+  // caches of this many keys. 0 caches them in the caches above instead.
+  uint64_t feature_store_content_negative_cache_size = 0;
+  uint64_t feature_store_non_content_negative_cache_size = 0;
+  // Optional path to a memory-mapped snapshot of content features which is
+  // consulted before feature store on cache misses.
+  std::string feature_store_content_snapshot_path;
+  // Optional name of a shared memory segment which caches content features
+  // for every process on the host. Every process has to use the same sizes.
+  std::string feature_store_shared_cache_name;
+  uint64_t feature_store_shared_cache_size = 100'000;
+  // Entries whose key and encoded features don't fit aren't shared.
+  uint64_t feature_store_shared_cache_slot_bytes = 1'024;
+  // Optional directory to dump the hottest features cache entries to, which
+  // warms the caches on startup. Dumps are written on shutdown, and every
+  // interval if it isn't 0.
+  std::string feature_store_cache_dump_dir;
+  uint64_t feature_store_cache_dump_interval_millis = 0;
+  // Per cache.
+  uint64_t feature_store_cache_dump_max_keys = 100'000;
+  // Warmed entries expire this long after they were dumped.
+  uint64_t feature_store_cache_warmup_ttl_millis = 1'000 * 60 * 5;
+  // Optional Redis which caches features for every instance, between the
+  // local caches and feature store.
+  std::string feature_store_l2_cache_redis_url;
+  std::string feature_store_l2_cache_redis_timeout = "20";
   std::string feature_store_timeout;
 
   std::unordered_map<std::string, CountersConfig> counters_configs;
@@ -43,6 +78,15 @@ struct PlatformConfig {
   std::optional<ExcludeUserFeaturesConfig> exclude_user_features_config;
   TimeFeaturesConfig time_features_config;
 
+  // How often each event loop's lag is measured and exported on "/metrics". 0
+  // disables this.
+  uint64_t event_loop_probe_interval_millis = 100;
+
+  // The fraction [0, 1] of requests whose execution is traced, and how many of
+  // the latest traces are kept for "/tracez".
+  double trace_sample_rate = 0;
+  uint64_t trace_buffer_size = 100;
+
   // This isn't found in any actual configs yet. This is experimental and
   // specific to delivery-cpp for the time being.
   ExecutionConfig execution_config = defaultExecutionConfig();
@@ -55,6 +99,38 @@ struct PlatformConfig {
       property(&PlatformConfig::feature_store_configs, "featureStores"),
       property(&PlatformConfig::feature_store_content_cache_size,
                "featureStoreLocalCacheSize"),
+      property(&PlatformConfig::feature_store_content_cache_admission,
+               "featureStoreLocalCacheAdmission"),
+      property(&PlatformConfig::feature_store_content_cache_max_bytes,
+               "featureStoreLocalCacheMaxBytes"),
+      property(&PlatformConfig::feature_store_non_content_cache_size,
+               "featureStoreNonContentCacheSize"),
+      property(&PlatformConfig::feature_store_non_content_cache_max_bytes,
+               "featureStoreNonContentCacheMaxBytes"),
+      property(&PlatformConfig::feature_store_content_negative_cache_size,
+               "featureStoreLocalNegativeCacheSize"),
+      property(&PlatformConfig::feature_store_non_content_negative_cache_size,
+               "featureStoreNonContentNegativeCacheSize"),
+      property(&PlatformConfig::feature_store_content_snapshot_path,
+               "featureStoreLocalSnapshotPath"),
+      property(&PlatformConfig::feature_store_shared_cache_name,
+               "featureStoreSharedCacheName"),
+      property(&PlatformConfig::feature_store_shared_cache_size,
+               "featureStoreSharedCacheSize"),
+      property(&PlatformConfig::feature_store_shared_cache_slot_bytes,
+               "featureStoreSharedCacheSlotBytes"),
+      property(&PlatformConfig::feature_store_cache_dump_dir,
+               "featureStoreCacheDumpDir"),
+      property(&PlatformConfig::feature_store_cache_dump_interval_millis,
+               "featureStoreCacheDumpIntervalMillis"),
+      property(&PlatformConfig::feature_store_cache_dump_max_keys,
+               "featureStoreCacheDumpMaxKeys"),
+      property(&PlatformConfig::feature_store_cache_warmup_ttl_millis,
+               "featureStoreCacheWarmupTtlMillis"),
+      property(&PlatformConfig::feature_store_l2_cache_redis_url,
+               "featureStoreL2CacheRedisUrl"),
+      property(&PlatformConfig::feature_store_l2_cache_redis_timeout,
+               "featureStoreL2CacheRedisTimeout"),
       property(&PlatformConfig::feature_store_timeout, "featureStoreTimeoutCpp"),
       property(&PlatformConfig::counters_configs, "countersConfigs"),
       property(&PlatformConfig::personalize_configs, "personalizes"),
@@ -62,6 +138,10 @@ struct PlatformConfig {
       property(&PlatformConfig::exclude_user_features_config,
                "excludePersonalFeaturesConfig"),
       property(&PlatformConfig::time_features_config, "derivedFeaturesConfig"),
+      property(&PlatformConfig::event_loop_probe_interval_millis,
+               "eventLoopProbeIntervalMillis"),
+      property(&PlatformConfig::trace_sample_rate, "traceSampleRate"),
+      property(&PlatformConfig::trace_buffer_size, "traceBufferSize"),
       property(&PlatformConfig::execution_config, "executionConfig"));
 
  private:
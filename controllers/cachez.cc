@@ -0,0 +1,177 @@
+#include "controllers/cachez.h"
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "config/feature_store_config.h"
+#include "config/platform_config.h"
+#include "drogon/HttpAppFramework.h"
+#include "execution/decoded_features.h"
+#include "execution/simple_executor.h"
+#include "execution/stages/cache.h"
+#include "execution/stages/feature_compression.h"
+#include "execution/stages/feature_store_client.h"
+#include "execution/stages/negative_cache.h"
+#include "execution/stages/read_from_feature_store.h"
+#include "execution/stages/redis_features_cache.h"
+#include "json/json.h"
+#include "singletons/cache.h"
+#include "singletons/config.h"
+#include "singletons/feature_store.h"
+#include "utils/time.h"
+
+namespace delivery {
+namespace {
+drogon::HttpResponsePtr badRequest(std::string_view error) {
+  Json::Value body(Json::objectValue);
+  body["error"] = std::string(error);
+  auto http_resp = drogon::HttpResponse::newHttpJsonResponse(std::move(body));
+  http_resp->setStatusCode(drogon::k400BadRequest);
+  return http_resp;
+}
+
+// Returns false if the body isn't {"cache": "...", "keys": ["...", ...]}.
+bool parseCacheKeys(const drogon::HttpRequestPtr &http_req, std::string &name,
+                    std::vector<std::string> &keys) {
+  auto json = http_req->getJsonObject();
+  if (json == nullptr || !json->isObject() || !(*json)["cache"].isString() ||
+      !(*json)["keys"].isArray()) {
+    return false;
+  }
+  name = (*json)["cache"].asString();
+  for (const auto &key : (*json)["keys"]) {
+    if (!key.isString()) {
+      return false;
+    }
+    keys.emplace_back(key.asString());
+  }
+  return true;
+}
+}  // namespace
+
+void Cachez::cachez(
+    const drogon::HttpRequestPtr &http_req,
+    std::function<void(const drogon::HttpResponsePtr &)> &&callback) const {
+  Json::Value caches(Json::objectValue);
+  for (const auto &[name, stats] : CacheSingleton::getInstance().stats()) {
+    Json::Value cache(Json::objectValue);
+    cache["entries"] = static_cast<Json::UInt64>(stats.entries);
+    cache["bytes"] = static_cast<Json::UInt64>(stats.bytes);
+    cache["lookups"] = static_cast<Json::UInt64>(stats.hits + stats.misses);
+    cache["hits"] = static_cast<Json::UInt64>(stats.hits);
+    cache["misses"] = static_cast<Json::UInt64>(stats.misses);
+    cache["inserts"] = static_cast<Json::UInt64>(stats.inserts);
+    cache["evictions"] = static_cast<Json::UInt64>(stats.evictions);
+    caches[name] = std::move(cache);
+  }
+  callback(drogon::HttpResponse::newHttpJsonResponse(std::move(caches)));
+}
+
+void Cachez::invalidate(
+    const drogon::HttpRequestPtr &http_req,
+    std::function<void(const drogon::HttpResponsePtr &)> &&callback) const {
+  std::string name;
+  std::vector<std::string> keys;
+  if (!parseCacheKeys(http_req, name, keys)) {
+    callback(badRequest("Expected a cache name and keys"));
+    return;
+  }
+  size_t num_erased = 0;
+  std::shared_ptr<RedisFeaturesCache> l2_cache =
+      FeatureStoreSingleton::getInstance().getL2Cache(
+          drogon::app().getCurrentThreadIndex());
+  if (!CacheSingleton::getInstance().invalidate(name, keys, num_erased,
+                                                l2_cache.get())) {
+    callback(badRequest(absl::StrCat("Unknown cache: ", name)));
+    return;
+  }
+  Json::Value body(Json::objectValue);
+  body["erased"] = static_cast<Json::UInt64>(num_erased);
+  callback(drogon::HttpResponse::newHttpJsonResponse(std::move(body)));
+}
+
+void Cachez::prefetch(
+    const drogon::HttpRequestPtr &http_req,
+    std::function<void(const drogon::HttpResponsePtr &)> &&callback) const {
+  std::string name;
+  std::vector<std::string> keys;
+  if (!parseCacheKeys(http_req, name, keys)) {
+    callback(badRequest("Expected a cache name and keys"));
+    return;
+  }
+  uint64_t type = 0;
+  FeaturesCache *cache = nullptr;
+  NegativeCache *negative_cache = nullptr;
+  if (name == "contentFeatures") {
+    type = item_feature_store_type;
+    cache = &CacheSingleton::getInstance().contentFeaturesCache();
+    negative_cache = CacheSingleton::getInstance().contentNegativeCache();
+  } else if (name == "nonContentFeatures") {
+    type = user_feature_store_type;
+    cache = &CacheSingleton::getInstance().nonContentFeaturesCache();
+    negative_cache = CacheSingleton::getInstance().nonContentNegativeCache();
+  } else {
+    callback(badRequest(absl::StrCat("Can't prefetch cache: ", name)));
+    return;
+  }
+  const PlatformConfig platform_config =
+      ConfigSingleton::getInstance().getPlatformConfig();
+  const FeatureStoreConfig *config = nullptr;
+  for (const auto &feature_store_config :
+       platform_config.feature_store_configs) {
+    if (feature_store_config.type == type) {
+      config = &feature_store_config;
+      break;
+    }
+  }
+  if (config == nullptr) {
+    callback(badRequest(absl::StrCat("No feature store for cache: ", name)));
+    return;
+  }
+
+  const uint64_t start_time = millisSinceEpoch();
+  std::shared_ptr<const FeatureStoreClient> client =
+      FeatureStoreSingleton::getInstance().getClient(
+          *config, platform_config.region,
+          start_time +
+              parseFeatureStoreTimeout(platform_config.feature_store_timeout),
+          drogon::app().getCurrentThreadIndex());
+  // The client is kept until it responds.
+  auto on_results =
+      [client, cache, negative_cache, config = *config, keys, start_time,
+       decompressor = FeatureStoreSingleton::getInstance().getDecompressor(
+           *config),
+       callback = std::move(callback)](
+          std::vector<FeatureStoreResult> results) {
+        size_t num_found = 0;
+        std::function<void(std::string_view,
+                           std::shared_ptr<const DecodedFeatures>)>
+            adder = [&num_found](std::string_view,
+                                 std::shared_ptr<const DecodedFeatures>) {
+              ++num_found;
+            };
+        std::vector<std::string> errors;
+        deserializeAndCache(results, keys, start_time, *cache, negative_cache,
+                            config, decompressor.get(), adder, errors);
+        Json::Value body(Json::objectValue);
+        body["found"] = static_cast<Json::UInt64>(num_found);
+        body["errors"] = Json::Value(Json::arrayValue);
+        for (auto &error : errors) {
+          body["errors"].append(std::move(error));
+        }
+        callback(drogon::HttpResponse::newHttpJsonResponse(std::move(body)));
+      };
+  client->readBatch(
+      config->table, config->primary_key, keys,
+      absl::StrCat(config->primary_key, ",",
+                   absl::StrJoin(config->feature_columns, ",")),
+      std::move(on_results));
+}
+}  // namespace delivery
@@ -0,0 +1,48 @@
+// This implements the "/cachez" route handlers, which report each cache's
+// entries, approximate memory, and lookup counts, and let operators invalidate
+// or prefetch keys. This is for sizing caches against actual usage.
+//
+// Invalidation and prefetch take a JSON body with the cache's name, as
+// reported by "/cachez", and its keys:
+//   {"cache": "contentFeatures", "keys": ["a", "b"]}
+// Only the features caches can be prefetched, since they're read through
+// feature store.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "drogon/HttpController.h"
+#include "drogon/HttpResponse.h"
+#include "drogon/HttpTypes.h"
+#include "drogon/drogon_callbacks.h"
+
+namespace delivery {
+class Cachez : public drogon::HttpController<Cachez> {
+ public:
+  METHOD_LIST_BEGIN
+  ADD_METHOD_TO(Cachez::cachez, "/cachez", drogon::Get,
+                "delivery::ApiKeyFilter");
+  ADD_METHOD_TO(Cachez::invalidate, "/cachez/invalidate", drogon::Post,
+                "delivery::ApiKeyFilter");
+  ADD_METHOD_TO(Cachez::prefetch, "/cachez/prefetch", drogon::Post,
+                "delivery::ApiKeyFilter");
+  METHOD_LIST_END
+
+  void cachez(
+      const drogon::HttpRequestPtr &http_req,
+      std::function<void(const drogon::HttpResponsePtr &)> &&callback) const;
+
+  // Responds with the number of keys which were cached.
+  void invalidate(
+      const drogon::HttpRequestPtr &http_req,
+      std::function<void(const drogon::HttpResponsePtr &)> &&callback) const;
+
+  // Reads the keys from feature store and replaces their cached entries.
+  // Responds once they're cached, with the number of keys found.
+  void prefetch(
+      const drogon::HttpRequestPtr &http_req,
+      std::function<void(const drogon::HttpResponsePtr &)> &&callback) const;
+};
+}  // namespace delivery
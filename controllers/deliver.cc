@@ -13,20 +13,26 @@
 #include "cloud/aws_personalize_client.h"
 #include "cloud/aws_sqs_client.h"
 #include "cloud/cloudwatch_monitoring_client.h"
-#include "cloud/dynamodb_feature_store_reader.h"
 #include "cloud/kafka_delivery_log_writer.h"
 #include "config/feature_config.h"
+#include "config/feature_store_config.h"
 #include "config/platform_config.h"
 #include "drogon/HttpAppFramework.h"
 #include "drogon/HttpRequest.h"
 #include "execution/context.h"
 #include "execution/executor.h"
 #include "execution/simple_executor.h"
+#include "execution/stages/feature_compression.h"
 #include "execution/stages/feature_store_client.h"
 #include "execution/stages/monitoring_client.h"
+#include "execution/stages/negative_cache.h"
 #include "execution/stages/personalize_client.h"
+#include "execution/stages/read_from_feature_store.h"
 #include "execution/stages/redis_client.h"
+#include "execution/stages/redis_features_cache.h"
+#include "execution/stages/shared_features_cache.h"
 #include "execution/stages/sqs_client.h"
+#include "execution/stages/timed_feature_store_client.h"
 #include "execution/stages/write_to_delivery_log.h"
 #include "proto/common/common.pb.h"
 #include "proto/delivery/delivery.pb.h"
@@ -36,10 +42,16 @@
 #include "singletons/counters.h"
 #include "singletons/env.h"
 #include "singletons/feature.h"
+#include "singletons/feature_store.h"
+#include "singletons/metrics.h"
 #include "singletons/paging.h"
+#include "singletons/tracing.h"
 #include "singletons/user_agent.h"
 #include "trantor/utils/LogStream.h"
 #include "trantor/utils/Logger.h"
+#include "utils/histogram.h"
+#include "utils/metrics.h"
+#include "utils/trace.h"
 
 namespace delivery {
 namespace counters {
@@ -48,6 +60,31 @@ struct Caches;
 }  // namespace delivery
 
 namespace delivery {
+namespace {
+// The histograms recorded on every request. They're looked up in the registry
+// once, rather than rendering labels per request.
+struct RequestMetrics {
+  explicit RequestMetrics(MetricsRegistry &metrics)
+      : request_bytes(metrics.histogram("delivery_request_bytes")),
+        request_insertions(metrics.histogram("delivery_request_insertions")),
+        request_micros(metrics.histogram("delivery_request_micros")),
+        feature_store_read_micros(
+            metrics, "delivery_feature_store_read_micros", "table"),
+        stages(metrics) {}
+
+  Histogram &request_bytes;
+  Histogram &request_insertions;
+  Histogram &request_micros;
+  LabeledHistograms feature_store_read_micros;
+  StageMetrics stages;
+};
+
+RequestMetrics &requestMetrics() {
+  static RequestMetrics metrics(MetricsSingleton::getInstance().getRegistry());
+  return metrics;
+}
+}  // namespace
+
 void ApiKeyFilter::doFilter(const drogon::HttpRequestPtr &req,
                             drogon::FilterCallback &&queue_response,
                             drogon::FilterChainCallback &&queue_handler) {
@@ -68,8 +105,27 @@ void deliverBase(
     std::chrono::steady_clock::time_point begin,
     std::unique_ptr<Context> context,
     std::function<void(const drogon::HttpResponsePtr &)> &&callback) {
+  auto &metrics = requestMetrics();
+  metrics.request_insertions.record(context->req().insertion_size());
+  auto &request_histogram = metrics.request_micros;
+  // Get necessary configs.
+  context->platform_config = ConfigSingleton::getInstance().getPlatformConfig();
+  if (sampleTrace(context->platform_config.trace_sample_rate)) {
+    // Traces are buffered while they're recorded, so that slow requests show.
+    context->trace = std::make_shared<Trace>("request");
+    TracingSingleton::getInstance().getBuffer().add(context->trace);
+  }
   // Prepare async response processing.
-  context->respond_cb = [callback, begin](const delivery::Response &resp) {
+  context->respond_cb = [callback, begin, &request_histogram,
+                         trace = context->trace](
+                            const delivery::Response &resp) {
+    if (trace != nullptr) {
+      trace->setName(resp.request_id());
+    }
+    request_histogram.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin)
+            .count());
     std::string body;
     google::protobuf::util::MessageToJsonString(resp, &body);
     auto http_resp = drogon::HttpResponse::newHttpResponse();
@@ -84,8 +140,6 @@ void deliverBase(
   };
   context->user_agent = UserAgentSingleton::getInstance().parse(
       context->req().device().browser().user_agent());
-  // Get necessary configs.
-  context->platform_config = ConfigSingleton::getInstance().getPlatformConfig();
 
   ConfigurationOptions options = {
       .paging_read_redis_client_getter =
@@ -104,10 +158,19 @@ void deliverBase(
             return counters::CountersSingleton::getInstance().getCountersClient(
                 "default", drogon::app().getCurrentThreadIndex());
           },
+      // Unprocessed keys are retried until the feature store stages time out.
       .feature_store_client_getter =
-          [&region = context->platform_config.region]() {
-            return std::make_unique<DynamoDBFeatureStoreClient>(
-                AwsSingleton::getInstance().getDynamoDBClient(region));
+          [&region = context->platform_config.region,
+           deadline = context->start_time +
+                      parseFeatureStoreTimeout(
+                          context->platform_config.feature_store_timeout),
+           &metrics, trace = context->trace](const FeatureStoreConfig &config) {
+            return std::make_unique<TimedFeatureStoreClient>(
+                FeatureStoreSingleton::getInstance().getClient(
+                    config, region, deadline,
+                    drogon::app().getCurrentThreadIndex()),
+                metrics.feature_store_read_micros.get(config.table),
+                trace);
           },
       .personalize_client_getter =
           [&region = context->platform_config.region]() {
@@ -144,11 +207,39 @@ void deliverBase(
       .counters_caches_getter = []() -> counters::Caches & {
         return CacheSingleton::getInstance().countersCaches("default");
       },
+      .content_negative_cache_getter =
+          []() { return CacheSingleton::getInstance().contentNegativeCache(); },
+      .non_content_negative_cache_getter =
+          []() {
+            return CacheSingleton::getInstance().nonContentNegativeCache();
+          },
+      .content_features_snapshot_getter =
+          []() {
+            return CacheSingleton::getInstance().contentFeaturesSnapshot();
+          },
+      .feature_decompressor_getter =
+          [](const FeatureStoreConfig &config) {
+            return FeatureStoreSingleton::getInstance().getDecompressor(config);
+          },
+      .shared_content_features_cache_getter =
+          []() {
+            return CacheSingleton::getInstance().sharedContentFeaturesCache();
+          },
+      .feature_store_l2_cache_getter =
+          []() {
+            return FeatureStoreSingleton::getInstance().getL2Cache(
+                drogon::app().getCurrentThreadIndex());
+          },
+      .stranger_feature_batcher_getter =
+          []() {
+            return FeatureSingleton::getInstance().getStrangerFeatureBatcher();
+          },
       .counters_database =
           counters::CountersSingleton::getInstance().getDatabaseInfo(
               context->platform_config.platform_id, "default"),
       .periodic_time_values =
-          &FeatureSingleton::getInstance().getPeriodicTimeValues()};
+          &FeatureSingleton::getInstance().getPeriodicTimeValues(),
+      .stage_metrics = &metrics.stages};
 
   std::unique_ptr<Executor> &executor =
       configureSimpleExecutor(std::move(context), options);
@@ -161,6 +252,8 @@ void Deliver::deliver(
   // Keep this to the front.
   auto begin = std::chrono::steady_clock::now();
 
+  requestMetrics().request_bytes.record(http_req->body().size());
+
   // Request processing.
   delivery::Request req;
   google::protobuf::util::JsonStringToMessage(
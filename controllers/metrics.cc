@@ -0,0 +1,47 @@
+#include "controllers/metrics.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "singletons/cache.h"
+#include "singletons/metrics.h"
+#include "utils/metrics.h"
+
+namespace delivery {
+void Metrics::metrics(
+    const drogon::HttpRequestPtr &http_req,
+    std::function<void(const drogon::HttpResponsePtr &)> &&callback) const {
+  std::string body;
+  MetricsSingleton::getInstance().getRegistry().write(body);
+
+  auto stats = CacheSingleton::getInstance().stats();
+  absl::StrAppend(&body, "# TYPE delivery_cache_hits_total counter\n");
+  for (const auto &[name, cache_stats] : stats) {
+    absl::StrAppend(&body, "delivery_cache_hits_total{",
+                    renderMetricLabels({{"cache", name}}), "} ",
+                    cache_stats.hits, "\n");
+  }
+  absl::StrAppend(&body, "# TYPE delivery_cache_misses_total counter\n");
+  for (const auto &[name, cache_stats] : stats) {
+    absl::StrAppend(&body, "delivery_cache_misses_total{",
+                    renderMetricLabels({{"cache", name}}), "} ",
+                    cache_stats.misses, "\n");
+  }
+  absl::StrAppend(&body, "# TYPE delivery_cache_hit_ratio gauge\n");
+  for (const auto &[name, cache_stats] : stats) {
+    const uint64_t lookups = cache_stats.hits + cache_stats.misses;
+    const double ratio =
+        lookups == 0 ? 0 : static_cast<double>(cache_stats.hits) / lookups;
+    absl::StrAppend(&body, "delivery_cache_hit_ratio{",
+                    renderMetricLabels({{"cache", name}}), "} ", ratio, "\n");
+  }
+
+  auto http_resp = drogon::HttpResponse::newHttpResponse();
+  http_resp->setContentTypeCode(drogon::CT_TEXT_PLAIN);
+  http_resp->setStatusCode(drogon::k200OK);
+  http_resp->setBody(std::move(body));
+  callback(http_resp);
+}
+}  // namespace delivery
@@ -0,0 +1,27 @@
+// This implements the "/metrics" route handler, which reports the process's
+// metrics in the Prometheus text format. Along with the histograms of
+// MetricsSingleton, each cache's lookup counts and hit ratio are reported.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "drogon/HttpController.h"
+#include "drogon/HttpResponse.h"
+#include "drogon/HttpTypes.h"
+#include "drogon/drogon_callbacks.h"
+
+namespace delivery {
+class Metrics : public drogon::HttpController<Metrics> {
+ public:
+  METHOD_LIST_BEGIN
+  ADD_METHOD_TO(Metrics::metrics, "/metrics", drogon::Get,
+                "delivery::ApiKeyFilter");
+  METHOD_LIST_END
+
+  void metrics(
+      const drogon::HttpRequestPtr &http_req,
+      std::function<void(const drogon::HttpResponsePtr &)> &&callback) const;
+};
+}  // namespace delivery
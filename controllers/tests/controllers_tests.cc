@@ -5,6 +5,7 @@
 #include <future>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
 
 #include "drogon/HttpAppFramework.h"
@@ -13,6 +14,7 @@
 #include "drogon/HttpResponse.h"
 #include "drogon/HttpTypes.h"
 #include "drogon/drogon_test.h"
+#include "json/json.h"
 #include "trantor/net/EventLoop.h"
 
 using ::drogon::app;
@@ -21,6 +23,7 @@ using ::drogon::HttpClient;
 using ::drogon::HttpRequest;
 using ::drogon::HttpResponsePtr;
 using ::drogon::k200OK;
+using ::drogon::k400BadRequest;
 using ::drogon::k401Unauthorized;
 using ::drogon::k404NotFound;
 using ::drogon::Post;
@@ -46,6 +49,81 @@ DROGON_TEST(ControllersTest) {
           });
     }
 
+    {
+      auto req = HttpRequest::newHttpRequest();
+      req->setMethod(Get);
+      req->setPath("/cachez");
+      req->addHeader("x-api-key", api_key);
+      client->sendRequest(
+          req, [TEST_CTX](ReqResult res, const HttpResponsePtr& resp) {
+            REQUIRE(res == ReqResult::Ok);
+            REQUIRE(resp != nullptr);
+            CHECK(resp->getStatusCode() == k200OK);
+          });
+    }
+
+    {
+      auto req = HttpRequest::newHttpRequest();
+      req->setMethod(Get);
+      req->setPath("/metrics");
+      req->addHeader("x-api-key", api_key);
+      client->sendRequest(
+          req, [TEST_CTX](ReqResult res, const HttpResponsePtr& resp) {
+            REQUIRE(res == ReqResult::Ok);
+            REQUIRE(resp != nullptr);
+            CHECK(resp->getStatusCode() == k200OK);
+            CHECK(resp->getBody().find("delivery_cache_hit_ratio") !=
+                  std::string_view::npos);
+          });
+    }
+
+    {
+      auto req = HttpRequest::newHttpRequest();
+      req->setMethod(Get);
+      req->setPath("/tracez");
+      req->addHeader("x-api-key", api_key);
+      client->sendRequest(
+          req, [TEST_CTX](ReqResult res, const HttpResponsePtr& resp) {
+            REQUIRE(res == ReqResult::Ok);
+            REQUIRE(resp != nullptr);
+            CHECK(resp->getStatusCode() == k200OK);
+            REQUIRE(resp->getJsonObject() != nullptr);
+            CHECK((*resp->getJsonObject())["traceEvents"].isArray());
+          });
+    }
+
+    {
+      Json::Value body(Json::objectValue);
+      body["cache"] = "contentFeatures";
+      body["keys"].append("a");
+      auto req = HttpRequest::newHttpJsonRequest(body);
+      req->setMethod(Post);
+      req->setPath("/cachez/invalidate");
+      req->addHeader("x-api-key", api_key);
+      client->sendRequest(
+          req, [TEST_CTX](ReqResult res, const HttpResponsePtr& resp) {
+            REQUIRE(res == ReqResult::Ok);
+            REQUIRE(resp != nullptr);
+            CHECK(resp->getStatusCode() == k200OK);
+          });
+    }
+
+    {
+      Json::Value body(Json::objectValue);
+      body["cache"] = "unknown";
+      body["keys"].append("a");
+      auto req = HttpRequest::newHttpJsonRequest(body);
+      req->setMethod(Post);
+      req->setPath("/cachez/invalidate");
+      req->addHeader("x-api-key", api_key);
+      client->sendRequest(
+          req, [TEST_CTX](ReqResult res, const HttpResponsePtr& resp) {
+            REQUIRE(res == ReqResult::Ok);
+            REQUIRE(resp != nullptr);
+            CHECK(resp->getStatusCode() == k400BadRequest);
+          });
+    }
+
     {
       auto req = HttpRequest::newHttpRequest();
       req->setMethod(Post);
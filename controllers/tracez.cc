@@ -0,0 +1,13 @@
+#include "controllers/tracez.h"
+
+#include "singletons/tracing.h"
+#include "utils/trace.h"
+
+namespace delivery {
+void Tracez::tracez(
+    const drogon::HttpRequestPtr &http_req,
+    std::function<void(const drogon::HttpResponsePtr &)> &&callback) const {
+  callback(drogon::HttpResponse::newHttpJsonResponse(
+      TracingSingleton::getInstance().getBuffer().toChromeTrace()));
+}
+}  // namespace delivery
@@ -0,0 +1,27 @@
+// This implements the "/tracez" route handler, which reports the latest sampled
+// request traces in the Chrome trace event format. Save the response to open
+// it in chrome://tracing or Perfetto.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "drogon/HttpController.h"
+#include "drogon/HttpResponse.h"
+#include "drogon/HttpTypes.h"
+#include "drogon/drogon_callbacks.h"
+
+namespace delivery {
+class Tracez : public drogon::HttpController<Tracez> {
+ public:
+  METHOD_LIST_BEGIN
+  ADD_METHOD_TO(Tracez::tracez, "/tracez", drogon::Get,
+                "delivery::ApiKeyFilter");
+  METHOD_LIST_END
+
+  void tracez(
+      const drogon::HttpRequestPtr &http_req,
+      std::function<void(const drogon::HttpResponsePtr &)> &&callback) const;
+};
+}  // namespace delivery
@@ -15,6 +15,7 @@
 #include "proto/delivery/delivery.pb.h"
 #include "proto/delivery/private/features/features.pb.h"
 #include "proto/event/event.pb.h"
+#include "utils/trace.h"
 
 namespace delivery {
 class Context {
@@ -67,6 +68,9 @@ class Context {
   // returns.
   std::unique_ptr<Executor> executor;
 
+  // Set if this request was sampled for tracing.
+  std::shared_ptr<Trace> trace;
+
   // This is a hack while we migrate to prevent the writing of delivery logs.
   bool is_echo = false;
 
@@ -0,0 +1,47 @@
+#include "execution/decoded_features.h"
+
+#include <algorithm>
+
+namespace delivery {
+namespace {
+template <typename Pairs>
+void sortById(Pairs& pairs) {
+  std::sort(pairs.begin(), pairs.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+}
+}  // namespace
+
+size_t DecodedFeatures::bytes() const {
+  size_t bytes = sizeof(DecodedFeatures) +
+                 sparse.capacity() * sizeof(sparse[0]) +
+                 sparse_id.capacity() * sizeof(sparse_id[0]) +
+                 sparse_id_list.capacity() * sizeof(sparse_id_list[0]);
+  for (const auto& [id, values] : sparse_id_list) {
+    bytes += values.capacity() * sizeof(int64_t);
+  }
+  return bytes;
+}
+
+std::shared_ptr<const DecodedFeatures> decodeFeatures(
+    const delivery_private_features::Features& features) {
+  auto decoded = std::make_shared<DecodedFeatures>();
+  decoded->sparse.reserve(features.sparse_size());
+  for (const auto& [id, value] : features.sparse()) {
+    decoded->sparse.emplace_back(id, value);
+  }
+  sortById(decoded->sparse);
+  decoded->sparse_id.reserve(features.sparse_id_size());
+  for (const auto& [id, value] : features.sparse_id()) {
+    decoded->sparse_id.emplace_back(id, value);
+  }
+  sortById(decoded->sparse_id);
+  decoded->sparse_id_list.reserve(features.sparse_id_list_size());
+  for (const auto& [id, sequence] : features.sparse_id_list()) {
+    decoded->sparse_id_list.emplace_back(
+        id,
+        std::vector<int64_t>(sequence.ids().begin(), sequence.ids().end()));
+  }
+  sortById(decoded->sparse_id_list);
+  return decoded;
+}
+}  // namespace delivery
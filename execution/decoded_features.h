@@ -0,0 +1,34 @@
+// Feature store values are protobufs with map fields. Decoding them once into
+// sorted flat arrays makes them cheap to share between requests and to merge
+// into feature scopes.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "proto/delivery/private/features/features.pb.h"
+
+namespace delivery {
+// Each array is sorted by feature ID and has no duplicate IDs. Instances are
+// immutable once decoded.
+struct DecodedFeatures {
+  std::vector<std::pair<uint64_t, float>> sparse;
+  std::vector<std::pair<uint64_t, int64_t>> sparse_id;
+  std::vector<std::pair<uint64_t, std::vector<int64_t>>> sparse_id_list;
+
+  bool empty() const {
+    return sparse.empty() && sparse_id.empty() && sparse_id_list.empty();
+  }
+
+  // The approximate memory used, including this.
+  size_t bytes() const;
+};
+
+std::shared_ptr<const DecodedFeatures> decodeFeatures(
+    const delivery_private_features::Features& features);
+}  // namespace delivery
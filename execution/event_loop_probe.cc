@@ -0,0 +1,51 @@
+#include "execution/event_loop_probe.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include "execution/simple_executor.h"
+#include "trantor/net/EventLoop.h"
+#include "utils/histogram.h"
+#include "utils/metrics.h"
+#include "utils/time.h"
+
+namespace delivery {
+EventLoopProbe::EventLoopProbe(trantor::EventLoop& loop, size_t loop_index,
+                               std::chrono::milliseconds interval,
+                               MetricsRegistry& metrics)
+    : loop_(loop),
+      interval_(interval),
+      lag_(metrics.histogram("delivery_event_loop_lag_micros",
+                             {{"loop", std::to_string(loop_index)}})),
+      queue_wait_(metrics.histogram("delivery_event_loop_queue_wait_micros",
+                                    {{"loop", std::to_string(loop_index)}})),
+      queued_stages_(
+          metrics.histogram("delivery_event_loop_queued_stages",
+                            {{"loop", std::to_string(loop_index)}})) {}
+
+void EventLoopProbe::start() {
+  loop_.queueInLoop([this]() { schedule(); });
+}
+
+void EventLoopProbe::schedule() {
+  // Each probe schedules the next, rather than using a repeating timer, so
+  // lag is measured from when the timer was actually set.
+  uint64_t scheduled_micros = microsForDuration();
+  loop_.runAfter(interval_,
+                 [this, scheduled_micros]() { probe(scheduled_micros); });
+}
+
+void EventLoopProbe::probe(uint64_t scheduled_micros) {
+  const uint64_t now = microsForDuration();
+  const uint64_t due = scheduled_micros + interval_.count();
+  lag_.record(now > due ? now - due : 0);
+  // This runs on the loop, so these are its stages.
+  queued_stages_.record(static_cast<uint64_t>(
+      std::max<int64_t>(queuedStages().load(std::memory_order_relaxed), 0)));
+  loop_.queueInLoop([this, now]() {
+    queue_wait_.record(microsForDuration() - now);
+  });
+  schedule();
+}
+}  // namespace delivery
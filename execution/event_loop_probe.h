@@ -0,0 +1,44 @@
+// Periodically measures how far behind an event loop is, to tell local CPU
+// saturation apart from slow backends. Every interval, on the loop, this
+// records:
+// - How late its timer fired, in micros
+// - How long a task queued then waits to run, in micros
+// - How many executor stages are queued on it, waiting to run
+// Each is a histogram with the loop's index as the "loop" label.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+
+namespace trantor {
+class EventLoop;
+}
+
+namespace delivery {
+class Histogram;
+class MetricsRegistry;
+}  // namespace delivery
+
+namespace delivery {
+class EventLoopProbe {
+ public:
+  EventLoopProbe(trantor::EventLoop& loop, size_t loop_index,
+                 std::chrono::milliseconds interval, MetricsRegistry& metrics);
+
+  // Keeps probing for as long as the loop runs. This must outlive the loop.
+  void start();
+
+ private:
+  void schedule();
+  void probe(uint64_t scheduled_micros);
+
+  trantor::EventLoop& loop_;
+  std::chrono::microseconds interval_;
+  Histogram& lag_;
+  Histogram& queue_wait_;
+  Histogram& queued_stages_;
+};
+}  // namespace delivery
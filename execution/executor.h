@@ -22,12 +22,21 @@
 
 namespace delivery {
 class DeliveryLogWriter;
+class FeatureDecompressor;
+class FeatureSnapshot;
 class FeatureStoreClient;
+struct FeatureStoreConfig;
 class MonitoringClient;
+class Histogram;
+class NegativeCache;
 class PersonalizeClient;
 class RedisClient;
+class RedisFeaturesCache;
+class SharedFeaturesCache;
 class SqsClient;
+class StrangerFeatureBatcher;
 struct PeriodicTimeValues;
+struct StageMetrics;
 namespace counters {
 class Caches;
 class DatabaseInfo;
@@ -40,7 +49,7 @@ struct ConfigurationOptions {
   std::function<std::unique_ptr<RedisClient>()>
       paging_write_redis_client_getter;
   std::function<std::unique_ptr<RedisClient>()> counters_redis_client_getter;
-  std::function<std::unique_ptr<FeatureStoreClient>()>
+  std::function<std::unique_ptr<FeatureStoreClient>(const FeatureStoreConfig&)>
       feature_store_client_getter;
   std::function<std::unique_ptr<PersonalizeClient>()> personalize_client_getter;
   std::function<std::unique_ptr<DeliveryLogWriter>()>
@@ -52,10 +61,30 @@ struct ConfigurationOptions {
   std::function<FeaturesCache&()> content_features_cache_getter;
   std::function<FeaturesCache&()> non_content_features_cache_getter;
   std::function<counters::Caches&()> counters_caches_getter;
+  // Optional. May return null.
+  std::function<NegativeCache*()> content_negative_cache_getter;
+  std::function<NegativeCache*()> non_content_negative_cache_getter;
+  // Optional. May return null.
+  std::function<std::shared_ptr<const FeatureSnapshot>()>
+      content_features_snapshot_getter;
+  // Optional. May return null if the feature store isn't compressed.
+  std::function<std::shared_ptr<const FeatureDecompressor>(
+      const FeatureStoreConfig&)>
+      feature_decompressor_getter;
+  // Optional. May return null if there's no cache shared across processes.
+  std::function<std::shared_ptr<SharedFeaturesCache>()>
+      shared_content_features_cache_getter;
+  // Optional. May return null if there's no features cache in Redis.
+  std::function<std::shared_ptr<RedisFeaturesCache>()>
+      feature_store_l2_cache_getter;
+  // Optional. May return null if stranger features aren't batched.
+  std::function<StrangerFeatureBatcher*()> stranger_feature_batcher_getter;
 
   // Misc.
   const counters::DatabaseInfo* counters_database = nullptr;
   const PeriodicTimeValues* periodic_time_values = nullptr;
+  // Optional. Stage durations and queue delays are recorded here if set.
+  StageMetrics* stage_metrics = nullptr;
 };
 
 // Just representing the execution graph as an adjacency list for now.
@@ -69,6 +98,15 @@ struct ExecutorNode {
   std::vector<size_t> output_ids;
   delivery::DeliveryLatency latency;
   uint64_t duration_start = 0;
+  // Only set if metrics are recorded. The histograms are shared by every
+  // request's node for the stage.
+  Histogram* duration_histogram = nullptr;
+  Histogram* queue_delay_histogram = nullptr;
+  uint64_t duration_start_micros = 0;
+  uint64_t queue_start_micros = 0;
+  // If set and true once the stage's inputs are ready, the stage is not run.
+  // Its outputs are still released so the shape of the graph is unaffected.
+  std::function<bool()> skip_cb;
 };
 
 class Executor {
@@ -6,13 +6,28 @@
 #include "proto/delivery/delivery.pb.h"
 
 namespace delivery {
+namespace {
+void mergeDecoded(FeatureScope& scope, const DecodedFeatures& features) {
+  mergePairs(scope.features, features.sparse);
+  mergePairs(scope.int_features, features.sparse_id);
+  mergePairs(scope.int_list_features, features.sparse_id_list);
+}
+}  // namespace
+
 void FeatureContext::initialize(
-    const std::vector<delivery::Insertion>& insertions) {
+    const std::vector<delivery::Insertion>& insertions,
+    bool record_stranger_paths) {
   insertion_features_ = std::vector<FeatureScope>(insertions.size());
   for (const auto& insertion : insertions) {
     size_t idx = insertion_id_to_idx_.size();
     insertion_id_to_idx_[insertion.content_id()] = idx;
   }
+  record_stranger_paths_ = record_stranger_paths;
+  for (auto& scope : insertion_features_) {
+    scope.record_stranger_paths = record_stranger_paths;
+  }
+  request_features_.record_stranger_paths = record_stranger_paths;
+  user_features_.record_stranger_paths = record_stranger_paths;
   // May be worth giving each map a large reservation.
 }
 
@@ -57,6 +72,19 @@ void FeatureContext::addUserFeatures(
             *features.mutable_sparse_id_list());
 }
 
+void FeatureContext::mergeInsertionFeatures(std::string_view insertion_id,
+                                            const DecodedFeatures& features) {
+  size_t idx = insertion_id_to_idx_.at(insertion_id);
+  FeatureScope& scope = insertion_features_[idx];
+  std::lock_guard<std::mutex> lock(scope.mutex);
+  mergeDecoded(scope, features);
+}
+
+void FeatureContext::mergeUserFeatures(const DecodedFeatures& features) {
+  std::lock_guard<std::mutex> lock(user_features_.mutex);
+  mergeDecoded(user_features_, features);
+}
+
 void FeatureContext::addStrangerInsertionFeatures(
     std::string_view insertion_id,
     absl::flat_hash_map<uint64_t, float> features,
@@ -65,7 +93,9 @@ void FeatureContext::addStrangerInsertionFeatures(
   FeatureScope& scope = insertion_features_[idx];
   std::lock_guard<std::mutex> lock(scope.mutex);
   mergeMaps(scope.features, features);
-  mergeMaps(scope.stranger_feature_paths, feature_paths);
+  if (scope.record_stranger_paths) {
+    mergeMaps(scope.stranger_feature_paths, feature_paths);
+  }
 }
 
 void FeatureContext::addStrangerRequestFeatures(
@@ -73,7 +103,9 @@ void FeatureContext::addStrangerRequestFeatures(
     absl::flat_hash_map<std::string, uint64_t> feature_paths) {
   std::lock_guard<std::mutex> lock(request_features_.mutex);
   mergeMaps(request_features_.features, features);
-  mergeMaps(request_features_.stranger_feature_paths, feature_paths);
+  if (request_features_.record_stranger_paths) {
+    mergeMaps(request_features_.stranger_feature_paths, feature_paths);
+  }
 }
 
 void FeatureContext::addStrangerUserFeatures(
@@ -81,7 +113,9 @@ void FeatureContext::addStrangerUserFeatures(
     absl::flat_hash_map<std::string, uint64_t> feature_paths) {
   std::lock_guard<std::mutex> lock(user_features_.mutex);
   mergeMaps(user_features_.features, features);
-  mergeMaps(user_features_.stranger_feature_paths, feature_paths);
+  if (user_features_.record_stranger_paths) {
+    mergeMaps(user_features_.stranger_feature_paths, feature_paths);
+  }
 }
 
 void FeatureContext::processInsertionFeatures(
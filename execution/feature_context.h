@@ -19,6 +19,7 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/hash/hash.h"
+#include "execution/decoded_features.h"
 #include "proto/delivery/private/features/features.pb.h"
 
 namespace delivery {
@@ -51,6 +52,9 @@ struct FeatureScope {
   absl::flat_hash_map<uint64_t, std::vector<int64_t>> int_list_features;
 
   absl::flat_hash_map<std::string, uint64_t> stranger_feature_paths;
+  // Paths are only written out for sampled requests, so they aren't built for
+  // the rest. Stages should check this before adding paths.
+  bool record_stranger_paths = true;
 
   // Don't expect much contention here, so keeping it simple.
   std::mutex mutex;
@@ -65,7 +69,12 @@ struct FeatureScope {
 class FeatureContext {
  public:
   // Must be called before anything else. All other functions are thread-safe.
-  void initialize(const std::vector<delivery::Insertion>& insertions);
+  // Stranger feature paths are only recorded if `record_stranger_paths`.
+  void initialize(const std::vector<delivery::Insertion>& insertions,
+                  bool record_stranger_paths = true);
+
+  // For stages which build stranger feature paths outside of a scope.
+  bool recordsStrangerPaths() const { return record_stranger_paths_; }
 
   void addInsertionFeatures(std::string_view insertion_id,
                             absl::flat_hash_map<uint64_t, float> features);
@@ -77,6 +86,12 @@ class FeatureContext {
                             delivery_private_features::Features features);
   void addUserFeatures(delivery_private_features::Features features);
 
+  // Merges already-decoded features, such as those shared by the feature store
+  // cache, without copying or rehashing a proto first.
+  void mergeInsertionFeatures(std::string_view insertion_id,
+                              const DecodedFeatures& features);
+  void mergeUserFeatures(const DecodedFeatures& features);
+
   void addStrangerInsertionFeatures(
       std::string_view insertion_id,
       absl::flat_hash_map<uint64_t, float> features,
@@ -115,5 +130,6 @@ class FeatureContext {
   std::vector<FeatureScope> insertion_features_;
   FeatureScope user_features_;
   FeatureScope request_features_;
+  bool record_stranger_paths_ = true;
 };
 }  // namespace delivery
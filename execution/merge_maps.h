@@ -37,4 +37,14 @@ void mergeMaps(DstMap& dst, SrcMap& src) {
                           typename SrcMap::mapped_type>(std::move(v));
   }
 }
+
+// Like mergeMaps(), but copies from a flat array of key-value pairs which may
+// be shared and so can't be moved from.
+template <typename DstMap, typename Pairs>
+void mergePairs(DstMap& dst, const Pairs& src) {
+  dst.reserve(dst.size() + src.size());
+  for (const auto& [k, v] : src) {
+    dst.insert_or_assign(k, v);
+  }
+}
 }  // namespace delivery
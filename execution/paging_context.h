@@ -20,6 +20,10 @@ struct PagingContext {
   // The Redis key to use.
   std::string key;
 
+  // Set once the current page is known. Responses are only cut to the page's
+  // positions when paging is in use.
+  bool has_curr_page = false;
+
   // Positions are absolute, zero-based, and inclusive.
   int64_t min_position = 0;
   int64_t max_position = 0;
@@ -29,5 +33,10 @@ struct PagingContext {
 
   // Each entry corresponds to a past allocation.
   absl::flat_hash_map<std::string, SeenInfo> seen_infos;
+
+  // True when past allocations cover every position on the current page. Only
+  // set when preallocation is enabled. Stages which only exist to fill open
+  // positions are skipped in this case.
+  bool is_fully_allocated = false;
 };
 }  // namespace delivery
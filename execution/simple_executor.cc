@@ -1,16 +1,20 @@
 #include "execution/simple_executor.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdlib>
 #include <string_view>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "config/execution_config.h"
 #include "config/feature_config.h"
 #include "config/platform_config.h"
+#include "execution/decoded_features.h"
 #include "context.h"
 #include "execution/stages/compute_distribution_features.h"
 #include "execution/stages/compute_query_features.h"
@@ -18,19 +22,24 @@
 #include "execution/stages/compute_time_features.h"
 #include "execution/stages/counters.h"
 #include "execution/stages/exclude_user_features.h"
+#include "execution/stages/feature_compression.h"
 #include "execution/stages/feature_store_client.h"
 #include "execution/stages/flatten.h"
 #include "execution/stages/init.h"
 #include "execution/stages/init_features.h"
+#include "execution/stages/negative_cache.h"
 #include "execution/stages/paging.h"
 #include "execution/stages/personalize_client.h"
 #include "execution/stages/read_from_feature_store.h"
 #include "execution/stages/read_from_personalize.h"
 #include "execution/stages/read_from_request.h"
 #include "execution/stages/redis_client.h"
+#include "execution/stages/redis_features_cache.h"
 #include "execution/stages/respond.h"
+#include "execution/stages/shared_features_cache.h"
 #include "execution/stages/sqs_client.h"
 #include "execution/stages/stage.h"
+#include "execution/stages/stranger_feature_batcher.h"
 #include "execution/stages/write_out_stranger_features.h"
 #include "execution/stages/write_to_delivery_log.h"
 #include "execution/stages/write_to_monitoring.h"
@@ -43,7 +52,9 @@
 #include "trantor/net/EventLoop.h"
 #include "trantor/utils/LogStream.h"
 #include "trantor/utils/Logger.h"
+#include "utils/metrics.h"
 #include "utils/time.h"
+#include "utils/trace.h"
 
 namespace delivery {
 void startLatency(ExecutorNode& node) {
@@ -56,30 +67,72 @@ void finishLatency(ExecutorNode& node) {
   node.latency.set_duration_millis(millisForDuration() - node.duration_start);
 }
 
+std::atomic<int64_t>& queuedStages() {
+  thread_local std::atomic<int64_t> queued_stages = 0;
+  return queued_stages;
+}
+
 void SimpleExecutor::execute() {
   // If stages make async calls, responses can be handled by threads without
   // loops we know of (e.g. in the AWS SDK). This means we have to stash the
   // loop we'll use now for queueing successive stages instead of always getting
   // it on the fly.
   loop_ = trantor::EventLoop::getEventLoopOfCurrentThread();
+  queued_stages_ = &queuedStages();
   for (auto& curr_node : nodes_) {
     // Immediately queue all stages which aren't waiting on other stages.
     if (curr_node.stage != nullptr && *curr_node.remaining_inputs == 0) {
-      loop_->queueInLoop([this, &curr_node] {
-        startLatency(curr_node);
-        curr_node.stage->run(
-            /*done_cb=*/[this, &curr_node] { this->afterRun(curr_node); },
-            /*timeout_cb=*/
-            [this](const std::chrono::duration<double>& delay,
-                   std::function<void()>&& cb) {
-              this->scheduleTimeout(delay, std::move(cb));
-            });
-      });
+      queueNode(curr_node);
     }
   }
 }
 
+void SimpleExecutor::queueNode(ExecutorNode& node) {
+  if (node.queue_delay_histogram != nullptr || trace_ != nullptr) {
+    node.queue_start_micros = microsForDuration();
+  }
+  // This may be called from another thread, which has its own count.
+  queued_stages_->fetch_add(1, std::memory_order_relaxed);
+  loop_->queueInLoop([this, &node] {
+    queued_stages_->fetch_sub(1, std::memory_order_relaxed);
+    startLatency(node);
+    if (node.queue_delay_histogram != nullptr || trace_ != nullptr) {
+      node.duration_start_micros = microsForDuration();
+    }
+    if (node.queue_delay_histogram != nullptr) {
+      node.queue_delay_histogram->record(node.duration_start_micros -
+                                         node.queue_start_micros);
+    }
+    if (trace_ != nullptr) {
+      trace_->addSpan(node.stage->name(), "queue", node.queue_start_micros,
+                      node.duration_start_micros);
+    }
+    if (node.skip_cb != nullptr && node.skip_cb()) {
+      // Don't attribute any latency to stages that didn't run.
+      node.latency.set_method(
+          delivery::DeliveryLatency_DeliveryMethod_UNKNOWN_DELIVERY_METHOD);
+      node.duration_histogram = nullptr;
+      this->afterRun(node);
+      return;
+    }
+    node.stage->run(
+        /*done_cb=*/[this, &node] { this->afterRun(node); },
+        /*timeout_cb=*/
+        [this](const std::chrono::duration<double>& delay,
+               std::function<void()>&& cb) {
+          this->scheduleTimeout(delay, std::move(cb));
+        });
+    // Cleanup is queued on this loop, so this can't have been destroyed yet.
+    if (trace_ != nullptr) {
+      traceRunReturned(node);
+    }
+  });
+}
+
 void SimpleExecutor::afterRun(ExecutorNode& curr_node) {
+  if (trace_ != nullptr) {
+    traceDone(curr_node);
+  }
   // By construction, this should be the only final stage. Queue cleanup.
   if (curr_node.output_ids.empty()) {
     loop_->queueInLoop(std::move(clean_up_cb_));
@@ -91,26 +144,43 @@ void SimpleExecutor::afterRun(ExecutorNode& curr_node) {
   // Stages that define their own async behavior will still be attributed with
   // that duration even if the event loop was actually free to do other work.
   finishLatency(curr_node);
+  if (curr_node.duration_histogram != nullptr) {
+    curr_node.duration_histogram->record(microsForDuration() -
+                                         curr_node.duration_start_micros);
+  }
   // Note that nothing happens for terminal nodes.
   for (size_t output_id : curr_node.output_ids) {
     auto& next_node = nodes_.at(output_id);
     // If this is the last stage being waited on by another, queue that stage
     // now.
     if (--(*next_node.remaining_inputs) == 0) {
-      loop_->queueInLoop([this, &next_node] {
-        startLatency(next_node);
-        next_node.stage->run(
-            /*done_cb=*/[this, &next_node] { this->afterRun(next_node); },
-            /*timeout_cb=*/
-            [this](const std::chrono::duration<double>& delay,
-                   std::function<void()>&& cb) {
-              this->scheduleTimeout(delay, std::move(cb));
-            });
-      });
+      queueNode(next_node);
     }
   }
 }
 
+void SimpleExecutor::traceRunReturned(const ExecutorNode& node) {
+  const uint64_t now = microsForDuration();
+  trace_->addSpan(node.stage->name(), "run", node.duration_start_micros, now);
+  std::lock_guard<std::mutex> lock(trace_mutex_);
+  run_returned_micros_[node.stage->id()] = now;
+}
+
+void SimpleExecutor::traceDone(const ExecutorNode& node) {
+  uint64_t run_returned_micros = 0;
+  {
+    std::lock_guard<std::mutex> lock(trace_mutex_);
+    run_returned_micros = run_returned_micros_[node.stage->id()];
+  }
+  // Stages which finish within run() have no asynchronous part. Neither do
+  // stages which finish on another thread before run() returns, as far as the
+  // trace shows.
+  if (run_returned_micros > 0) {
+    trace_->addSpan(node.stage->name(), "async", run_returned_micros,
+                    microsForDuration());
+  }
+}
+
 void SimpleExecutor::scheduleTimeout(const std::chrono::duration<double>& delay,
                                      std::function<void()>&& cb) {
   // Presumably this can be additionally delayed if the loop is busy at that
@@ -159,6 +229,34 @@ void SimpleExecutorBuilder::addStage(
   nodes_[stage_id].latency.set_method(latency_tag);
 }
 
+void SimpleExecutorBuilder::skipIf(size_t stage_id, size_t decided_by_id,
+                                   std::function<bool()>&& skip_cb) {
+  nodes_.at(stage_id).skip_cb = std::move(skip_cb);
+  skip_deciders_.emplace_back(stage_id, decided_by_id);
+}
+
+// Whether `stage_id` can only be queued after `input_id` has finished.
+bool dependsOn(const std::vector<ExecutorNode>& nodes, size_t stage_id,
+               size_t input_id) {
+  std::vector<size_t> to_visit = {input_id};
+  std::vector<bool> visited(nodes.size());
+  while (!to_visit.empty()) {
+    size_t id = to_visit.back();
+    to_visit.pop_back();
+    if (id >= nodes.size() || visited[id]) {
+      continue;
+    }
+    visited[id] = true;
+    for (size_t output_id : nodes[id].output_ids) {
+      if (output_id == stage_id) {
+        return true;
+      }
+      to_visit.push_back(output_id);
+    }
+  }
+  return false;
+}
+
 class NoOpStage : public Stage {
  public:
   explicit NoOpStage(size_t id) : Stage(id) {}
@@ -171,6 +269,14 @@ class NoOpStage : public Stage {
 
 std::unique_ptr<SimpleExecutor> SimpleExecutorBuilder::build(
     std::function<void()>&& clean_up_cb) {
+  // Otherwise the skip could be decided before the deciding stage has run.
+  for (const auto& [stage_id, decided_by_id] : skip_deciders_) {
+    if (!dependsOn(nodes_, stage_id, decided_by_id)) {
+      LOG_FATAL << "Skippable stage " << stage_id
+                << " does not depend on stage " << decided_by_id;
+      abort();
+    }
+  }
   std::vector<size_t> final_ids;
   for (size_t i = 0; i < nodes_.size(); ++i) {
     if (nodes_[i].stage != nullptr && nodes_[i].output_ids.empty()) {
@@ -182,8 +288,18 @@ std::unique_ptr<SimpleExecutor> SimpleExecutorBuilder::build(
   if (final_ids.size() != 1) {
     addStage(std::make_unique<NoOpStage>(nodes_.size()), final_ids);
   }
+  if (metrics_ != nullptr) {
+    for (auto& node : nodes_) {
+      if (node.stage == nullptr) {
+        continue;
+      }
+      const std::string name = node.stage->name();
+      node.duration_histogram = &metrics_->durations.get(name);
+      node.queue_delay_histogram = &metrics_->queue_delays.get(name);
+    }
+  }
   return std::make_unique<SimpleExecutor>(std::move(clean_up_cb),
-                                          std::move(nodes_));
+                                          std::move(nodes_), std::move(trace_));
 }
 
 std::unique_ptr<SimpleExecutor> SimpleExecutorBuilder::build(
@@ -197,6 +313,21 @@ std::unique_ptr<SimpleExecutor> SimpleExecutorBuilder::build(
   });
 }
 
+// These stages only exist to fill open positions on the current page.
+const absl::flat_hash_set<std::string> skippable_when_preallocated = {
+    "ReadFromItemFeatureStore",
+    "ReadFromUserFeatureStore",
+    "ReadFromCounters",
+    "ProcessCounters",
+    "ReadFromPersonalize",
+    "ReadFromRequest",
+    "Flatten",
+    "ExcludeUserFeatures",
+    "ComputeDistributionFeatures",
+    "ComputeTimeFeatures",
+    "ComputeQueryFeatures",
+    "ComputeRatioFeatures"};
+
 // If a stage cannot be built, it is replaced by a stage which does no
 // processing. The topology of the graph remains the same.
 //
@@ -208,6 +339,12 @@ std::unique_ptr<Executor>& configureSimpleExecutor(
   // Construction should be cheap, but if it gets expensive we can cache them
   // and add a virtual clone() function.
   SimpleExecutorBuilder builder;
+  if (options.stage_metrics != nullptr) {
+    builder.recordMetrics(*options.stage_metrics);
+  }
+  if (context->trace != nullptr) {
+    builder.recordTrace(context->trace);
+  }
 
   for (const auto& stage : context->platform_config.execution_config.stages) {
     if (stage.type == "Init") {
@@ -222,10 +359,15 @@ std::unique_ptr<Executor>& configureSimpleExecutor(
           stage.input_ids,
           delivery::DeliveryLatency_DeliveryMethod_PAGING__GET_ALLOCATED);
     } else if (stage.type == "InitFeatures") {
-      builder.addStage(std::make_unique<InitFeaturesStage>(
-                           stage.id, context->execution_insertions,
-                           context->feature_context),
-                       stage.input_ids);
+      builder.addStage(
+          std::make_unique<InitFeaturesStage>(
+              stage.id, context->execution_insertions,
+              context->feature_context,
+              sampleStrangerFeatures(
+                  context->platform_config.sparse_features_config
+                      .stranger_feature_sampling_rate,
+                  context->start_time)),
+          stage.input_ids);
     } else if (stage.type == "ReadFromItemFeatureStore") {
       const auto& feature_store_configs =
           context->platform_config.feature_store_configs;
@@ -254,17 +396,39 @@ std::unique_ptr<Executor>& configureSimpleExecutor(
       };
       auto feature_adder = [&feature_context = context->feature_context](
                                std::string_view insertion_id,
-                               delivery_private_features::Features features) {
-        feature_context.addInsertionFeatures(insertion_id, std::move(features));
+                               const DecodedFeatures& features) {
+        feature_context.mergeInsertionFeatures(insertion_id, features);
       };
+      const auto& config = feature_store_configs[config_idx];
+      std::shared_ptr<const FeatureSnapshot> snapshot;
+      if (options.content_features_snapshot_getter != nullptr) {
+        snapshot = options.content_features_snapshot_getter();
+      }
+      std::shared_ptr<const FeatureDecompressor> decompressor;
+      if (options.feature_decompressor_getter != nullptr) {
+        decompressor = options.feature_decompressor_getter(config);
+      }
+      std::shared_ptr<SharedFeaturesCache> shared_cache;
+      if (options.shared_content_features_cache_getter != nullptr) {
+        shared_cache = options.shared_content_features_cache_getter();
+      }
+      NegativeCache* negative_cache = nullptr;
+      if (options.content_negative_cache_getter != nullptr) {
+        negative_cache = options.content_negative_cache_getter();
+      }
+      std::shared_ptr<RedisFeaturesCache> l2_cache;
+      if (options.feature_store_l2_cache_getter != nullptr) {
+        l2_cache = options.feature_store_l2_cache_getter();
+      }
       builder.addStage(
           std::make_unique<ReadFromFeatureStoreStage>(
               stage.id, options.content_features_cache_getter(),
-              options.feature_store_client_getter(),
-              context->platform_config.feature_store_configs[config_idx],
+              options.feature_store_client_getter(config), config,
               context->platform_config.feature_store_timeout,
               context->start_time, std::move(key_generator),
-              std::move(feature_adder)),
+              std::move(feature_adder), std::move(snapshot),
+              std::move(decompressor), std::move(shared_cache),
+              negative_cache, std::move(l2_cache)),
           stage.input_ids,
           delivery::DeliveryLatency_DeliveryMethod_AGGREGATOR__GET_FEATURES);
     } else if (stage.type == "ReadFromUserFeatureStore") {
@@ -294,17 +458,31 @@ std::unique_ptr<Executor>& configureSimpleExecutor(
       };
       auto feature_adder = [&feature_context = context->feature_context](
                                std::string_view _,
-                               delivery_private_features::Features features) {
-        feature_context.addUserFeatures(std::move(features));
+                               const DecodedFeatures& features) {
+        feature_context.mergeUserFeatures(features);
       };
+      const auto& config = feature_store_configs[config_idx];
+      std::shared_ptr<const FeatureDecompressor> decompressor;
+      if (options.feature_decompressor_getter != nullptr) {
+        decompressor = options.feature_decompressor_getter(config);
+      }
+      NegativeCache* negative_cache = nullptr;
+      if (options.non_content_negative_cache_getter != nullptr) {
+        negative_cache = options.non_content_negative_cache_getter();
+      }
+      std::shared_ptr<RedisFeaturesCache> l2_cache;
+      if (options.feature_store_l2_cache_getter != nullptr) {
+        l2_cache = options.feature_store_l2_cache_getter();
+      }
       builder.addStage(
           std::make_unique<ReadFromFeatureStoreStage>(
               stage.id, options.non_content_features_cache_getter(),
-              options.feature_store_client_getter(),
-              context->platform_config.feature_store_configs[config_idx],
+              options.feature_store_client_getter(config), config,
               context->platform_config.feature_store_timeout,
               context->start_time, std::move(key_generator),
-              std::move(feature_adder)),
+              std::move(feature_adder), /*snapshot=*/nullptr,
+              std::move(decompressor), /*shared_cache=*/nullptr,
+              negative_cache, std::move(l2_cache)),
           stage.input_ids,
           delivery::DeliveryLatency_DeliveryMethod_AGGREGATOR__GET_FEATURES);
     } else if (stage.type == "ReadFromCounters") {
@@ -421,11 +599,12 @@ std::unique_ptr<Executor>& configureSimpleExecutor(
                            std::move(context->respond_cb)),
                        stage.input_ids);
     } else if (stage.type == "WriteToPaging") {
-      builder.addStage(std::make_unique<WriteToPagingStage>(
-                           stage.id, options.paging_write_redis_client_getter(),
-                           context->platform_config.paging_config,
-                           context->resp, context->paging_context),
-                       stage.input_ids);
+      builder.addStage(
+          std::make_unique<WriteToPagingStage>(
+              stage.id, options.paging_write_redis_client_getter(),
+              context->platform_config.paging_config, context->resp,
+              context->execution_insertions, context->paging_context),
+          stage.input_ids);
     } else if (stage.type == "WriteToDeliveryLog") {
       // Make an exception and give this stage visibility of the entire context
       // because it needs most of the information.
@@ -434,13 +613,18 @@ std::unique_ptr<Executor>& configureSimpleExecutor(
               stage.id, *context, options.delivery_log_writer_getter()),
           stage.input_ids);
     } else if (stage.type == "WriteOutStrangerFeatures") {
+      StrangerFeatureBatcher* batcher = nullptr;
+      if (options.stranger_feature_batcher_getter != nullptr) {
+        batcher = options.stranger_feature_batcher_getter();
+      }
       builder.addStage(
           std::make_unique<WriteOutStrangerFeaturesStage>(
               stage.id,
               context->platform_config.sparse_features_config
                   .stranger_feature_sampling_rate,
               context->start_time, context->feature_context,
-              context->execution_insertions, options.sqs_client_getter()),
+              context->execution_insertions, options.sqs_client_getter(),
+              batcher),
           stage.input_ids);
     } else if (stage.type == "WriteToMonitoring") {
       builder.addStage(
@@ -453,6 +637,25 @@ std::unique_ptr<Executor>& configureSimpleExecutor(
     }
   }
 
+  // When every position on a page was preallocated there is nothing left for
+  // feature processing to decide, so go straight from paging to responding.
+  const auto& stages = context->platform_config.execution_config.stages;
+  auto read_from_paging =
+      std::find_if(stages.begin(), stages.end(), [](const auto& stage) {
+        return stage.type == "ReadFromPaging";
+      });
+  if (context->platform_config.paging_config.num_preallocated_pages > 0 &&
+      read_from_paging != stages.end()) {
+    for (const auto& stage : stages) {
+      if (skippable_when_preallocated.contains(stage.type)) {
+        builder.skipIf(stage.id, read_from_paging->id,
+                       [&paging_context = context->paging_context]() {
+                         return paging_context.is_fully_allocated;
+                       });
+      }
+    }
+  }
+
   // It was a goal to not give each stage shared ownership of the context for
   // clearer APIs. The context contains everything needed for processing the
   // request, including the executor, but the executor defines the lifetime of
@@ -18,15 +18,19 @@
 
 #include <stddef.h>
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "execution/executor.h"
 #include "proto/delivery/INTERNAL_execution.pb.h"
+#include "utils/metrics.h"
 
 namespace trantor {
 class EventLoop;
@@ -35,12 +39,17 @@ class EventLoop;
 namespace delivery {
 class Context;
 class Stage;
+class Trace;
 
 // Whether feature store configs are for item or user feature stores is
 // indicated by a "type" integer with no Protobuf definition currently.
 const int item_feature_store_type = 1;
 const int user_feature_store_type = 2;
 
+// Returns the number of stages queued on the calling thread's event loop which
+// haven't started running yet.
+std::atomic<int64_t>& queuedStages();
+
 // This should be preferred to directly using SimpleExecutorBuilder.
 std::unique_ptr<Executor>& configureSimpleExecutor(
     std::unique_ptr<Context> context, const ConfigurationOptions& options);
@@ -48,8 +57,15 @@ std::unique_ptr<Executor>& configureSimpleExecutor(
 class SimpleExecutor : public Executor {
  public:
   explicit SimpleExecutor(std::function<void()>&& clean_up_cb,
-                          std::vector<ExecutorNode> nodes)
-      : clean_up_cb_(std::move(clean_up_cb)), nodes_(std::move(nodes)) {}
+                          std::vector<ExecutorNode> nodes,
+                          std::shared_ptr<Trace> trace = nullptr)
+      : clean_up_cb_(std::move(clean_up_cb)),
+        nodes_(std::move(nodes)),
+        trace_(std::move(trace)) {
+    if (trace_ != nullptr) {
+      run_returned_micros_.resize(nodes_.size());
+    }
+  }
 
   void execute() override;
 
@@ -62,14 +78,39 @@ class SimpleExecutor : public Executor {
   std::string dotString() const;
 
  private:
+  void queueNode(ExecutorNode& node);
+
   void afterRun(ExecutorNode& curr_node);
 
   void scheduleTimeout(const std::chrono::duration<double>& delay,
                        std::function<void()>&& cb);
 
+  // Add the node's "run" and "async" spans to `trace_`.
+  void traceRunReturned(const ExecutorNode& node);
+  void traceDone(const ExecutorNode& node);
+
   trantor::EventLoop* loop_;
+  // Of `loop_`.
+  std::atomic<int64_t>* queued_stages_;
   std::function<void()> clean_up_cb_;
   std::vector<ExecutorNode> nodes_;
+  std::shared_ptr<Trace> trace_;
+  // Stages can finish on other threads before their run() returns.
+  std::mutex trace_mutex_;
+  // Indexed by stage ID. 0 until the stage's run() returns.
+  std::vector<uint64_t> run_returned_micros_;
+};
+
+// The histograms of stage durations, and how long stages waited on the event
+// loop, by stage name. Keep one for every executor built, so that building one
+// per request doesn't look histograms up in the registry.
+struct StageMetrics {
+  explicit StageMetrics(MetricsRegistry& metrics)
+      : durations(metrics, "delivery_stage_duration_micros", "stage"),
+        queue_delays(metrics, "delivery_stage_queue_delay_micros", "stage") {}
+
+  LabeledHistograms durations;
+  LabeledHistograms queue_delays;
 };
 
 // This currently doesn't do any any checks for sanity or that stages are
@@ -84,6 +125,21 @@ class SimpleExecutorBuilder {
       delivery::DeliveryLatency_DeliveryMethod latency_tag =
           delivery::DeliveryLatency_DeliveryMethod_UNKNOWN_DELIVERY_METHOD);
 
+  // The stage must already have been added. `skip_cb` is checked right before
+  // the stage would otherwise run, and must only depend on state set by the
+  // stage `decided_by_id`. build() aborts unless the skippable stage depends
+  // on that stage, directly or not.
+  void skipIf(size_t stage_id, size_t decided_by_id,
+              std::function<bool()>&& skip_cb);
+
+  // Records each stage's duration, and how long it waited on the event loop,
+  // in `metrics`.
+  void recordMetrics(StageMetrics& metrics) { metrics_ = &metrics; }
+
+  // Records a span for each stage's queueing, running, and asynchronous
+  // waiting in `trace`.
+  void recordTrace(std::shared_ptr<Trace> trace) { trace_ = std::move(trace); }
+
   // The callback is run after all other stages and is responsible for
   // deallocation.
   std::unique_ptr<SimpleExecutor> build(std::function<void()>&& clean_up_cb);
@@ -94,5 +150,9 @@ class SimpleExecutorBuilder {
  private:
   // Index in the vector is equal to the stage ID for the node. Gaps are fine.
   std::vector<ExecutorNode> nodes_;
+  // Pairs of skippable stage IDs and the IDs of the stages deciding the skip.
+  std::vector<std::pair<size_t, size_t>> skip_deciders_;
+  StageMetrics* metrics_ = nullptr;
+  std::shared_ptr<Trace> trace_;
 };
 }  // namespace delivery
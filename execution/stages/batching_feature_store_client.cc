@@ -0,0 +1,160 @@
+#include "execution/stages/batching_feature_store_client.h"
+
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+
+namespace delivery {
+// One per read() call.
+struct FeatureStoreBatcher::Waiter {
+  std::function<void(std::vector<FeatureStoreResult>)> cb;
+  std::mutex mutex;
+  std::vector<FeatureStoreResult> results;
+  // Keys which haven't been resolved by a batch yet.
+  size_t remaining = 0;
+};
+
+struct FeatureStoreBatcher::Batch {
+  uint64_t id = 0;
+  std::string table;
+  std::string key_column;
+  std::string columns;
+  // Each key is only sent once, however many requests wait on it.
+  std::vector<std::string> keys;
+  absl::flat_hash_map<std::string, std::vector<std::shared_ptr<Waiter>>>
+      key_to_waiters;
+};
+
+FeatureStoreBatcher::FeatureStoreBatcher(ClientFactory&& client_factory,
+                                         Scheduler&& scheduler,
+                                         std::chrono::microseconds max_delay,
+                                         size_t max_keys)
+    : client_factory_(std::move(client_factory)),
+      scheduler_(std::move(scheduler)),
+      max_delay_(max_delay),
+      max_keys_(max_keys) {}
+
+FeatureStoreBatcher::~FeatureStoreBatcher() = default;
+
+void FeatureStoreBatcher::read(
+    const std::string& table, const std::string& key_column,
+    const std::vector<std::string>& keys, const std::string& columns,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) {
+  if (keys.empty()) {
+    cb({});
+    return;
+  }
+  auto waiter = std::make_shared<Waiter>();
+  waiter->cb = std::move(cb);
+  waiter->remaining = keys.size();
+
+  const std::string group =
+      absl::StrCat(table, "\x1f", key_column, "\x1f", columns);
+  std::vector<std::unique_ptr<Batch>> full_batches;
+  std::vector<uint64_t> new_batch_ids;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& key : keys) {
+      auto& batch = pending_[group];
+      if (batch == nullptr) {
+        batch = std::make_unique<Batch>();
+        batch->id = next_batch_id_++;
+        batch->table = table;
+        batch->key_column = key_column;
+        batch->columns = columns;
+        new_batch_ids.emplace_back(batch->id);
+      }
+      auto& waiters = batch->key_to_waiters[key];
+      if (waiters.empty()) {
+        batch->keys.emplace_back(key);
+      }
+      waiters.emplace_back(waiter);
+      if (batch->keys.size() >= max_keys_) {
+        full_batches.emplace_back(std::move(batch));
+        pending_.erase(group);
+      }
+    }
+  }
+
+  // Batches which fill up before their delay are sent now. Their scheduled
+  // flushes then find a different batch, or none, and do nothing.
+  for (uint64_t id : new_batch_ids) {
+    scheduler_(max_delay_, [this, group, id]() { flush(group, id); });
+  }
+  for (auto& batch : full_batches) {
+    send(std::move(batch));
+  }
+}
+
+void FeatureStoreBatcher::flush(const std::string& group, uint64_t id) {
+  std::unique_ptr<Batch> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_.find(group);
+    if (it == pending_.end() || it->second->id != id) {
+      return;
+    }
+    batch = std::move(it->second);
+    pending_.erase(it);
+  }
+  send(std::move(batch));
+}
+
+void FeatureStoreBatcher::send(std::unique_ptr<Batch> batch) {
+  std::shared_ptr<const FeatureStoreClient> client = client_factory_();
+  std::shared_ptr<Batch> shared_batch = std::move(batch);
+  // The client is kept alive until its callback is done with.
+  client->readBatch(
+      shared_batch->table, shared_batch->key_column, shared_batch->keys,
+      shared_batch->columns,
+      [client, shared_batch](std::vector<FeatureStoreResult> results) {
+        auto& key_to_waiters = shared_batch->key_to_waiters;
+        for (const auto& result : results) {
+          auto it = key_to_waiters.find(result.key);
+          if (it == key_to_waiters.end()) {
+            continue;
+          }
+          for (const auto& waiter : it->second) {
+            resolve(waiter, &result);
+          }
+          key_to_waiters.erase(it);
+        }
+        // Keys without results don't exist.
+        for (const auto& [key, waiters] : key_to_waiters) {
+          for (const auto& waiter : waiters) {
+            resolve(waiter, nullptr);
+          }
+        }
+      });
+}
+
+void FeatureStoreBatcher::resolve(const std::shared_ptr<Waiter>& waiter,
+                                  const FeatureStoreResult* result) {
+  std::vector<FeatureStoreResult> results;
+  {
+    std::lock_guard<std::mutex> lock(waiter->mutex);
+    if (result != nullptr) {
+      waiter->results.emplace_back(*result);
+    }
+    if (--waiter->remaining > 0) {
+      return;
+    }
+    results = std::move(waiter->results);
+  }
+  waiter->cb(std::move(results));
+}
+
+void BatchingFeatureStoreClient::read(
+    const std::string& table, const std::string& key_column,
+    const std::string& key, const std::string& columns,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
+  batcher_.read(table, key_column, {key}, columns, std::move(cb));
+}
+
+void BatchingFeatureStoreClient::readBatch(
+    const std::string& table, const std::string& key_column,
+    const std::vector<std::string>& keys, const std::string& columns,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
+  batcher_.read(table, key_column, keys, columns, std::move(cb));
+}
+}  // namespace delivery
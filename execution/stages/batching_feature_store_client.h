@@ -0,0 +1,83 @@
+// Collects feature store reads from concurrent requests into shared batches.
+// Under load, each request otherwise sends its own small batch, which costs
+// more per key and puts more pressure on the client's thread pool.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "execution/stages/feature_store_client.h"
+
+namespace delivery {
+class FeatureStoreBatcher {
+ public:
+  // Makes the client which sends a batch. This is called per batch so that
+  // clients can be set up for when the batch is actually sent.
+  using ClientFactory =
+      std::function<std::unique_ptr<const FeatureStoreClient>()>;
+  // Runs the callback after the delay.
+  using Scheduler = std::function<void(const std::chrono::duration<double>&,
+                                       std::function<void()>&&)>;
+
+  // A batch is sent once it has `max_keys` keys or `max_delay` after its first
+  // key was added, whichever is first.
+  FeatureStoreBatcher(ClientFactory&& client_factory, Scheduler&& scheduler,
+                      std::chrono::microseconds max_delay, size_t max_keys);
+  ~FeatureStoreBatcher();
+
+  // Same contract as FeatureStoreClient::readBatch().
+  void read(const std::string& table, const std::string& key_column,
+            const std::vector<std::string>& keys, const std::string& columns,
+            std::function<void(std::vector<FeatureStoreResult>)>&& cb);
+
+ private:
+  struct Waiter;
+  struct Batch;
+
+  // Sends the pending batch for `group` if it's still batch `id`.
+  void flush(const std::string& group, uint64_t id);
+  void send(std::unique_ptr<Batch> batch);
+  // Calls back once every key of the waiter's read is resolved. A null result
+  // means the key doesn't exist.
+  static void resolve(const std::shared_ptr<Waiter>& waiter,
+                      const FeatureStoreResult* result);
+
+  ClientFactory client_factory_;
+  Scheduler scheduler_;
+  std::chrono::microseconds max_delay_;
+  size_t max_keys_;
+
+  std::mutex mutex_;
+  uint64_t next_batch_id_ = 0;
+  // Reads with different tables or columns can't share a batch.
+  absl::flat_hash_map<std::string, std::unique_ptr<Batch>> pending_;
+};
+
+// Sends reads through a shared FeatureStoreBatcher.
+class BatchingFeatureStoreClient : public FeatureStoreClient {
+ public:
+  explicit BatchingFeatureStoreClient(FeatureStoreBatcher& batcher)
+      : batcher_(batcher) {}
+
+  void read(
+      const std::string& table, const std::string& key_column,
+      const std::string& key, const std::string& columns,
+      std::function<void(std::vector<FeatureStoreResult>)>&& cb) const override;
+  void readBatch(
+      const std::string& table, const std::string& key_column,
+      const std::vector<std::string>& keys, const std::string& columns,
+      std::function<void(std::vector<FeatureStoreResult>)>&& cb) const override;
+
+ private:
+  FeatureStoreBatcher& batcher_;
+};
+}  // namespace delivery
@@ -3,22 +3,135 @@
 
 #pragma once
 
+#include <stddef.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
 #include "absl/container/flat_hash_map.h"
-#include "proto/delivery/private/features/features.pb.h"
-#include "thread-safe-lru/scalable-cache.h"
+#include "absl/hash/hash.h"
+#include "execution/decoded_features.h"
+#include "execution/stages/lru_cache.h"
 
 namespace delivery {
-// "ThreadSafeString" isn't a great description. This doesn't do any
-// ref-counting. It's just a memoized string to avoid redundant hash cost.
-typedef tstarling::ThreadSafeStringKey CacheKey;
+// This doesn't own the key. It just memoizes the key's hash.
+typedef LruCacheKey CacheKey;
+
+// Config values for CacheAdmission. Empty means LRU.
+const std::string lru_cache_admission = "lru";
+const std::string tiny_lfu_cache_admission = "tinyLfu";
+
+// Returns a time in [now + ttl, now + ttl * (1 + jitter)). Entries written
+// together, such as on startup, then don't all expire together.
+inline uint64_t jitteredExpireTime(std::string_view key, uint64_t now,
+                                   uint64_t ttl_millis, double jitter) {
+  auto max_jitter = static_cast<uint64_t>(ttl_millis * jitter);
+  if (max_jitter == 0) {
+    return now + ttl_millis;
+  }
+  return now + ttl_millis + absl::HashOf(key, now) % max_jitter;
+}
+
+// The LRU never overwrites the value of an existing key, so refreshing an
+// entry swaps what it points to instead. Copies share the same entry.
+template <typename T>
+class RefreshableEntry {
+ public:
+  explicit RefreshableEntry(T entry)
+      : entry_(std::make_shared<std::shared_ptr<const T>>(
+            std::make_shared<const T>(std::move(entry)))) {}
+
+  std::shared_ptr<const T> load() const {
+    return std::atomic_load(entry_.get());
+  }
+
+  void store(T entry) const {
+    std::atomic_store(entry_.get(),
+                      std::make_shared<const T>(std::move(entry)));
+  }
+
+ private:
+  std::shared_ptr<std::shared_ptr<const T>> entry_;
+};
+
+// Inserts `entry`, or refreshes the existing entry for `key`.
+template <typename C, typename T>
+void insertOrRefresh(C& cache, std::string_view key, T entry) {
+  CacheKey cache_key(key.data(), key.size());
+  if (!cache.insert(cache_key, RefreshableEntry<T>(entry))) {
+    typename C::ConstAccessor accessor;
+    if (cache.find(accessor, cache_key)) {
+      accessor->store(std::move(entry));
+      cache.reweigh(cache_key);
+    }
+  }
+}
+
+// Each thread keeps loaded entries of a shared cache in a LocalCache of this
+// size, so hot keys are found without locking. Refreshes of the shared entry
+// aren't visible through the local one, so only serve local entries which
+// don't need refreshing, and otherwise go to the shared cache. Erasures are
+// visible, since the local cache checks the shared one's EraseEpochs.
+constexpr size_t local_cache_size = 4'096;
+
+// Returns the calling thread's local cache for `cache`.
+template <typename T>
+LocalCache<T>& threadLocalCache(
+    const ShardedLruCache<RefreshableEntry<T>>& cache) {
+  thread_local absl::flat_hash_map<const void*,
+                                   std::unique_ptr<LocalCache<T>>>
+      local_caches;
+  auto& local = local_caches[&cache];
+  // Clearing the shared cache clears the local ones.
+  if (local == nullptr || local->generation() != cache.generation()) {
+    local = std::make_unique<LocalCache<T>>(
+        local_cache_size, cache.generation(), &cache.eraseEpochs());
+  }
+  return *local;
+}
+
+struct FeaturesEntry {
+  // Decoded once on insert and shared by every request which reads the entry.
+  std::shared_ptr<const DecodedFeatures> features =
+      std::make_shared<const DecodedFeatures>();
+  // Past this, the entry is still served but refreshed in the background.
+  uint64_t soft_expire_time = 0;
+  // Past this, the entry is treated as missing.
+  uint64_t expire_time = 0;
+};
+typedef RefreshableEntry<FeaturesEntry> CachedFeatures;
 
-typedef tstarling::ThreadSafeScalableCache<
-    CacheKey, delivery_private_features::Features, CacheKey::HashCompare>
-    FeaturesCache;
+// For byte-budgeted caches.
+inline size_t cachedFeaturesBytes(const CachedFeatures& entry) {
+  return sizeof(FeaturesEntry) + entry.load()->features->bytes();
+}
+
+typedef ShardedLruCache<CachedFeatures> FeaturesCache;
 
 namespace counters {
-typedef tstarling::ThreadSafeScalableCache<
-    CacheKey, absl::flat_hash_map<uint64_t, uint64_t>, CacheKey::HashCompare>
-    Cache;
+struct CacheTtl {
+  uint64_t millis = 1'000 * 60 * 15;
+  // Up to this fraction of `millis` is randomly added per entry.
+  double jitter = 0.1;
+};
+
+struct CountsEntry {
+  absl::flat_hash_map<uint64_t, uint64_t> counts;
+  // Past this, the entry is treated as missing.
+  uint64_t expire_time = 0;
+};
+
+typedef ShardedLruCache<RefreshableEntry<CountsEntry>> Cache;
+
+// For byte-budgeted caches.
+inline size_t cachedCountsBytes(const RefreshableEntry<CountsEntry>& entry) {
+  // Each slot also has a control byte.
+  return sizeof(CountsEntry) +
+         entry.load()->counts.capacity() *
+             (sizeof(std::pair<const uint64_t, uint64_t>) + 1);
 }
+}  // namespace counters
 }  // namespace delivery
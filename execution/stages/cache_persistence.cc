@@ -0,0 +1,70 @@
+#include "execution/stages/cache_persistence.h"
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "execution/decoded_features.h"
+#include "execution/stages/feature_snapshot.h"
+
+namespace delivery {
+bool dumpFeaturesCache(const FeaturesCache& cache, const std::string& path,
+                       size_t max_keys, uint64_t now, size_t& num_dumped,
+                       std::string& error) {
+  std::vector<std::pair<std::string, DecodedFeatures>> entries;
+  for (auto& [key, cached] : cache.hottest(max_keys)) {
+    auto entry = cached.load();
+    if (now >= entry->expire_time) {
+      continue;
+    }
+    entries.emplace_back(std::move(key), *entry->features);
+  }
+  num_dumped = entries.size();
+  return writeFeatureSnapshot(path, std::move(entries), error);
+}
+
+bool warmFeaturesCache(FeaturesCache& cache, const std::string& path,
+                       uint64_t now, uint64_t ttl_millis, double jitter,
+                       size_t& num_warmed, std::string& error) {
+  num_warmed = 0;
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    if (errno == ENOENT) {
+      return true;
+    }
+    error = absl::StrCat("Unable to stat features cache dump ", path, ": ",
+                         std::strerror(errno));
+    return false;
+  }
+  uint64_t dump_time = static_cast<uint64_t>(st.st_mtime) * 1'000;
+  if (dump_time + ttl_millis * (1 + jitter) <= now) {
+    return true;
+  }
+  auto snapshot = FeatureSnapshot::open(path, error);
+  if (snapshot == nullptr) {
+    return false;
+  }
+  for (size_t i = 0; i < snapshot->size(); ++i) {
+    auto [key, features] = snapshot->entry(i);
+    if (features == nullptr) {
+      continue;
+    }
+    FeaturesEntry entry;
+    entry.features = std::move(features);
+    entry.expire_time =
+        jitteredExpireTime(key, dump_time, ttl_millis, jitter);
+    entry.soft_expire_time = entry.expire_time;
+    if (now >= entry.expire_time) {
+      continue;
+    }
+    num_warmed +=
+        cache.insert(CacheKey(key.data(), key.size()), CachedFeatures(entry));
+  }
+  return true;
+}
+}  // namespace delivery
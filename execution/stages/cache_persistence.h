@@ -0,0 +1,29 @@
+// Persists the hottest entries of a features cache to local disk so that a
+// restarted instance can warm its cache before serving, rather than sending
+// every key to feature store again. Dumps are FeatureSnapshot files.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <cstdint>
+#include <string>
+
+#include "execution/stages/cache.h"
+
+namespace delivery {
+// Writes up to `max_keys` of the hottest unexpired entries of `cache` to
+// `path`. Returns false and sets `error` on failure.
+bool dumpFeaturesCache(const FeaturesCache& cache, const std::string& path,
+                       size_t max_keys, uint64_t now, size_t& num_dumped,
+                       std::string& error);
+
+// Inserts the entries of the dump at `path` into `cache`. Warmed entries
+// expire `ttl_millis` after the dump was written, plus up to `jitter` of that,
+// so entries from an old dump aren't served and those from a new one aren't
+// all read again together. A missing dump warms nothing and isn't an error.
+// Returns false and sets `error` if the dump can't be read.
+bool warmFeaturesCache(FeaturesCache& cache, const std::string& path,
+                       uint64_t now, uint64_t ttl_millis, double jitter,
+                       size_t& num_warmed, std::string& error);
+}  // namespace delivery
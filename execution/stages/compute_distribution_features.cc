@@ -151,6 +151,9 @@ void applyDistributionFeaturesToRequest(
 
           // Just report strangers at request scope instead of for each
           // insertion.
+          if (!scope.record_stranger_paths) {
+            continue;
+          }
           scope.stranger_feature_paths[metadata.set_value_path] =
               metadata.set_value_id;
           scope.stranger_feature_paths[metadata.non_zero_value_path] =
@@ -202,47 +202,51 @@ void processConfiguredTimeFeatures(
 
     scope.int_features[metadata.millis_since_midnight_id] =
         processed.millis_since_midnight;
-    scope.stranger_feature_paths[metadata.millis_since_midnight_path] =
-        metadata.millis_since_midnight_id;
 
     scope.features[metadata.hour_of_day_id] =
         static_cast<float>(processed.hour_of_day);
-    scope.stranger_feature_paths[metadata.hour_of_day_path] =
-        metadata.hour_of_day_id;
     scope.features[metadata.hour_of_day_sin_id] =
         periodic_time_values.hour_of_day_sin_values[processed.hour_of_day];
-    scope.stranger_feature_paths[metadata.hour_of_day_sin_path] =
-        metadata.hour_of_day_sin_id;
     scope.features[metadata.hour_of_day_cos_id] =
         periodic_time_values.hour_of_day_cos_values[processed.hour_of_day];
-    scope.stranger_feature_paths[metadata.hour_of_day_cos_path] =
-        metadata.hour_of_day_cos_id;
 
     scope.features[metadata.day_of_week_id] =
         static_cast<float>(processed.day_of_week);
-    scope.stranger_feature_paths[metadata.day_of_week_path] =
-        metadata.day_of_week_id;
     scope.features[metadata.day_of_week_sin_id] =
         periodic_time_values.day_of_week_sin_values[processed.day_of_week];
-    scope.stranger_feature_paths[metadata.day_of_week_sin_path] =
-        metadata.day_of_week_sin_id;
     scope.features[metadata.day_of_week_cos_id] =
         periodic_time_values.day_of_week_cos_values[processed.day_of_week];
-    scope.stranger_feature_paths[metadata.day_of_week_cos_path] =
-        metadata.day_of_week_cos_id;
 
     scope.features[metadata.day_of_month_id] =
         static_cast<float>(processed.day_of_month);
-    scope.stranger_feature_paths[metadata.day_of_month_path] =
-        metadata.day_of_month_id;
     scope.features[metadata.day_of_month_sin_id] =
         periodic_time_values
             .day_of_month_sin_values[processed.day_of_month - 1];
-    scope.stranger_feature_paths[metadata.day_of_month_sin_path] =
-        metadata.day_of_month_sin_id;
     scope.features[metadata.day_of_month_cos_id] =
         periodic_time_values
             .day_of_month_cos_values[processed.day_of_month - 1];
+
+    if (!scope.record_stranger_paths) {
+      continue;
+    }
+    scope.stranger_feature_paths[metadata.millis_since_midnight_path] =
+        metadata.millis_since_midnight_id;
+    scope.stranger_feature_paths[metadata.hour_of_day_path] =
+        metadata.hour_of_day_id;
+    scope.stranger_feature_paths[metadata.hour_of_day_sin_path] =
+        metadata.hour_of_day_sin_id;
+    scope.stranger_feature_paths[metadata.hour_of_day_cos_path] =
+        metadata.hour_of_day_cos_id;
+    scope.stranger_feature_paths[metadata.day_of_week_path] =
+        metadata.day_of_week_id;
+    scope.stranger_feature_paths[metadata.day_of_week_sin_path] =
+        metadata.day_of_week_sin_id;
+    scope.stranger_feature_paths[metadata.day_of_week_cos_path] =
+        metadata.day_of_week_cos_id;
+    scope.stranger_feature_paths[metadata.day_of_month_path] =
+        metadata.day_of_month_id;
+    scope.stranger_feature_paths[metadata.day_of_month_sin_path] =
+        metadata.day_of_month_sin_id;
     scope.stranger_feature_paths[metadata.day_of_month_cos_path] =
         metadata.day_of_month_cos_id;
   }
@@ -221,14 +221,12 @@ void ReadFromCountersStage::read(
 }
 
 void ReadFromCountersStage::cacheAsideRead(
-    std::unique_ptr<Cache>& cache, const TableInfo& table,
+    std::unique_ptr<Cache>& cache, const CacheTtl& ttl, const TableInfo& table,
     const std::string& key, uint64_t start_time,
     absl::flat_hash_map<uint64_t, uint64_t>& counts,
     std::shared_ptr<std::function<void()>> finish, std::string_view segment) {
-  CacheKey cache_key;
+  std::string cache_key;
   if (cache != nullptr) {
-    Cache::ConstAccessor accessor;
-    std::string timed_key = makeTimedKey(key, start_time);
     // The current implementation of counters is inefficient. The hash key does
     // not indicate the segment (i.e. user agent) so each read of a segmented
     // table produces the counts for all segments. parseCounts() is also
@@ -236,25 +234,42 @@ void ReadFromCountersStage::cacheAsideRead(
     // the count for this request's segment and the sum of all segments. We know
     // this is bad. In the meanwhile, for segmented tables we specify the
     // segment in the cache key to avoid natural collisions of the hash key.
-    if (!segment.empty()) {
-      timed_key = absl::StrCat(timed_key, segment);
-    }
-    cache_key = CacheKey(timed_key.data(), timed_key.size());
-    if (cache->find(accessor, cache_key)) {
-      counts = *accessor.get();
+    cache_key = segment.empty() ? key : absl::StrCat(key, segment);
+    LocalCache<CountsEntry>& local_cache = threadLocalCache(*cache);
+    const CountsEntry* local_entry =
+        local_cache.find({cache_key.data(), cache_key.size()});
+    if (local_entry != nullptr && start_time < local_entry->expire_time) {
+      counts = local_entry->counts;
       (*finish)();
       return;
     }
-  }
-  client_->hGetAll(
-      key, [this, &counts, &table, &cache, cache_key,
-            finish = std::move(finish)](const std::vector<std::string>& data) {
-        counts = parseCounts(data, table);
-        if (cache != nullptr) {
-          cache->insert(cache_key, counts);
-        }
+    Cache::ConstAccessor accessor;
+    const uint64_t erase_epoch = cache->eraseEpochs().current();
+    if (cache->find(accessor, {cache_key.data(), cache_key.size()})) {
+      auto entry = accessor->load();
+      if (start_time < entry->expire_time) {
+        counts = entry->counts;
+        local_cache.insert({cache_key.data(), cache_key.size()},
+                           std::move(entry), erase_epoch);
         (*finish)();
-      });
+        return;
+      }
+    }
+  }
+  client_->hGetAll(key, [this, &counts, &table, &cache, ttl,
+                         cache_key = std::move(cache_key), start_time,
+                         finish = std::move(finish)](
+                            const std::vector<std::string>& data) {
+    counts = parseCounts(data, table);
+    if (cache != nullptr) {
+      insertOrRefresh(
+          *cache, cache_key,
+          CountsEntry{.counts = counts,
+                      .expire_time = jitteredExpireTime(
+                          cache_key, start_time, ttl.millis, ttl.jitter)});
+    }
+    (*finish)();
+  });
 }
 
 void ReadFromCountersStage::run(
@@ -279,8 +294,8 @@ void ReadFromCountersStage::run(
   // Global. This shouldn't ever be null but let's be defensive.
   if (database_.global != nullptr) {
     ++(*remaining_reads);
-    cacheAsideRead(caches_.global_counts_cache, *database_.global,
-                   absl::StrCat(platform_id_), start_time_,
+    cacheAsideRead(caches_.global_counts_cache, caches_.global_counts_ttl,
+                   *database_.global, absl::StrCat(platform_id_), start_time_,
                    counters_context_.global_counts, finish, cat_user_agent);
   } else {
     errors_.emplace_back(
@@ -291,7 +306,8 @@ void ReadFromCountersStage::run(
     if (!req_.user_info().user_id().empty()) {
       if (database_.user != nullptr) {
         ++(*remaining_reads);
-        cacheAsideRead(caches_.user_counts_cache, *database_.user,
+        cacheAsideRead(caches_.user_counts_cache, caches_.user_counts_ttl,
+                       *database_.user,
                        makeUserIdKey(platform_id_, req_.user_info().user_id()),
                        start_time_, counters_context_.user_counts, finish);
       }
@@ -307,7 +323,8 @@ void ReadFromCountersStage::run(
       if (database_.log_user != nullptr) {
         ++(*remaining_reads);
         cacheAsideRead(
-            caches_.user_counts_cache, *database_.log_user,
+            caches_.user_counts_cache, caches_.user_counts_ttl,
+            *database_.log_user,
             makeUserIdKey(platform_id_, req_.user_info().log_user_id()),
             start_time_, counters_context_.log_user_counts, finish);
       }
@@ -323,7 +340,8 @@ void ReadFromCountersStage::run(
   // Query counts.
   if (database_.query != nullptr) {
     ++(*remaining_reads);
-    cacheAsideRead(caches_.query_counts_cache, *database_.query,
+    cacheAsideRead(caches_.query_counts_cache, caches_.query_counts_ttl,
+                   *database_.query,
                    makeQueryKey(platform_id_, hashed_search_query), start_time_,
                    counters_context_.query_counts, finish);
   }
@@ -337,7 +355,8 @@ void ReadFromCountersStage::run(
     const auto& content_id = insertion.content_id();
     if (database_.content != nullptr) {
       ++(*remaining_reads);
-      cacheAsideRead(caches_.item_counts_cache, *database_.content,
+      cacheAsideRead(caches_.item_counts_cache, caches_.item_counts_ttl,
+                     *database_.content,
                      makeContentKey(platform_id_, content_id), start_time_,
                      counters_context_.content_counts[content_id], finish,
                      cat_user_agent);
@@ -345,7 +364,8 @@ void ReadFromCountersStage::run(
     if (database_.content_query != nullptr) {
       ++(*remaining_reads);
       cacheAsideRead(
-          caches_.item_query_counts_cache, *database_.content_query,
+          caches_.item_query_counts_cache, caches_.item_query_counts_ttl,
+          *database_.content_query,
           makeContentQueryKey(platform_id_, content_id, hashed_search_query),
           start_time_, counters_context_.content_query_counts[content_id],
           finish);
@@ -75,6 +75,12 @@ struct Caches {
   std::unique_ptr<Cache> user_counts_cache;
   std::unique_ptr<Cache> query_counts_cache;
   std::unique_ptr<Cache> item_query_counts_cache;
+
+  CacheTtl global_counts_ttl;
+  CacheTtl item_counts_ttl;
+  CacheTtl user_counts_ttl;
+  CacheTtl query_counts_ttl;
+  CacheTtl item_query_counts_ttl;
 };
 
 struct RateInfo {
@@ -146,8 +152,9 @@ class ReadFromCountersStage : public Stage {
   void read(const TableInfo& table, const std::string& key,
             absl::flat_hash_map<uint64_t, uint64_t>& counts,
             std::shared_ptr<std::function<void()>> finish);
-  void cacheAsideRead(std::unique_ptr<Cache>& cache, const TableInfo& table,
-                      const std::string& key, uint64_t start_time,
+  void cacheAsideRead(std::unique_ptr<Cache>& cache, const CacheTtl& ttl,
+                      const TableInfo& table, const std::string& key,
+                      uint64_t start_time,
                       absl::flat_hash_map<uint64_t, uint64_t>& counts,
                       std::shared_ptr<std::function<void()>> finish,
                       std::string_view segment = {});
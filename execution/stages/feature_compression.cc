@@ -0,0 +1,114 @@
+#include "execution/stages/feature_compression.h"
+
+#include <zstd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+
+namespace delivery {
+namespace {
+// Decompressed values larger than this are treated as corrupt.
+constexpr uint64_t max_decompressed_size = 64 << 20;
+
+// Decompression contexts aren't thread-safe but are expensive to create, so
+// each thread reuses its own.
+ZSTD_DCtx* threadDecompressionContext() {
+  thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(
+      ZSTD_createDCtx(), ZSTD_freeDCtx);
+  return context.get();
+}
+}  // namespace
+
+struct FeatureDecompressor::Dictionary {
+  ZSTD_DDict* ddict = nullptr;
+
+  ~Dictionary() { ZSTD_freeDDict(ddict); }
+};
+
+bool isCompressedFeatureValue(std::string_view value) {
+  // The frame magic number is stored little-endian.
+  return value.size() >= 4 &&
+         static_cast<uint8_t>(value[0]) == (ZSTD_MAGICNUMBER & 0xff) &&
+         static_cast<uint8_t>(value[1]) == ((ZSTD_MAGICNUMBER >> 8) & 0xff) &&
+         static_cast<uint8_t>(value[2]) == ((ZSTD_MAGICNUMBER >> 16) & 0xff) &&
+         static_cast<uint8_t>(value[3]) == ((ZSTD_MAGICNUMBER >> 24) & 0xff);
+}
+
+bool compressFeatureValue(std::string_view value,
+                          const std::string& dictionary, int level,
+                          std::string& out, std::string& error) {
+  std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(),
+                                                            ZSTD_freeCCtx);
+  out.resize(ZSTD_compressBound(value.size()));
+  size_t size = ZSTD_compress_usingDict(
+      context.get(), out.data(), out.size(), value.data(), value.size(),
+      dictionary.data(), dictionary.size(), level);
+  if (ZSTD_isError(size)) {
+    error = absl::StrCat("Unable to compress feature value: ",
+                         ZSTD_getErrorName(size));
+    return false;
+  }
+  out.resize(size);
+  return true;
+}
+
+FeatureDecompressor::FeatureDecompressor(
+    std::unique_ptr<Dictionary> dictionary)
+    : dictionary_(std::move(dictionary)) {}
+
+FeatureDecompressor::~FeatureDecompressor() = default;
+
+std::shared_ptr<const FeatureDecompressor> FeatureDecompressor::create(
+    const std::string& dictionary, std::string& error) {
+  auto digested = std::make_unique<Dictionary>();
+  if (!dictionary.empty()) {
+    digested->ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+    if (digested->ddict == nullptr) {
+      error = "Invalid feature compression dictionary";
+      return nullptr;
+    }
+  }
+  return std::shared_ptr<const FeatureDecompressor>(
+      new FeatureDecompressor(std::move(digested)));
+}
+
+std::shared_ptr<const FeatureDecompressor> FeatureDecompressor::load(
+    const std::string& path, std::string& error) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.good()) {
+    error = absl::StrCat("Unable to open feature compression dictionary ",
+                         path);
+    return nullptr;
+  }
+  std::string dictionary((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+  return create(dictionary, error);
+}
+
+bool FeatureDecompressor::decompress(std::string_view value, std::string& out,
+                                     std::string& error) const {
+  // Writers always know the value's size up front, so frames without a
+  // content size aren't supported.
+  uint64_t size = ZSTD_getFrameContentSize(value.data(), value.size());
+  if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN ||
+      size > max_decompressed_size) {
+    error = "Invalid compressed feature value";
+    return false;
+  }
+  out.resize(size);
+  size_t result = ZSTD_decompress_usingDDict(
+      threadDecompressionContext(), out.data(), out.size(), value.data(),
+      value.size(), dictionary_->ddict);
+  if (ZSTD_isError(result)) {
+    error = absl::StrCat("Unable to decompress feature value: ",
+                         ZSTD_getErrorName(result));
+    return false;
+  }
+  out.resize(result);
+  return true;
+}
+}  // namespace delivery
@@ -0,0 +1,56 @@
+// Feature store values are large, repetitive FeaturesList protobufs. They may
+// be stored as zstd frames compressed with a shared, trained dictionary, which
+// cuts read capacity and network transfer. Values are decompressed once, when
+// they're read into the cache.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace delivery {
+// Value for FeatureStoreConfig::compression.
+const std::string zstd_feature_compression = "zstd";
+
+// Returns true if `value` starts with a zstd frame. FeaturesList bytes never
+// do, so compressed and uncompressed values can be mixed in one table while a
+// table is migrated.
+bool isCompressedFeatureValue(std::string_view value);
+
+// Compresses `value` with `dictionary`. This is what writers of compressed
+// values should use. An empty dictionary compresses without one.
+bool compressFeatureValue(std::string_view value,
+                          const std::string& dictionary, int level,
+                          std::string& out, std::string& error);
+
+// Thread-safe. The digested dictionary is shared by all threads.
+class FeatureDecompressor {
+ public:
+  ~FeatureDecompressor();
+  FeatureDecompressor(const FeatureDecompressor&) = delete;
+  FeatureDecompressor& operator=(const FeatureDecompressor&) = delete;
+
+  // Returns nullptr and sets `error` if `dictionary` is invalid. An empty
+  // dictionary decompresses values compressed without one.
+  static std::shared_ptr<const FeatureDecompressor> create(
+      const std::string& dictionary, std::string& error);
+  // Same as create(), with the dictionary read from `path`.
+  static std::shared_ptr<const FeatureDecompressor> load(
+      const std::string& path, std::string& error);
+
+  // Returns false and sets `error` if `value` isn't a valid frame for this
+  // dictionary.
+  bool decompress(std::string_view value, std::string& out,
+                  std::string& error) const;
+
+ private:
+  struct Dictionary;
+
+  explicit FeatureDecompressor(std::unique_ptr<Dictionary> dictionary);
+
+  std::unique_ptr<Dictionary> dictionary_;
+};
+}  // namespace delivery
@@ -0,0 +1,284 @@
+#include "execution/stages/feature_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "absl/strings/str_cat.h"
+
+namespace delivery {
+namespace {
+constexpr char snapshot_magic[8] = {'P', 'F', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr size_t header_size = sizeof(snapshot_magic) + 4 * sizeof(uint64_t);
+constexpr size_t index_entry_size =
+    2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+// The mapping isn't necessarily aligned for these types, so copy them out.
+template <typename T>
+T readAt(const char* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void append(std::string& out, T value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Bounds-checked reads of an encoded value.
+class ValueReader {
+ public:
+  explicit ValueReader(std::string_view value) : value_(value) {}
+
+  template <typename T>
+  bool read(T& out) {
+    if (value_.size() < sizeof(T)) {
+      return false;
+    }
+    out = readAt<T>(value_.data());
+    value_.remove_prefix(sizeof(T));
+    return true;
+  }
+
+  template <typename V>
+  bool readPairs(std::vector<std::pair<uint64_t, V>>& out) {
+    uint32_t count;
+    if (!read(count) ||
+        value_.size() / (sizeof(uint64_t) + sizeof(V)) < count) {
+      return false;
+    }
+    out.resize(count);
+    for (auto& [id, value] : out) {
+      read(id);
+      read(value);
+    }
+    return true;
+  }
+
+  bool readLists(
+      std::vector<std::pair<uint64_t, std::vector<int64_t>>>& out) {
+    uint32_t count;
+    if (!read(count) || value_.size() / sizeof(uint64_t) < count) {
+      return false;
+    }
+    out.resize(count);
+    for (auto& [id, values] : out) {
+      uint32_t num_values;
+      if (!read(id) || !read(num_values) ||
+          value_.size() / sizeof(int64_t) < num_values) {
+        return false;
+      }
+      values.resize(num_values);
+      for (auto& value : values) {
+        read(value);
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::string_view value_;
+};
+}  // namespace
+
+FeatureSnapshot::~FeatureSnapshot() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+std::shared_ptr<const FeatureSnapshot> FeatureSnapshot::open(
+    const std::string& path, std::string& error) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = absl::StrCat("Unable to open feature snapshot ", path, ": ",
+                         std::strerror(errno));
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < header_size) {
+    close(fd);
+    error = absl::StrCat("Feature snapshot ", path, " is truncated");
+    return nullptr;
+  }
+  size_t size = st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    error = absl::StrCat("Unable to map feature snapshot ", path, ": ",
+                         std::strerror(errno));
+    return nullptr;
+  }
+  std::shared_ptr<FeatureSnapshot> snapshot(
+      new FeatureSnapshot(static_cast<const char*>(data), size));
+
+  const char* header = snapshot->data_;
+  if (std::memcmp(header, snapshot_magic, sizeof(snapshot_magic)) != 0) {
+    error = absl::StrCat("Feature snapshot ", path, " has an unknown format");
+    return nullptr;
+  }
+  header += sizeof(snapshot_magic);
+  uint64_t num_keys = readAt<uint64_t>(header);
+  uint64_t index_offset = readAt<uint64_t>(header + sizeof(uint64_t));
+  uint64_t keys_offset = readAt<uint64_t>(header + 2 * sizeof(uint64_t));
+  uint64_t values_offset = readAt<uint64_t>(header + 3 * sizeof(uint64_t));
+  if (index_offset > size || keys_offset > size || values_offset > size ||
+      (size - index_offset) / index_entry_size < num_keys) {
+    error = absl::StrCat("Feature snapshot ", path, " has a corrupt header");
+    return nullptr;
+  }
+  snapshot->num_keys_ = num_keys;
+  snapshot->index_ = snapshot->data_ + index_offset;
+  snapshot->keys_ = snapshot->data_ + keys_offset;
+  snapshot->values_ = snapshot->data_ + values_offset;
+
+  // Check every entry once so that lookups don't have to.
+  for (size_t i = 0; i < num_keys; ++i) {
+    IndexEntry entry = snapshot->indexEntry(i);
+    if (entry.key_offset > size - keys_offset ||
+        entry.key_size > size - keys_offset - entry.key_offset ||
+        entry.value_offset > size - values_offset ||
+        entry.value_size > size - values_offset - entry.value_offset ||
+        (i > 0 && snapshot->key(snapshot->indexEntry(i - 1)) >=
+                      snapshot->key(entry))) {
+      error = absl::StrCat("Feature snapshot ", path,
+                           " has a corrupt index entry ", i);
+      return nullptr;
+    }
+  }
+  return snapshot;
+}
+
+FeatureSnapshot::IndexEntry FeatureSnapshot::indexEntry(size_t i) const {
+  const char* entry = index_ + i * index_entry_size;
+  return {.key_offset = readAt<uint64_t>(entry),
+          .value_offset = readAt<uint64_t>(entry + sizeof(uint64_t)),
+          .key_size = readAt<uint32_t>(entry + 2 * sizeof(uint64_t)),
+          .value_size = readAt<uint32_t>(entry + 2 * sizeof(uint64_t) +
+                                         sizeof(uint32_t))};
+}
+
+std::string_view FeatureSnapshot::key(const IndexEntry& entry) const {
+  return {keys_ + entry.key_offset, entry.key_size};
+}
+
+std::shared_ptr<const DecodedFeatures> FeatureSnapshot::find(
+    std::string_view key) const {
+  size_t lo = 0;
+  size_t hi = num_keys_;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    IndexEntry entry = indexEntry(mid);
+    int cmp = this->key(entry).compare(key);
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else if (cmp > 0) {
+      hi = mid;
+    } else {
+      return value(entry);
+    }
+  }
+  return nullptr;
+}
+
+std::pair<std::string_view, std::shared_ptr<const DecodedFeatures>>
+FeatureSnapshot::entry(size_t i) const {
+  IndexEntry entry = indexEntry(i);
+  return {key(entry), value(entry)};
+}
+
+std::shared_ptr<const DecodedFeatures> FeatureSnapshot::value(
+    const IndexEntry& entry) const {
+  auto features = std::make_shared<DecodedFeatures>();
+  if (!decodeFeatureSnapshotValue(
+          {values_ + entry.value_offset, entry.value_size}, *features)) {
+    return nullptr;
+  }
+  return features;
+}
+
+void encodeFeatureSnapshotValue(const DecodedFeatures& features,
+                                std::string& out) {
+  append<uint32_t>(out, features.sparse.size());
+  for (const auto& [id, value] : features.sparse) {
+    append(out, id);
+    append(out, value);
+  }
+  append<uint32_t>(out, features.sparse_id.size());
+  for (const auto& [id, value] : features.sparse_id) {
+    append(out, id);
+    append(out, value);
+  }
+  append<uint32_t>(out, features.sparse_id_list.size());
+  for (const auto& [id, values] : features.sparse_id_list) {
+    append(out, id);
+    append<uint32_t>(out, values.size());
+    for (int64_t value : values) {
+      append(out, value);
+    }
+  }
+}
+
+bool decodeFeatureSnapshotValue(std::string_view value,
+                                DecodedFeatures& features) {
+  ValueReader reader(value);
+  return reader.readPairs(features.sparse) &&
+         reader.readPairs(features.sparse_id) &&
+         reader.readLists(features.sparse_id_list);
+}
+
+bool writeFeatureSnapshot(
+    const std::string& path,
+    std::vector<std::pair<std::string, DecodedFeatures>> entries,
+    std::string& error) {
+  std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  auto last = std::unique(
+      entries.begin(), entries.end(),
+      [](const auto& a, const auto& b) { return a.first == b.first; });
+  entries.erase(last, entries.end());
+
+  std::string index;
+  std::string keys;
+  std::string values;
+  index.reserve(entries.size() * index_entry_size);
+  for (const auto& [key, features] : entries) {
+    size_t value_offset = values.size();
+    encodeFeatureSnapshotValue(features, values);
+    append<uint64_t>(index, keys.size());
+    append<uint64_t>(index, value_offset);
+    append<uint32_t>(index, key.size());
+    append<uint32_t>(index, values.size() - value_offset);
+    keys.append(key);
+  }
+
+  std::string header(snapshot_magic, sizeof(snapshot_magic));
+  append<uint64_t>(header, entries.size());
+  append<uint64_t>(header, header_size);
+  append<uint64_t>(header, header_size + index.size());
+  append<uint64_t>(header, header_size + index.size() + keys.size());
+
+  const std::string tmp_path = absl::StrCat(path, ".tmp");
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out << header << index << keys << values;
+    if (!out.good()) {
+      error = absl::StrCat("Unable to write feature snapshot ", tmp_path);
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    error = absl::StrCat("Unable to rename feature snapshot to ", path, ": ",
+                         std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+}  // namespace delivery
@@ -0,0 +1,85 @@
+// A read-only, memory-mapped snapshot of decoded feature store values. These
+// are bulk-built offline so that most of a catalog can be served locally
+// without going to feature store.
+//
+// The format is, with all integers in host byte order:
+// - Header: 8 magic bytes, then uint64_t key count, index offset, keys offset
+//   and values offset.
+// - Index: one IndexEntry per key, sorted by key.
+// - Keys: the concatenated keys.
+// - Values: the concatenated encoded DecodedFeatures. Each array is encoded as
+//   a uint32_t count followed by its (ID, value) pairs. Lists are encoded as
+//   their ID, a uint32_t count and their values.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "execution/decoded_features.h"
+
+namespace delivery {
+class FeatureSnapshot {
+ public:
+  ~FeatureSnapshot();
+  FeatureSnapshot(const FeatureSnapshot&) = delete;
+  FeatureSnapshot& operator=(const FeatureSnapshot&) = delete;
+
+  // Returns nullptr and sets `error` if `path` isn't a valid snapshot.
+  static std::shared_ptr<const FeatureSnapshot> open(const std::string& path,
+                                                     std::string& error);
+
+  // Returns nullptr if `key` isn't in the snapshot.
+  std::shared_ptr<const DecodedFeatures> find(std::string_view key) const;
+
+  // Returns the `i`th key in key order, and its value. The value is nullptr if
+  // it's corrupt.
+  std::pair<std::string_view, std::shared_ptr<const DecodedFeatures>> entry(
+      size_t i) const;
+
+  size_t size() const { return num_keys_; }
+
+ private:
+  struct IndexEntry {
+    uint64_t key_offset;
+    uint64_t value_offset;
+    uint32_t key_size;
+    uint32_t value_size;
+  };
+
+  FeatureSnapshot(const char* data, size_t size) : data_(data), size_(size) {}
+
+  IndexEntry indexEntry(size_t i) const;
+  std::string_view key(const IndexEntry& entry) const;
+  std::shared_ptr<const DecodedFeatures> value(const IndexEntry& entry) const;
+
+  const char* data_;
+  size_t size_;
+  size_t num_keys_ = 0;
+  const char* index_ = nullptr;
+  const char* keys_ = nullptr;
+  const char* values_ = nullptr;
+};
+
+// Encodes `features` the way snapshot values are, for other stores of decoded
+// features.
+void encodeFeatureSnapshotValue(const DecodedFeatures& features,
+                                std::string& out);
+// Returns false if `value` is corrupt.
+bool decodeFeatureSnapshotValue(std::string_view value,
+                                DecodedFeatures& features);
+
+// Writes `entries` as a snapshot to `path`. The snapshot is written to a
+// temporary file first and renamed, so readers never see a partial snapshot.
+// Returns false and sets `error` on failure.
+bool writeFeatureSnapshot(
+    const std::string& path,
+    std::vector<std::pair<std::string, DecodedFeatures>> entries,
+    std::string& error);
+}  // namespace delivery
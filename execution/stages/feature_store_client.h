@@ -10,6 +10,9 @@ namespace delivery {
 struct FeatureStoreResult {
   std::string key;
   std::vector<std::string> columns_bytes;
+  // Set when the store couldn't serve the key, such as when it was throttled.
+  // The key may still exist, so it shouldn't be treated as missing.
+  bool unprocessed = false;
 };
 
 class FeatureStoreClient {
@@ -18,7 +21,9 @@ class FeatureStoreClient {
 
   // `columns` is expected to be comma-separated and include the key column. The
   // values for those columns will be returned as bytes via the callback. 0 or 1
-  // FeatureStoreResult is expected for each key passed in.
+  // FeatureStoreResult is expected for each key passed in. Keys which weren't
+  // found have no result, and keys which couldn't be read have an unprocessed
+  // result.
   virtual void read(
       const std::string& table, const std::string& key_column,
       const std::string& key, const std::string& columns,
@@ -19,7 +19,9 @@ void flattenScope(uint64_t key_limit, const common::Properties& props,
   mergeMaps(scope.features, output.sparse_floats);
   mergeMaps(scope.int_features, output.sparse_ints);
   mergeMaps(scope.int_list_features, output.sparse_int_lists);
-  mergeMaps(scope.stranger_feature_paths, output.metadata);
+  if (scope.record_stranger_paths) {
+    mergeMaps(scope.stranger_feature_paths, output.metadata);
+  }
 }
 
 void FlattenStage::runSync() {
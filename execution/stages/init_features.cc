@@ -3,5 +3,7 @@
 #include "execution/feature_context.h"
 
 namespace delivery {
-void InitFeaturesStage::runSync() { feature_context_.initialize(insertions_); }
+void InitFeaturesStage::runSync() {
+  feature_context_.initialize(insertions_, record_stranger_paths_);
+}
 }  // namespace delivery
@@ -19,10 +19,15 @@ class Insertion;
 namespace delivery {
 class InitFeaturesStage : public Stage {
  public:
+  // Stranger feature paths are only recorded if `record_stranger_paths`.
   InitFeaturesStage(size_t id,
                     const std::vector<delivery::Insertion>& insertions,
-                    FeatureContext& feature_context)
-      : Stage(id), insertions_(insertions), feature_context_(feature_context) {}
+                    FeatureContext& feature_context,
+                    bool record_stranger_paths = true)
+      : Stage(id),
+        insertions_(insertions),
+        feature_context_(feature_context),
+        record_stranger_paths_(record_stranger_paths) {}
 
   std::string name() const override { return "InitFeatures"; }
 
@@ -31,5 +36,6 @@ class InitFeaturesStage : public Stage {
  private:
   const std::vector<delivery::Insertion>& insertions_;
   FeatureContext& feature_context_;
+  bool record_stranger_paths_;
 };
 }  // namespace delivery
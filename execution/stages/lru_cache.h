@@ -0,0 +1,645 @@
+// A thread-safe LRU cache which is split into independently locked shards,
+// and a lock-free cache for putting in front of it per thread. Keys are
+// strings which are hashed once per lookup, and looked up without being
+// copied.
+//
+// The shared cache can optionally use W-TinyLFU admission: new keys enter a
+// small LRU window, and only move into the main LRU if they're estimated to
+// be used more often than the key they'd evict. Scans of one-off keys, such
+// as a request for many long-tail items, then can't evict hot keys.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/types/span.h"
+
+namespace delivery {
+// A key and its hash. This doesn't own the key, which has to outlive it.
+class LruCacheKey {
+ public:
+  explicit LruCacheKey(std::string_view key)
+      : key_(key), hash_(absl::HashOf(key)) {}
+  LruCacheKey(const char* data, size_t size)
+      : LruCacheKey(std::string_view(data, size)) {}
+
+  std::string_view view() const { return key_; }
+  size_t hash() const { return hash_; }
+
+ private:
+  std::string_view key_;
+  size_t hash_;
+};
+
+// Generations are unique across caches, so a cache allocated where another
+// was destroyed can't be confused with it.
+inline uint64_t nextLruCacheGeneration() {
+  static std::atomic<uint64_t> next_generation = 1;
+  return next_generation++;
+}
+
+enum class CacheAdmission {
+  // Every new key is admitted.
+  lru,
+  // New keys are only admitted over keys which are used less often.
+  tiny_lfu,
+};
+
+// Estimates how often keys are used with a count-min sketch of 4-bit
+// counters. Counts are halved periodically so that old usage ages out.
+class FrequencySketch {
+ public:
+  // Sized to track roughly `max_size` keys.
+  explicit FrequencySketch(size_t max_size) {
+    size_t width = 64;
+    while (width < 4 * max_size) {
+      width *= 2;
+    }
+    mask_ = width - 1;
+    counters_.resize(width * num_rows);
+    reset_after_ = 10 * std::max<size_t>(1, max_size);
+  }
+
+  void increment(size_t hash) {
+    bool incremented = false;
+    for (size_t row = 0; row < num_rows; ++row) {
+      uint8_t& counter = counters_[index(hash, row)];
+      if (counter < max_count) {
+        ++counter;
+        incremented = true;
+      }
+    }
+    if (incremented && ++num_increments_ >= reset_after_) {
+      for (uint8_t& counter : counters_) {
+        counter /= 2;
+      }
+      num_increments_ /= 2;
+    }
+  }
+
+  uint8_t estimate(size_t hash) const {
+    uint8_t count = max_count;
+    for (size_t row = 0; row < num_rows; ++row) {
+      count = std::min(count, counters_[index(hash, row)]);
+    }
+    return count;
+  }
+
+ private:
+  static constexpr size_t num_rows = 4;
+  static constexpr uint8_t max_count = 15;
+
+  size_t index(size_t hash, size_t row) const {
+    // Each row remixes the hash with a different odd multiplier.
+    static constexpr uint64_t seeds[num_rows] = {
+        0x9e3779b97f4a7c15, 0xc2b2ae3d27d4eb4f, 0x165667b19e3779f9,
+        0x27d4eb2f165667c5};
+    uint64_t mixed = static_cast<uint64_t>(hash) * seeds[row];
+    return row * (mask_ + 1) + ((mixed >> 32) & mask_);
+  }
+
+  std::vector<uint8_t> counters_;
+  size_t mask_ = 0;
+  size_t reset_after_ = 0;
+  size_t num_increments_ = 0;
+};
+
+struct CacheStats {
+  size_t entries = 0;
+  // Approximate memory used by entries, including keys and bookkeeping.
+  size_t bytes = 0;
+  // Totals since the cache was created. Caches which don't count them leave
+  // them at 0.
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t inserts = 0;
+  // Only entries removed to make room, not erased or cleared ones.
+  size_t evictions = 0;
+};
+
+// Tracks when a shared cache's keys were last erased, by buckets of their
+// hashes. Copies of values held elsewhere, such as in thread-local caches,
+// check this to drop those which may have been erased since they were read.
+class EraseEpochs {
+ public:
+  // Read this before reading a value to copy.
+  uint64_t current() const { return current_.load(); }
+
+  void erased(size_t hash) {
+    const uint64_t epoch = ++current_;
+    std::atomic<uint64_t>& bucket = buckets_[hash % buckets_.size()];
+    // Concurrent erasures mustn't move the bucket's epoch back.
+    uint64_t prev = bucket.load();
+    while (prev < epoch && !bucket.compare_exchange_weak(prev, epoch)) {
+    }
+  }
+
+  // For when erased keys' hashes aren't known. Every copy read before now is
+  // treated as possibly erased.
+  void erasedAll() {
+    const uint64_t epoch = ++current_;
+    for (auto& bucket : buckets_) {
+      uint64_t prev = bucket.load();
+      while (prev < epoch && !bucket.compare_exchange_weak(prev, epoch)) {
+      }
+    }
+  }
+
+  // Returns true if a key with `hash` may have been erased since `epoch`.
+  bool erasedSince(size_t hash, uint64_t epoch) const {
+    return buckets_[hash % buckets_.size()].load(std::memory_order_relaxed) >
+           epoch;
+  }
+
+ private:
+  std::atomic<uint64_t> current_ = 0;
+  std::array<std::atomic<uint64_t>, 4'096> buckets_{};
+};
+
+// Values are copied out on lookup, so they should be cheap to copy handles
+// such as RefreshableEntry.
+template <typename V>
+class ShardedLruCache {
+ public:
+  // Returns the approximate memory used by a value, excluding the key. Values
+  // which are handles should count what they point to.
+  using Weigher = std::function<size_t(const V& value)>;
+
+  class ConstAccessor {
+   public:
+    bool found() const { return value_.has_value(); }
+    const V& operator*() const { return *value_; }
+    const V* operator->() const { return &*value_; }
+
+   private:
+    friend class ShardedLruCache;
+
+    std::optional<V> value_;
+  };
+
+  // `max_size` and `max_bytes` are split evenly across the shards. Entries are
+  // evicted to stay within both, except that a shard always keeps at least
+  // one entry. A `max_bytes` of 0 means no byte limit. By default, there's a
+  // shard per hardware thread.
+  explicit ShardedLruCache(size_t max_size, size_t num_shards = 0,
+                           CacheAdmission admission = CacheAdmission::lru,
+                           size_t max_bytes = 0, Weigher weigher = nullptr)
+      : weigher_(std::move(weigher)) {
+    if (num_shards == 0) {
+      num_shards = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t shard_size = std::max<size_t>(1, max_size / num_shards);
+    size_t shard_bytes = max_bytes / num_shards;
+    if (max_bytes > 0 && shard_bytes == 0) {
+      shard_bytes = 1;
+    }
+    shards_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+      shards_.emplace_back(
+          std::make_unique<Shard>(shard_size, shard_bytes, admission));
+    }
+  }
+
+  // Returns false if `key` isn't cached. Otherwise, `key` becomes the most
+  // recently used key of its shard.
+  bool find(ConstAccessor& accessor, const LruCacheKey& key) {
+    Shard& shard = shardFor(key.hash());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.find(accessor, key);
+  }
+
+  // Looks up all of `keys`, locking each shard once rather than once per key.
+  // `accessors` is resized to match `keys`. Returns the number of keys found.
+  size_t findMany(absl::Span<const std::string> keys,
+                  std::vector<ConstAccessor>& accessors) {
+    accessors.clear();
+    accessors.resize(keys.size());
+    if (keys.empty()) {
+      return 0;
+    }
+
+    // Group the keys' indices by shard with a counting sort.
+    std::vector<LruCacheKey> cache_keys;
+    cache_keys.reserve(keys.size());
+    std::vector<size_t> shard_offsets(shards_.size() + 1);
+    for (const auto& key : keys) {
+      const auto& cache_key = cache_keys.emplace_back(key);
+      ++shard_offsets[shardIndex(cache_key.hash()) + 1];
+    }
+    for (size_t i = 1; i < shard_offsets.size(); ++i) {
+      shard_offsets[i] += shard_offsets[i - 1];
+    }
+    std::vector<size_t> indices(keys.size());
+    std::vector<size_t> next(shard_offsets.begin(), shard_offsets.end() - 1);
+    for (size_t i = 0; i < cache_keys.size(); ++i) {
+      indices[next[shardIndex(cache_keys[i].hash())]++] = i;
+    }
+
+    size_t num_found = 0;
+    for (size_t s = 0; s < shards_.size(); ++s) {
+      if (shard_offsets[s] == shard_offsets[s + 1]) {
+        continue;
+      }
+      Shard& shard = *shards_[s];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (size_t j = shard_offsets[s]; j < shard_offsets[s + 1]; ++j) {
+        size_t i = indices[j];
+        num_found += shard.find(accessors[i], cache_keys[i]);
+      }
+    }
+    return num_found;
+  }
+
+  // Returns false and leaves the existing value if `key` is already cached.
+  // This may evict the shard's least recently used key.
+  bool insert(const LruCacheKey& key, const V& value) {
+    size_t bytes = entryBytes(key.view(), value);
+    Shard& shard = shardFor(key.hash());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.insert(key, value, bytes);
+  }
+
+  // Recomputes the memory used by `key`'s value, such as after a handle's
+  // value was replaced. This may evict entries, including `key`.
+  void reweigh(const LruCacheKey& key) {
+    Shard& shard = shardFor(key.hash());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(IndexKey{key.view(), key.hash()});
+    if (it == shard.index.end()) {
+      return;
+    }
+    Entry& entry = *it->second;
+    size_t bytes = entryBytes(entry.key, entry.value);
+    shard.bytes = shard.bytes - entry.bytes + bytes;
+    entry.bytes = bytes;
+    shard.evictOverBudget();
+  }
+
+  // Returns false if `key` isn't cached. Copies of the value held elsewhere
+  // are erased too, even if it was already evicted.
+  bool erase(const LruCacheKey& key) {
+    bool erased = false;
+    {
+      Shard& shard = shardFor(key.hash());
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.index.find(IndexKey{key.view(), key.hash()});
+      if (it != shard.index.end()) {
+        auto entry = it->second;
+        shard.erase(entry->in_window ? shard.window : shard.main, entry);
+        erased = true;
+      }
+    }
+    erase_epochs_.erased(key.hash());
+    return erased;
+  }
+
+  // Erases every key starting with `prefix`. This scans the whole cache, so
+  // it's only meant for rare, administrative use. Copies held elsewhere can't
+  // be matched by prefix, so all of them are dropped. Returns the number of
+  // keys erased.
+  size_t erasePrefix(std::string_view prefix) {
+    size_t num_erased = 0;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      for (Entries* entries : {&shard->window, &shard->main}) {
+        for (auto it = entries->begin(); it != entries->end();) {
+          auto next = std::next(it);
+          if (it->key.compare(0, prefix.size(), prefix) == 0) {
+            shard->erase(*entries, it);
+            ++num_erased;
+          }
+          it = next;
+        }
+      }
+    }
+    erase_epochs_.erasedAll();
+    return num_erased;
+  }
+
+  size_t size() const { return stats().entries; }
+
+  CacheStats stats() const {
+    CacheStats stats;
+    for (const auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      stats.entries += shard->window.size() + shard->main.size();
+      stats.bytes += shard->bytes;
+      stats.hits += shard->hits;
+      stats.misses += shard->misses;
+      stats.inserts += shard->inserts;
+      stats.evictions += shard->evictions;
+    }
+    return stats;
+  }
+
+  // Returns up to `max_entries` keys and values, taking about as many from
+  // each shard. Within a shard, the main LRU comes first since TinyLFU only
+  // admits frequently used keys there, and then entries are most recently
+  // used first. This doesn't count as a use of the entries.
+  std::vector<std::pair<std::string, V>> hottest(size_t max_entries) const {
+    std::vector<std::pair<std::string, V>> entries;
+    size_t per_shard = (max_entries + shards_.size() - 1) / shards_.size();
+    for (const auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      size_t taken = 0;
+      for (const Entries* list : {&shard->main, &shard->window}) {
+        for (auto it = list->begin();
+             it != list->end() && taken < per_shard &&
+             entries.size() < max_entries;
+             ++it, ++taken) {
+          entries.emplace_back(it->key, it->value);
+        }
+      }
+    }
+    return entries;
+  }
+
+  void clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      shard->index.clear();
+      shard->window.clear();
+      shard->main.clear();
+      shard->bytes = 0;
+    }
+    generation_ = nextLruCacheGeneration();
+  }
+
+  // This changes whenever the cache is cleared. Anything holding copies of
+  // values, such as thread-local caches, should drop them when it changes.
+  uint64_t generation() const { return generation_; }
+
+  // Likewise, this tells copies of values apart from erased keys.
+  const EraseEpochs& eraseEpochs() const { return erase_epochs_; }
+
+ private:
+  struct Entry {
+    std::string key;
+    size_t hash;
+    V value;
+    size_t bytes;
+    bool in_window = true;
+  };
+  using Entries = std::list<Entry>;
+
+  // Index keys point into their entries, which list nodes never move.
+  struct IndexKey {
+    std::string_view key;
+    size_t hash;
+  };
+  struct IndexKeyHash {
+    size_t operator()(const IndexKey& key) const { return key.hash; }
+  };
+  struct IndexKeyEq {
+    bool operator()(const IndexKey& a, const IndexKey& b) const {
+      return a.key == b.key;
+    }
+  };
+
+  struct Shard {
+    // With LRU admission, the window is the whole shard.
+    Shard(size_t max_size, size_t max_bytes, CacheAdmission admission)
+        : window_size(admission == CacheAdmission::tiny_lfu
+                          ? std::max<size_t>(1, max_size / 100)
+                          : max_size),
+          main_size(max_size - std::min(max_size, window_size)),
+          max_bytes(max_bytes) {
+      if (admission == CacheAdmission::tiny_lfu) {
+        sketch.emplace(max_size);
+      }
+    }
+
+    bool find(ConstAccessor& accessor, const LruCacheKey& key) {
+      // Misses count too, so keys which keep being read get admitted.
+      if (sketch.has_value()) {
+        sketch->increment(key.hash());
+      }
+      auto it = index.find(IndexKey{key.view(), key.hash()});
+      if (it == index.end()) {
+        ++misses;
+        return false;
+      }
+      ++hits;
+      Entries& entries = it->second->in_window ? window : main;
+      entries.splice(entries.begin(), entries, it->second);
+      accessor.value_ = it->second->value;
+      return true;
+    }
+
+    bool insert(const LruCacheKey& key, const V& value, size_t entry_bytes) {
+      if (index.contains(IndexKey{key.view(), key.hash()})) {
+        return false;
+      }
+      window.push_front(
+          Entry{std::string(key.view()), key.hash(), value, entry_bytes});
+      const Entry& entry = window.front();
+      index.emplace(IndexKey{entry.key, entry.hash}, window.begin());
+      bytes += entry_bytes;
+      ++inserts;
+      if (window.size() > window_size) {
+        admitOrEvict(std::prev(window.end()));
+      }
+      evictOverBudget();
+      return true;
+    }
+
+    // Evicts the least recently used entries of the main LRU, then the
+    // window, until the shard fits `max_bytes`.
+    void evictOverBudget() {
+      while (max_bytes > 0 && bytes > max_bytes &&
+             window.size() + main.size() > 1) {
+        if (!main.empty()) {
+          evict(main, std::prev(main.end()));
+        } else {
+          evict(window, std::prev(window.end()));
+        }
+      }
+    }
+
+    // Moves the window's least recently used `candidate` into the main LRU if
+    // there's room, or if it's used more often than what it would evict.
+    void admitOrEvict(typename Entries::iterator candidate) {
+      if (main_size == 0) {
+        evict(window, candidate);
+        return;
+      }
+      if (main.size() >= main_size) {
+        auto victim = std::prev(main.end());
+        if (sketch->estimate(candidate->hash) <=
+            sketch->estimate(victim->hash)) {
+          evict(window, candidate);
+          return;
+        }
+        evict(main, victim);
+      }
+      candidate->in_window = false;
+      main.splice(main.begin(), window, candidate);
+    }
+
+    void erase(Entries& entries, typename Entries::iterator it) {
+      bytes -= it->bytes;
+      index.erase(IndexKey{it->key, it->hash});
+      entries.erase(it);
+    }
+
+    void evict(Entries& entries, typename Entries::iterator it) {
+      ++evictions;
+      erase(entries, it);
+    }
+
+    const size_t window_size;
+    const size_t main_size;
+    const size_t max_bytes;
+    size_t bytes = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t inserts = 0;
+    size_t evictions = 0;
+    mutable std::mutex mutex;
+    // Both are most recently used first.
+    Entries window;
+    Entries main;
+    absl::flat_hash_map<IndexKey, typename Entries::iterator, IndexKeyHash,
+                        IndexKeyEq>
+        index;
+    // Only set for TinyLFU admission.
+    std::optional<FrequencySketch> sketch;
+  };
+
+  // The index's hash table uses the low bits of the hash, so shards are
+  // picked with the high bits.
+  size_t shardIndex(size_t hash) const {
+    return (static_cast<uint64_t>(hash) >> 32) % shards_.size();
+  }
+  Shard& shardFor(size_t hash) { return *shards_[shardIndex(hash)]; }
+
+  size_t entryBytes(std::string_view key, const V& value) const {
+    // The entry's list node, and its index slot.
+    size_t bytes = sizeof(Entry) + 2 * sizeof(void*) + sizeof(IndexKey) +
+                   sizeof(typename Entries::iterator) + key.size();
+    if (weigher_ != nullptr) {
+      bytes += weigher_(value);
+    }
+    return bytes;
+  }
+
+  Weigher weigher_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<uint64_t> generation_ = nextLruCacheGeneration();
+  EraseEpochs erase_epochs_;
+};
+
+// A small cache which is only used by one thread, so it takes no locks. It
+// holds immutable values, so hits don't touch any shared reference counts.
+// Slots are evicted with the CLOCK approximation of LRU.
+template <typename T>
+class LocalCache {
+ public:
+  // `generation` and `erase_epochs` are those of the shared cache this is in
+  // front of, if any.
+  LocalCache(size_t capacity, uint64_t generation,
+             const EraseEpochs* erase_epochs = nullptr)
+      : slots_(std::max<size_t>(1, capacity)),
+        generation_(generation),
+        erase_epochs_(erase_epochs) {
+    index_.reserve(slots_.size());
+  }
+  LocalCache(const LocalCache&) = delete;
+  LocalCache& operator=(const LocalCache&) = delete;
+
+  // Returns nullptr if `key` isn't cached, or was erased from the shared
+  // cache since it was inserted here. The value stays valid until the next
+  // insert().
+  const T* find(const LruCacheKey& key) {
+    auto it = index_.find(IndexKey{key.view(), key.hash()});
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    Slot& slot = slots_[it->second];
+    if (erase_epochs_ != nullptr &&
+        erase_epochs_->erasedSince(slot.hash, slot.erase_epoch)) {
+      index_.erase(it);
+      slot.value = nullptr;
+      slot.referenced = false;
+      return nullptr;
+    }
+    slot.referenced = true;
+    return slot.value.get();
+  }
+
+  // Replaces the value if `key` is already cached. `erase_epoch` is the shared
+  // cache's EraseEpochs::current() from before `value` was read from it.
+  void insert(const LruCacheKey& key, std::shared_ptr<const T> value,
+              uint64_t erase_epoch = 0) {
+    auto it = index_.find(IndexKey{key.view(), key.hash()});
+    if (it != index_.end()) {
+      slots_[it->second].value = std::move(value);
+      slots_[it->second].erase_epoch = erase_epoch;
+      return;
+    }
+    // Recently referenced slots get a second chance.
+    while (slots_[hand_].referenced) {
+      slots_[hand_].referenced = false;
+      hand_ = (hand_ + 1) % slots_.size();
+    }
+    Slot& slot = slots_[hand_];
+    if (slot.value != nullptr) {
+      index_.erase(IndexKey{slot.key, slot.hash});
+    }
+    slot.key.assign(key.view());
+    slot.hash = key.hash();
+    slot.value = std::move(value);
+    slot.erase_epoch = erase_epoch;
+    index_.emplace(IndexKey{slot.key, slot.hash}, hand_);
+    hand_ = (hand_ + 1) % slots_.size();
+  }
+
+  uint64_t generation() const { return generation_; }
+
+ private:
+  struct Slot {
+    std::string key;
+    size_t hash = 0;
+    std::shared_ptr<const T> value;
+    uint64_t erase_epoch = 0;
+    bool referenced = false;
+  };
+  // Index keys point into their slots, which never move.
+  struct IndexKey {
+    std::string_view key;
+    size_t hash;
+  };
+  struct IndexKeyHash {
+    size_t operator()(const IndexKey& key) const { return key.hash; }
+  };
+  struct IndexKeyEq {
+    bool operator()(const IndexKey& a, const IndexKey& b) const {
+      return a.key == b.key;
+    }
+  };
+
+  std::vector<Slot> slots_;
+  size_t hand_ = 0;
+  uint64_t generation_;
+  const EraseEpochs* erase_epochs_;
+  absl::flat_hash_map<IndexKey, size_t, IndexKeyHash, IndexKeyEq> index_;
+};
+}  // namespace delivery
@@ -0,0 +1,148 @@
+// A compact cache of keys which are known to be missing from a store, so that
+// they don't take up entries of a ShardedLruCache. Only a 64-bit fingerprint
+// of the key and its expiry are kept, in fixed-size buckets, so the cache's
+// memory is fixed up front. A full bucket evicts the entry which expires first.
+//
+// Fingerprints are the keys' full hashes, so a false positive needs a 64-bit
+// hash collision.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "execution/stages/lru_cache.h"
+
+namespace delivery {
+class NegativeCache {
+ public:
+  // `max_size` is split evenly across the shards. By default, there's a shard
+  // per hardware thread.
+  explicit NegativeCache(size_t max_size, size_t num_shards = 0) {
+    if (num_shards == 0) {
+      num_shards = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t shard_size = std::max<size_t>(1, max_size / num_shards);
+    size_t num_buckets =
+        std::max<size_t>(1, (shard_size + bucket_size - 1) / bucket_size);
+    shards_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+      shards_.emplace_back(std::make_unique<Shard>(num_buckets));
+    }
+  }
+
+  // Returns true if `key` was inserted and hasn't expired by `now`.
+  bool contains(const LruCacheKey& key, uint64_t now) {
+    Shard& shard = shardFor(key.hash());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Slot* slot = shard.find(fingerprint(key.hash()));
+    const bool found = slot != nullptr && now < slot->expire_time;
+    ++(found ? shard.hits : shard.misses);
+    return found;
+  }
+
+  // Inserts `key`, or updates its expiry if it's already cached.
+  void insert(const LruCacheKey& key, uint64_t expire_time) {
+    const uint64_t print = fingerprint(key.hash());
+    Shard& shard = shardFor(key.hash());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Slot* slot = shard.find(print);
+    if (slot == nullptr) {
+      Slot* bucket = shard.bucket(print);
+      slot = std::min_element(bucket, bucket + bucket_size,
+                              [](const Slot& a, const Slot& b) {
+                                return a.expire_time < b.expire_time;
+                              });
+      shard.evictions += slot->fingerprint != 0;
+    }
+    ++shard.inserts;
+    slot->fingerprint = print;
+    slot->expire_time = expire_time;
+  }
+
+  // For keys which turn out to exist.
+  void erase(const LruCacheKey& key) {
+    Shard& shard = shardFor(key.hash());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (Slot* slot = shard.find(fingerprint(key.hash()))) {
+      *slot = Slot();
+    }
+  }
+
+  // Entries may include expired keys. Bytes are fixed by the size.
+  CacheStats stats() const {
+    CacheStats stats;
+    for (const auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      stats.entries +=
+          std::count_if(shard->slots.begin(), shard->slots.end(),
+                        [](const Slot& slot) { return slot.fingerprint != 0; });
+      stats.bytes += shard->slots.size() * sizeof(Slot);
+      stats.hits += shard->hits;
+      stats.misses += shard->misses;
+      stats.inserts += shard->inserts;
+      stats.evictions += shard->evictions;
+    }
+    return stats;
+  }
+
+  void clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      std::fill(shard->slots.begin(), shard->slots.end(), Slot());
+    }
+  }
+
+ private:
+  static constexpr size_t bucket_size = 4;
+
+  struct Slot {
+    // 0 if the slot is empty.
+    uint64_t fingerprint = 0;
+    uint64_t expire_time = 0;
+  };
+
+  struct Shard {
+    explicit Shard(size_t num_buckets) : slots(num_buckets * bucket_size) {}
+
+    Slot* bucket(uint64_t fingerprint) {
+      return &slots[fingerprint % (slots.size() / bucket_size) * bucket_size];
+    }
+
+    Slot* find(uint64_t fingerprint) {
+      Slot* slot = bucket(fingerprint);
+      for (size_t i = 0; i < bucket_size; ++i, ++slot) {
+        if (slot->fingerprint == fingerprint) {
+          return slot;
+        }
+      }
+      return nullptr;
+    }
+
+    mutable std::mutex mutex;
+    std::vector<Slot> slots;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t inserts = 0;
+    size_t evictions = 0;
+  };
+
+  static uint64_t fingerprint(size_t hash) {
+    return hash == 0 ? 1 : static_cast<uint64_t>(hash);
+  }
+
+  // Like ShardedLruCache, shards are picked with the high bits and buckets
+  // with the low bits.
+  Shard& shardFor(size_t hash) {
+    return *shards_[(static_cast<uint64_t>(hash) >> 32) % shards_.size()];
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+}  // namespace delivery
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstdlib>
+#include <iterator>
 #include <numeric>
 #include <vector>
 
@@ -92,6 +93,7 @@ void initCurrPage(PagingContext& paging_context,
     errors.emplace_back(absl::StrCat(
         "Empty insertions and/or paging for request ", req.request_id()));
   } else {
+    paging_context.has_curr_page = true;
     paging_context.min_position = offset;
     paging_context.max_position = max_position;
 
@@ -228,13 +230,54 @@ void getInsertionsWhichCanBeOnCurrPage(
   insertions = std::move(res);
 }
 
+bool isFullyAllocated(const PagingContext& paging_context) {
+  if (!paging_context.open_positions.empty()) {
+    return false;
+  }
+  // Open positions are also empty when the page couldn't be initialized, so
+  // make sure every position was actually claimed.
+  int64_t page_size =
+      paging_context.max_position - paging_context.min_position + 1;
+  int64_t num_on_curr_page = 0;
+  for (const auto& [_, seen_info] : paging_context.seen_infos) {
+    num_on_curr_page += seen_info.on_curr_page;
+  }
+  return page_size > 0 && num_on_curr_page == page_size;
+}
+
+// Unlike getInsertionsWhichCanBeOnCurrPage(), this doesn't require the
+// allocated insertions to be on the request. Preallocated pages can hold
+// insertions which were only on the request for an earlier page.
+void useAllocsForCurrPage(const PagingContext& paging_context,
+                          std::vector<delivery::Insertion>& insertions) {
+  std::vector<delivery::Insertion> res;
+  res.reserve(paging_context.max_position - paging_context.min_position + 1);
+  for (const auto& [_, seen_info] : paging_context.seen_infos) {
+    if (seen_info.on_curr_page) {
+      res.emplace_back(seen_info.insertion);
+    }
+  }
+  std::sort(res.begin(), res.end(),
+            [](const delivery::Insertion& a, const delivery::Insertion& b) {
+              return a.position() < b.position();
+            });
+
+  insertions = std::move(res);
+}
+
 // This happens after Redis returns.
 void ReadFromPagingStage::runSync() {
   initCurrPage(paging_context_, errors_, req_, insertions_);
   if (!allocs_.empty()) {
     processPastAllocs(paging_context_, errors_, req_, insertions_, allocs_,
                       paging_config_.limit_to_req_insertions);
-    getInsertionsWhichCanBeOnCurrPage(paging_context_, insertions_);
+    if (paging_config_.num_preallocated_pages > 0 &&
+        isFullyAllocated(paging_context_)) {
+      paging_context_.is_fully_allocated = true;
+      useAllocsForCurrPage(paging_context_, insertions_);
+    } else {
+      getInsertionsWhichCanBeOnCurrPage(paging_context_, insertions_);
+    }
   }
 
   done_cb_();
@@ -274,8 +317,60 @@ std::vector<std::string> makeAllocs(PagingContext& paging_context,
   return ret;
 }
 
+// Insertions which were processed but didn't make it into the response are
+// allocated to the pages following the current one, in their current order.
+std::vector<std::string> makePreallocs(
+    const PagingContext& paging_context, const delivery::Response& resp,
+    const std::vector<delivery::Insertion>& insertions, int64_t num_pages) {
+  int64_t page_size =
+      paging_context.max_position - paging_context.min_position + 1;
+  if (num_pages <= 0 || page_size <= 0) {
+    return {};
+  }
+
+  absl::flat_hash_set<std::string_view> resp_ids;
+  resp_ids.reserve(resp.insertion_size());
+  for (const auto& insertion : resp.insertion()) {
+    resp_ids.emplace(insertion.content_id());
+  }
+
+  std::vector<std::string> ret;
+  const int64_t max_preallocs = num_pages * page_size;
+  // Don't collide with preallocations made for earlier pages.
+  int64_t next_position = paging_context.max_position + 1;
+  for (const auto& [_, seen_info] : paging_context.seen_infos) {
+    next_position =
+        std::max(next_position,
+                 static_cast<int64_t>(seen_info.insertion.position()) + 1);
+  }
+  for (const auto& insertion : insertions) {
+    if (static_cast<int64_t>(ret.size()) == max_preallocs) {
+      break;
+    }
+    if (resp_ids.contains(insertion.content_id()) ||
+        paging_context.seen_infos.contains(insertion.content_id())) {
+      continue;
+    }
+    delivery::Insertion alloc;
+    alloc.set_content_id(insertion.content_id());
+    alloc.set_position(next_position++);
+    ret.emplace_back(alloc.SerializeAsString());
+  }
+  return ret;
+}
+
 void WriteToPagingStage::runSync() {
   std::vector<std::string> allocs = makeAllocs(paging_context_, resp_);
+  // Pages which were served from preallocations have nothing left over to
+  // allocate.
+  if (paging_config_.num_preallocated_pages > 0 &&
+      !paging_context_.is_fully_allocated) {
+    std::vector<std::string> preallocs =
+        makePreallocs(paging_context_, resp_, insertions_,
+                      paging_config_.num_preallocated_pages);
+    allocs.insert(allocs.end(), std::make_move_iterator(preallocs.begin()),
+                  std::make_move_iterator(preallocs.end()));
+  }
   // If all insertions were past allocs, then don't bother.
   if (allocs.empty()) {
     return;
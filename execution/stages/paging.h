@@ -44,6 +44,12 @@ void getInsertionsWhichCanBeOnCurrPage(
     std::vector<delivery::Insertion>& insertions);
 std::vector<std::string> makeAllocs(PagingContext& paging_context,
                                     const delivery::Response& resp);
+bool isFullyAllocated(const PagingContext& paging_context);
+void useAllocsForCurrPage(const PagingContext& paging_context,
+                          std::vector<delivery::Insertion>& insertions);
+std::vector<std::string> makePreallocs(
+    const PagingContext& paging_context, const delivery::Response& resp,
+    const std::vector<delivery::Insertion>& insertions, int64_t num_pages);
 
 class ReadFromPagingStage : public Stage {
  public:
@@ -82,11 +88,13 @@ class WriteToPagingStage : public Stage {
   WriteToPagingStage(size_t id, std::unique_ptr<RedisClient> client,
                      const PagingConfig& paging_config,
                      const delivery::Response& resp,
+                     const std::vector<delivery::Insertion>& insertions,
                      PagingContext& paging_context)
       : Stage(id),
         client_(std::move(client)),
         paging_config_(paging_config),
         resp_(resp),
+        insertions_(insertions),
         paging_context_(paging_context) {}
   std::string name() const override { return "WriteToPaging"; }
 
@@ -97,6 +105,7 @@ class WriteToPagingStage : public Stage {
   std::shared_ptr<RedisClient> client_;
   const PagingConfig& paging_config_;
   const delivery::Response& resp_;
+  const std::vector<delivery::Insertion>& insertions_;
   PagingContext& paging_context_;
 };
 }  // namespace delivery
@@ -1,26 +1,51 @@
 #include "execution/stages/read_from_feature_store.h"
 
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
-#include "cache.h"
 #include "config/feature_store_config.h"
+#include "execution/decoded_features.h"
 #include "execution/stages/cache.h"
+#include "execution/stages/feature_compression.h"
+#include "execution/stages/feature_snapshot.h"
 #include "feature_store_client.h"
 #include "proto/delivery/private/features/features.pb.h"
+#include "trantor/net/EventLoop.h"
 #include "utils/time.h"
 
 namespace delivery {
+FeaturesEntry makeFeaturesEntry(std::string_view key, uint64_t now,
+                                const FeatureStoreConfig& config) {
+  FeaturesEntry entry;
+  entry.expire_time = jitteredExpireTime(key, now, config.hard_ttl_millis,
+                                         config.ttl_jitter);
+  // Without a soft TTL, entries are never revalidated before they expire.
+  entry.soft_expire_time =
+      config.soft_ttl_millis > 0
+          ? jitteredExpireTime(key, now, config.soft_ttl_millis,
+                               config.ttl_jitter)
+          : entry.expire_time;
+  return entry;
+}
+
 void deserializeAndCache(
     const std::vector<FeatureStoreResult>& results,
     const std::vector<std::string>& keys_to_fetch, uint64_t start_time,
-    FeaturesCache& cache,
-    std::function<void(std::string_view, delivery_private_features::Features)>&
-        feature_adder,
+    FeaturesCache& cache, NegativeCache* negative_cache,
+    const FeatureStoreConfig& config,
+    const FeatureDecompressor* decompressor,
+    std::function<void(std::string_view,
+                       std::shared_ptr<const DecodedFeatures>)>& feature_adder,
     std::vector<std::string>& errors) {
   // Make a set for faster intersection.
   absl::flat_hash_set<std::string_view> keys_without_results;
@@ -29,13 +54,31 @@ void deserializeAndCache(
     keys_without_results.emplace(key);
   }
 
+  size_t num_unprocessed = 0;
+  // Reused across values to avoid reallocating.
+  std::string decompressed;
   for (const auto& result : results) {
+    // Unprocessed keys may exist, so they're neither served nor cached.
+    if (result.unprocessed) {
+      ++num_unprocessed;
+      keys_without_results.erase(result.key);
+      continue;
+    }
     delivery_private_features::Features features;
     for (const auto& column_bytes : result.columns_bytes) {
+      std::string_view bytes = column_bytes;
+      if (decompressor != nullptr && isCompressedFeatureValue(bytes)) {
+        std::string error;
+        if (!decompressor->decompress(bytes, decompressed, error)) {
+          errors.emplace_back(absl::StrCat(error, " for ID ", result.key));
+          continue;
+        }
+        bytes = decompressed;
+      }
       // The values in feature store are actually FeaturesLists instead of
       // Features.
       delivery_private_features::FeaturesList features_list;
-      if (!features_list.MergeFromString(column_bytes)) {
+      if (!features_list.ParseFromArray(bytes.data(), bytes.size())) {
         errors.emplace_back(absl::StrCat(
             "Unable to deserialize feature list for ID ", result.key));
       }
@@ -43,52 +86,207 @@ void deserializeAndCache(
         features.MergeFrom(element);
       }
     }
-    std::string timed_key = makeTimedKey(result.key, start_time);
-    CacheKey cache_key(timed_key.data(), timed_key.size());
-    cache.insert(cache_key, features);
-    feature_adder(result.key, std::move(features));
+    FeaturesEntry entry = makeFeaturesEntry(result.key, start_time, config);
+    entry.features = decodeFeatures(features);
+    feature_adder(result.key, entry.features);
+    insertOrRefresh(cache, result.key, std::move(entry));
+    // The key may have been added since it was negatively cached, such as
+    // when prefetched or refreshed.
+    if (negative_cache != nullptr) {
+      negative_cache->erase(CacheKey(result.key));
+    }
     keys_without_results.erase(result.key);
   }
 
   // Cache empty results for the keys we didn't receive.
+  const uint64_t negative_ttl_millis = config.negative_ttl_millis > 0
+                                           ? config.negative_ttl_millis
+                                           : config.hard_ttl_millis;
   for (std::string_view key : keys_without_results) {
-    std::string timed_key = makeTimedKey(key, start_time);
-    CacheKey cache_key(timed_key.data(), timed_key.size());
-    cache.insert(cache_key, {});
+    if (negative_cache == nullptr) {
+      insertOrRefresh(cache, key, makeFeaturesEntry(key, start_time, config));
+      continue;
+    }
+    CacheKey cache_key(key.data(), key.size());
+    negative_cache->insert(cache_key,
+                           jitteredExpireTime(key, start_time,
+                                              negative_ttl_millis,
+                                              config.ttl_jitter));
+    // The key may have been deleted since it was cached.
+    cache.erase(cache_key);
   }
-}
-
-void ReadFromFeatureStoreStage::runSync() {
-  deserializeAndCache(results_, keys_to_fetch_, start_time_, cache_,
-                      feature_adder_, errors_);
 
-  done_cb_();
+  if (num_unprocessed > 0) {
+    errors.emplace_back(absl::StrCat(num_unprocessed, " of ",
+                                     keys_to_fetch.size(),
+                                     " feature store keys were unprocessed"));
+  }
 }
 
 // Cached keys end up populating `id_to_features`. Keys missing from the cache
-// end up populating `keys_to_fetch`.
+// end up populating `keys_to_fetch`. Keys which were served but are past their
+// soft TTL end up populating `keys_to_refresh`. Keys in `negative_cache` are
+// served as empty.
 void processCachedKeys(
     const std::vector<std::string>& keys, uint64_t start_time,
-    FeaturesCache& cache,
-    std::function<void(std::string_view, delivery_private_features::Features)>&
+    FeaturesCache& cache, NegativeCache* negative_cache,
+    const FeatureStoreConfig& config,
+    std::function<void(std::string_view, const DecodedFeatures&)>&
         feature_adder,
-    std::vector<std::string>& keys_to_fetch) {
+    std::vector<std::string>& keys_to_fetch,
+    std::vector<std::string>& keys_to_refresh) {
+  // Most hot keys are served by this thread's local cache. The rest go to
+  // the shared cache together.
+  LocalCache<FeaturesEntry>& local_cache = threadLocalCache(cache);
+  const DecodedFeatures empty;
+  std::vector<std::string> shared_keys;
   for (const auto& key : keys) {
-    std::string timed_key = makeTimedKey(key, start_time);
-    CacheKey cache_key(timed_key.data(), timed_key.size());
-    FeaturesCache::ConstAccessor accessor;
-    if (cache.find(accessor, cache_key)) {
-      feature_adder(key, *accessor.get());
+    CacheKey cache_key(key.data(), key.size());
+    if (negative_cache != nullptr &&
+        negative_cache->contains(cache_key, start_time)) {
+      feature_adder(key, empty);
+      continue;
+    }
+    const FeaturesEntry* entry = local_cache.find(cache_key);
+    if (entry != nullptr && start_time < entry->soft_expire_time) {
+      feature_adder(key, *entry->features);
     } else {
+      shared_keys.emplace_back(key);
+    }
+  }
+
+  std::vector<FeaturesCache::ConstAccessor> accessors;
+  const uint64_t erase_epoch = cache.eraseEpochs().current();
+  cache.findMany(shared_keys, accessors);
+  for (size_t i = 0; i < shared_keys.size(); ++i) {
+    const auto& key = shared_keys[i];
+    if (!accessors[i].found()) {
+      keys_to_fetch.emplace_back(key);
+      continue;
+    }
+    auto entry = accessors[i]->load();
+    if (start_time >= entry->expire_time) {
       keys_to_fetch.emplace_back(key);
+      continue;
+    }
+    if (start_time >= entry->soft_expire_time) {
+      keys_to_refresh.emplace_back(key);
+    } else {
+      local_cache.insert(CacheKey(key.data(), key.size()), entry,
+                         erase_epoch);
     }
+    feature_adder(key, *entry->features);
   }
 }
 
+void processSnapshotKeys(
+    std::vector<std::string>& keys, uint64_t start_time,
+    const FeatureSnapshot& snapshot, FeaturesCache& cache,
+    const FeatureStoreConfig& config,
+    std::function<void(std::string_view, const DecodedFeatures&)>&
+        feature_adder) {
+  auto missing = std::remove_if(
+      keys.begin(), keys.end(), [&](const std::string& key) {
+        auto features = snapshot.find(key);
+        if (features == nullptr) {
+          return false;
+        }
+        FeaturesEntry entry = makeFeaturesEntry(key, start_time, config);
+        entry.features = std::move(features);
+        feature_adder(key, *entry.features);
+        insertOrRefresh(cache, key, std::move(entry));
+        return true;
+      });
+  keys.erase(missing, keys.end());
+}
+
+void processSharedCacheKeys(
+    std::vector<std::string>& keys, uint64_t start_time,
+    const SharedFeaturesCache& shared_cache, FeaturesCache& cache,
+    std::function<void(std::string_view, const DecodedFeatures&)>&
+        feature_adder,
+    std::vector<std::string>& keys_to_refresh) {
+  auto missing = std::remove_if(
+      keys.begin(), keys.end(), [&](const std::string& key) {
+        auto entry = shared_cache.find(key);
+        if (entry == nullptr || start_time >= entry->expire_time) {
+          return false;
+        }
+        if (start_time >= entry->soft_expire_time) {
+          keys_to_refresh.emplace_back(key);
+        }
+        feature_adder(key, *entry->features);
+        insertOrRefresh(cache, key, *entry);
+        return true;
+      });
+  keys.erase(missing, keys.end());
+}
+
+bool InFlightReads::join(const std::string& key, uint64_t now,
+                         Waiter&& waiter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = flights_.try_emplace(key);
+  Flight& flight = it->second;
+  flight.waiters.emplace_back(std::move(waiter));
+  if (inserted || now >= flight.start + stale_after_millis_) {
+    flight.start = now;
+    return true;
+  }
+  return false;
+}
+
+void InFlightReads::complete(const std::string& key,
+                             const DecodedFeatures& features) {
+  std::vector<Waiter> waiters;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = flights_.find(key);
+    // A leader which was taken over can still complete later.
+    if (it == flights_.end()) {
+      return;
+    }
+    waiters = std::move(it->second.waiters);
+    flights_.erase(it);
+  }
+  // Waiters can take their own locks, so don't hold ours.
+  for (auto& waiter : waiters) {
+    waiter(features);
+  }
+}
+
+size_t InFlightReads::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return flights_.size();
+}
+
+InFlightReads& featureStoreInFlightReads() {
+  static InFlightReads in_flight_reads;
+  return in_flight_reads;
+}
+
+uint64_t parseFeatureStoreTimeout(const std::string& timeout, bool* valid) {
+  int timeout_millis = -1;
+  try {
+    timeout_millis = std::stoi(timeout);
+  } catch (const std::exception&) {
+  }
+  const bool parsed = timeout_millis >= 0;
+  if (valid != nullptr) {
+    *valid = parsed;
+  }
+  return parsed ? timeout_millis : default_feature_store_timeout_millis;
+}
+
+std::string makeInFlightKey(std::string_view table, std::string_view key) {
+  return absl::StrCat(table, "\x1f", key);
+}
+
 // Just used to avoid races between the client async call and it timing out.
-struct CoordinationState {
+struct ReadFromFeatureStoreStage::CoordinationState {
   std::mutex mutex;
   bool already_finished = false;
+  // Keys which haven't been resolved by a leader yet.
+  size_t remaining = 0;
 };
 
 void ReadFromFeatureStoreStage::run(
@@ -96,73 +294,255 @@ void ReadFromFeatureStoreStage::run(
     std::function<void(const std::chrono::duration<double>& delay,
                        std::function<void()>&& cb)>&& timeout_cb) {
   done_cb_ = cb;
+  loop_ = trantor::EventLoop::getEventLoopOfCurrentThread();
 
   // Keys which are not present in feature store will just be missing from the
   // response. We stash these to later recognize which keys were not in the
   // response.
-  processCachedKeys(key_generator_(), start_time_, cache_, feature_adder_,
-                    keys_to_fetch_);
-  // If everything was cached, then skip feature store.
-  if (keys_to_fetch_.empty()) {
-    done_cb_();
-    return;
+  std::vector<std::string> keys_to_refresh;
+  processCachedKeys(key_generator_(), start_time_, cache_, negative_cache_,
+                    config_, feature_adder_, keys_to_fetch_, keys_to_refresh);
+  // Stale keys were already served, so they're only refreshed.
+  std::function<void(std::string_view, const DecodedFeatures&)> no_op =
+      [](std::string_view, const DecodedFeatures&) {};
+  if (snapshot_ != nullptr) {
+    processSnapshotKeys(keys_to_fetch_, start_time_, *snapshot_, cache_,
+                        config_, feature_adder_);
+    processSnapshotKeys(keys_to_refresh, start_time_, *snapshot_, cache_,
+                        config_, no_op);
+  }
+  if (shared_cache_ != nullptr) {
+    std::vector<std::string> stale_keys;
+    processSharedCacheKeys(keys_to_fetch_, start_time_, *shared_cache_,
+                           cache_, feature_adder_, stale_keys);
+    // Another process may have refreshed them already.
+    processSharedCacheKeys(keys_to_refresh, start_time_, *shared_cache_,
+                           cache_, no_op, stale_keys);
+    keys_to_refresh.insert(keys_to_refresh.end(),
+                           std::make_move_iterator(stale_keys.begin()),
+                           std::make_move_iterator(stale_keys.end()));
   }
 
   auto state = std::make_shared<CoordinationState>();
-
-  // If we made it this far, we have to wait on feature store. Might be
-  // worthwhile to make these callbacks just update the cache asynchronously
-  // while this request just goes on without it.
-  const std::string columns = absl::StrCat(
-      config_.primary_key, ",", absl::StrJoin(config_.feature_columns, ","));
-  if (keys_to_fetch_.size() == 1) {
-    client_->read(config_.table, config_.primary_key, keys_to_fetch_[0],
-                  columns,
-                  [this, state](std::vector<FeatureStoreResult> results) {
-                    std::lock_guard<std::mutex> lock(state->mutex);
-                    // If we already timed out, do nothing. We have to gate
-                    // access to stage fields because this instance could not
-                    // exist any more by the time this functor happens.
-                    if (state->already_finished) {
-                      return;
-                    }
-                    state->already_finished = true;
-                    this->results_ = std::move(results);
-                    runSync();
-                  });
+  state->remaining = keys_to_fetch_.size();
+  // If everything was cached, then this request doesn't wait on feature store.
+  const bool all_cached = keys_to_fetch_.empty();
+  if (all_cached) {
+    state->already_finished = true;
   } else {
-    client_->readBatch(config_.table, config_.primary_key, keys_to_fetch_,
-                       columns,
-                       [this, state](std::vector<FeatureStoreResult> results) {
-                         std::lock_guard<std::mutex> lock(state->mutex);
-                         // If we already timed out, do nothing.
-                         if (state->already_finished) {
-                           return;
-                         }
-                         state->already_finished = true;
-                         this->results_ = std::move(results);
-                         runSync();
-                       });
-  }
-  int timeout;
-  try {
-    timeout = std::stoi(timeout_);
-  } catch (const std::exception&) {
-    errors_.emplace_back(
-        absl::StrCat("Invalid feature store timeout specified: ", timeout_,
-                     ". Defaulting to 500ms."));
-    timeout = 500;
+    // The timeout is scheduled first because other requests' reads can finish
+    // this stage as soon as we wait on them.
+    bool valid_timeout = false;
+    const uint64_t timeout = parseFeatureStoreTimeout(timeout_, &valid_timeout);
+    if (!valid_timeout) {
+      errors_.emplace_back(
+          absl::StrCat("Invalid feature store timeout specified: ", timeout_,
+                       ". Defaulting to ", timeout, "ms."));
+    }
+    timeout_cb(std::chrono::milliseconds(timeout), [this, state]() {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      // Check if we didn't time out.
+      if (state->already_finished) {
+        return;
+      }
+      state->already_finished = true;
+      // Keys still in flight are cached by whoever leads them.
+      done_cb_();
+    });
+  }
+
+  // Refreshes don't wait on the Redis cache, since this stage may already be
+  // finished when it responds.
+  refresh(std::move(keys_to_refresh), state);
+  if (all_cached) {
+    done_cb_();
+    return;
   }
-  timeout_cb(std::chrono::milliseconds(timeout), [this, state]() {
+  if (redis_cache_ == nullptr) {
+    fetch(state);
+    return;
+  }
+  redis_cache_->find(
+      config_.table, keys_to_fetch_,
+      [this, state](RedisFeaturesCache::Entries entries) {
+        bool all_found = false;
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          // Once timed out, this stage may not exist any more.
+          if (state->already_finished) {
+            return;
+          }
+          std::vector<std::string> misses;
+          for (size_t i = 0; i < keys_to_fetch_.size(); ++i) {
+            const auto& key = keys_to_fetch_[i];
+            const auto& entry = entries[i];
+            if (entry == nullptr || start_time_ >= entry->soft_expire_time) {
+              misses.emplace_back(key);
+              continue;
+            }
+            feature_adder_(key, *entry->features);
+            if (negative_cache_ != nullptr && entry->features->empty()) {
+              negative_cache_->insert(CacheKey(key.data(), key.size()),
+                                      entry->expire_time);
+            } else {
+              insertOrRefresh(cache_, key, *entry);
+            }
+            --state->remaining;
+          }
+          keys_to_fetch_ = std::move(misses);
+          all_found = keys_to_fetch_.empty();
+          state->already_finished = all_found;
+          // Once the lock is released, the timeout can finish and free this
+          // stage at any point on the Redis thread. Fetch on the request's
+          // loop instead, where the timeout runs too.
+          if (!all_found && loop_ != nullptr && !loop_->isInLoopThread()) {
+            loop_->queueInLoop([this, state]() { fetch(state); });
+            return;
+          }
+        }
+        if (all_found) {
+          done_cb_();
+        } else {
+          fetch(state);
+        }
+      });
+}
+
+void ReadFromFeatureStoreStage::fetch(
+    std::shared_ptr<CoordinationState> state) {
+  // Only read the keys which no other request is already reading. Holding our
+  // lock keeps waiters from finishing this stage before every key is joined.
+  InFlightReads& in_flight = featureStoreInFlightReads();
+  std::vector<std::string> keys_to_lead;
+  {
     std::lock_guard<std::mutex> lock(state->mutex);
-    // Check if we didn't time out.
+    // If we already timed out, this instance may not exist any more.
     if (state->already_finished) {
       return;
     }
-    state->already_finished = true;
-    // We call this instead of runSync() to not cache every key with empty
-    // results.
-    done_cb_();
-  });
+    uint64_t now = millisSinceEpoch();
+    for (const auto& key : keys_to_fetch_) {
+      auto waiter = [this, state, key](const DecodedFeatures& features) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        // If we already timed out, do nothing. We have to gate access to stage
+        // fields because this instance could not exist any more by the time
+        // this functor happens.
+        if (state->already_finished) {
+          return;
+        }
+        feature_adder_(key, features);
+        if (--state->remaining == 0) {
+          state->already_finished = true;
+          done_cb_();
+        }
+      };
+      if (in_flight.join(makeInFlightKey(config_.table, key), now,
+                         std::move(waiter))) {
+        keys_to_lead.emplace_back(key);
+      }
+    }
+  }
+
+  if (!keys_to_lead.empty()) {
+    readAndCache(std::move(keys_to_lead), state);
+  }
+}
+
+void ReadFromFeatureStoreStage::refresh(
+    std::vector<std::string> keys, std::shared_ptr<CoordinationState> state) {
+  InFlightReads& in_flight = featureStoreInFlightReads();
+  std::vector<std::string> keys_to_lead;
+  const uint64_t now = millisSinceEpoch();
+  for (auto& key : keys) {
+    // Stale keys were already served, so nobody waits on their refresh.
+    if (in_flight.join(makeInFlightKey(config_.table, key), now,
+                       [](const DecodedFeatures&) {})) {
+      keys_to_lead.emplace_back(std::move(key));
+    }
+  }
+
+  if (!keys_to_lead.empty()) {
+    readAndCache(std::move(keys_to_lead), state);
+  }
+}
+
+void ReadFromFeatureStoreStage::readAndCache(
+    std::vector<std::string> keys, std::shared_ptr<CoordinationState> state) {
+  // The result callback isn't tied to this request. It always caches and
+  // resolves everyone waiting on these keys, even if this stage timed out.
+  auto on_results = [this, state, &cache = cache_,
+                     negative_cache = negative_cache_, config = config_, keys,
+                     start_time = start_time_, decompressor = decompressor_,
+                     shared_cache = shared_cache_,
+                     redis_cache = redis_cache_](
+                        std::vector<FeatureStoreResult> results) {
+    absl::flat_hash_map<std::string, std::shared_ptr<const DecodedFeatures>>
+        fetched;
+    std::function<void(std::string_view,
+                       std::shared_ptr<const DecodedFeatures>)>
+        adder = [&fetched](std::string_view key,
+                           std::shared_ptr<const DecodedFeatures> features) {
+          fetched.emplace(key, std::move(features));
+        };
+    std::vector<std::string> errors;
+    deserializeAndCache(results, keys, start_time, cache, negative_cache,
+                        config, decompressor.get(), adder, errors);
+    if (!errors.empty()) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->already_finished) {
+        errors_.insert(errors_.end(), std::make_move_iterator(errors.begin()),
+                       std::make_move_iterator(errors.end()));
+      }
+    }
+
+    // Empty results aren't shared, since unprocessed keys look the same here.
+    if (shared_cache != nullptr) {
+      for (auto& [key, features] : fetched) {
+        FeaturesEntry entry = makeFeaturesEntry(key, start_time, config);
+        entry.features = features;
+        shared_cache->insert(key, entry);
+      }
+    }
+
+    // Unlike the shared memory cache, keys missing from feature store are
+    // shared too. Only unprocessed keys are left for the next reader.
+    if (redis_cache != nullptr) {
+      absl::flat_hash_set<std::string_view> unprocessed;
+      for (const auto& result : results) {
+        if (result.unprocessed) {
+          unprocessed.emplace(result.key);
+        }
+      }
+      const uint64_t now = millisSinceEpoch();
+      for (const auto& key : keys) {
+        if (unprocessed.contains(key)) {
+          continue;
+        }
+        FeaturesEntry entry = makeFeaturesEntry(key, start_time, config);
+        if (auto it = fetched.find(key); it != fetched.end()) {
+          entry.features = it->second;
+        }
+        redis_cache->insert(config.table, key, entry, now);
+      }
+    }
+
+    InFlightReads& in_flight = featureStoreInFlightReads();
+    const DecodedFeatures empty;
+    for (const auto& key : keys) {
+      auto it = fetched.find(key);
+      in_flight.complete(makeInFlightKey(config.table, key),
+                         it == fetched.end() ? empty : *it->second);
+    }
+  };
+
+  const std::string columns = absl::StrCat(
+      config_.primary_key, ",", absl::StrJoin(config_.feature_columns, ","));
+  if (keys.size() == 1) {
+    client_->read(config_.table, config_.primary_key, keys[0], columns,
+                  std::move(on_results));
+  } else {
+    client_->readBatch(config_.table, config_.primary_key, keys, columns,
+                       std::move(on_results));
+  }
 }
 }  // namespace delivery
@@ -5,25 +5,76 @@
 
 #include <stddef.h>
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "execution/stages/cache.h"
+#include "execution/stages/feature_compression.h"
+#include "execution/stages/feature_snapshot.h"
 #include "execution/stages/feature_store_client.h"
+#include "execution/stages/negative_cache.h"
+#include "execution/stages/redis_features_cache.h"
+#include "execution/stages/shared_features_cache.h"
 #include "execution/stages/stage.h"
 
+namespace trantor {
+class EventLoop;
+}
 namespace delivery {
+struct DecodedFeatures;
 struct FeatureStoreConfig;
-}
-namespace delivery_private_features {
-class Features;
-}
+}  // namespace delivery
 
 namespace delivery {
+// Coalesces concurrent feature store reads of the same key across requests.
+// The first requester of a key leads and issues the read. Later requesters
+// only attach a waiter which is invoked with the leader's result.
+class InFlightReads {
+ public:
+  using Waiter = std::function<void(const DecodedFeatures&)>;
+
+  // If a leader hasn't completed after `stale_after_millis`, the next
+  // requester takes over so a lost response can't strand keys forever.
+  explicit InFlightReads(uint64_t stale_after_millis = 5'000)
+      : stale_after_millis_(stale_after_millis) {}
+
+  // Returns true if the caller should issue the read for `key`.
+  bool join(const std::string& key, uint64_t now, Waiter&& waiter);
+
+  // Removes `key` and invokes all of its waiters with `features`.
+  void complete(const std::string& key, const DecodedFeatures& features);
+
+  size_t size();
+
+ private:
+  struct Flight {
+    uint64_t start = 0;
+    std::vector<Waiter> waiters;
+  };
+
+  uint64_t stale_after_millis_;
+  std::mutex mutex_;
+  absl::flat_hash_map<std::string, Flight> flights_;
+};
+
+// Shared by every ReadFromFeatureStoreStage in the process.
+InFlightReads& featureStoreInFlightReads();
+
+// Used when the configured feature store timeout is invalid.
+constexpr uint64_t default_feature_store_timeout_millis = 500;
+
+// Parses the configured feature store timeout, in millis, falling back to the
+// default if it's empty or invalid. Sets `valid` accordingly if given.
+uint64_t parseFeatureStoreTimeout(const std::string& timeout,
+                                  bool* valid = nullptr);
+
 class ReadFromFeatureStoreStage : public Stage {
  public:
   ReadFromFeatureStoreStage(
@@ -32,8 +83,13 @@ class ReadFromFeatureStoreStage : public Stage {
       const FeatureStoreConfig& config, const std::string& timeout,
       uint64_t start_time,
       std::function<std::vector<std::string>()>&& key_generator,
-      std::function<void(std::string_view,
-                         delivery_private_features::Features)>&& feature_adder)
+      std::function<void(std::string_view, const DecodedFeatures&)>&&
+          feature_adder,
+      std::shared_ptr<const FeatureSnapshot> snapshot = nullptr,
+      std::shared_ptr<const FeatureDecompressor> decompressor = nullptr,
+      std::shared_ptr<SharedFeaturesCache> shared_cache = nullptr,
+      NegativeCache* negative_cache = nullptr,
+      std::shared_ptr<RedisFeaturesCache> redis_cache = nullptr)
       : Stage(id),
         cache_(cache),
         client_(std::move(client)),
@@ -41,16 +97,34 @@ class ReadFromFeatureStoreStage : public Stage {
         timeout_(timeout),
         start_time_(start_time),
         key_generator_(key_generator),
-        feature_adder_(feature_adder) {}
+        feature_adder_(feature_adder),
+        snapshot_(std::move(snapshot)),
+        decompressor_(std::move(decompressor)),
+        shared_cache_(std::move(shared_cache)),
+        negative_cache_(negative_cache),
+        redis_cache_(std::move(redis_cache)) {}
   std::string name() const override { return "ReadFromFeatureStore"; }
 
-  void runSync() override;
+  void runSync() override {}
 
   void run(std::function<void()>&& done_cb,
            std::function<void(const std::chrono::duration<double>& delay,
                               std::function<void()>&& cb)>&&) override;
 
  private:
+  struct CoordinationState;
+
+  // Reads `keys_to_fetch_` from feature store, unless other requests are
+  // already reading them. Does nothing once the stage has finished.
+  void fetch(std::shared_ptr<CoordinationState> state);
+  // Reads the stale `keys` from feature store in the background, unless other
+  // requests are already reading them.
+  void refresh(std::vector<std::string> keys,
+               std::shared_ptr<CoordinationState> state);
+  // Reads `keys` as their in-flight leader.
+  void readAndCache(std::vector<std::string> keys,
+                    std::shared_ptr<CoordinationState> state);
+
   FeaturesCache& cache_;
   std::unique_ptr<const FeatureStoreClient> client_;
   const FeatureStoreConfig& config_;
@@ -58,25 +132,60 @@ class ReadFromFeatureStoreStage : public Stage {
   uint64_t start_time_;
   std::function<std::vector<std::string>()> key_generator_;
   std::vector<std::string> keys_to_fetch_;
-  std::function<void(std::string_view, delivery_private_features::Features)>
-      feature_adder_;
+  std::function<void(std::string_view, const DecodedFeatures&)> feature_adder_;
+  // Consulted for keys missing from the cache before going to feature store.
+  std::shared_ptr<const FeatureSnapshot> snapshot_;
+  // Set if the feature store holds compressed values.
+  std::shared_ptr<const FeatureDecompressor> decompressor_;
+  // Shared with other processes on the host. Consulted after the snapshot,
+  // and written with what's read from feature store.
+  std::shared_ptr<SharedFeaturesCache> shared_cache_;
+  // If set, keys missing from feature store are cached here instead of as
+  // empty entries of `cache_`.
+  NegativeCache* negative_cache_;
+  // Shared with other instances. Consulted for keys missing locally, and
+  // written with what's read from feature store.
+  std::shared_ptr<RedisFeaturesCache> redis_cache_;
   // This is the one from run(), which calls back to the executor.
   std::function<void()> done_cb_;
-  std::vector<FeatureStoreResult> results_;
+  // The loop run() was called on, which also runs the timeout. Null outside
+  // of an event loop.
+  trantor::EventLoop* loop_ = nullptr;
 };
 
-// Declared here for testing.
+// Declared here for testing. Compressed values are only decompressed if
+// `decompressor` is set. Missing keys go to `negative_cache` if it's set.
 void deserializeAndCache(
     const std::vector<FeatureStoreResult>& results,
     const std::vector<std::string>& keys_to_fetch, uint64_t start_time,
-    FeaturesCache& cache,
-    std::function<void(std::string_view, delivery_private_features::Features)>&
-        feature_adder,
+    FeaturesCache& cache, NegativeCache* negative_cache,
+    const FeatureStoreConfig& config,
+    const FeatureDecompressor* decompressor,
+    std::function<void(std::string_view,
+                       std::shared_ptr<const DecodedFeatures>)>& feature_adder,
     std::vector<std::string>& errors);
 void processCachedKeys(
     const std::vector<std::string>& keys, uint64_t start_time,
-    FeaturesCache& cache,
-    std::function<void(std::string_view, delivery_private_features::Features)>&
+    FeaturesCache& cache, NegativeCache* negative_cache,
+    const FeatureStoreConfig& config,
+    std::function<void(std::string_view, const DecodedFeatures&)>&
+        feature_adder,
+    std::vector<std::string>& keys_to_fetch,
+    std::vector<std::string>& keys_to_refresh);
+// Serves and caches the `keys` found in `snapshot`, and removes them from
+// `keys`.
+void processSnapshotKeys(
+    std::vector<std::string>& keys, uint64_t start_time,
+    const FeatureSnapshot& snapshot, FeaturesCache& cache,
+    const FeatureStoreConfig& config,
+    std::function<void(std::string_view, const DecodedFeatures&)>&
+        feature_adder);
+// Serves and caches the `keys` found unexpired in `shared_cache`, and removes
+// them from `keys`. Those past their soft TTL are added to `keys_to_refresh`.
+void processSharedCacheKeys(
+    std::vector<std::string>& keys, uint64_t start_time,
+    const SharedFeaturesCache& shared_cache, FeaturesCache& cache,
+    std::function<void(std::string_view, const DecodedFeatures&)>&
         feature_adder,
-    std::vector<std::string>& keys_to_fetch);
+    std::vector<std::string>& keys_to_refresh);
 }  // namespace delivery
@@ -10,8 +10,10 @@
 #include "utils/uuid.h"
 
 namespace delivery {
+// `strangers` is only written if `record_strangers`.
 void processUserAgent(const std::string& user_agent,
                       absl::flat_hash_map<uint64_t, float>& features,
+                      bool record_strangers,
                       absl::flat_hash_map<std::string, uint64_t>& strangers) {
   if (user_agent.empty()) {
     features[delivery_private_features::FEATURE_USER_AGENT_MISSING] = 1;
@@ -24,7 +26,9 @@ void processUserAgent(const std::string& user_agent,
   state.updateState(user_agent);
   uint64_t id = state.digestState();
   features[id] = 1;
-  strangers[absl::StrCat(user_agent_prefix, user_agent)] = id;
+  if (record_strangers) {
+    strangers[absl::StrCat(user_agent_prefix, user_agent)] = id;
+  }
 
   // This isn't unicode-safe.
   std::string lower_user_agent = absl::AsciiStrToLower(user_agent);
@@ -108,9 +112,11 @@ void processPlacementFeatures(const delivery::Request& req,
 void ReadFromRequestStage::runSync() {
   absl::flat_hash_map<uint64_t, float> request_features;
   absl::flat_hash_map<std::string, uint64_t> request_strangers;
+  // Paths are only built for requests whose strangers are written out.
+  const bool record_strangers = feature_context_.recordsStrangerPaths();
 
   processUserAgent(req_.device().browser().user_agent(), request_features,
-                   request_strangers);
+                   record_strangers, request_strangers);
 
   // These features are based on user info, but do not belong to user scope.
   const auto& log_user_id = req_.user_info().log_user_id();
@@ -120,7 +126,9 @@ void ReadFromRequestStage::runSync() {
     state.updateState(log_user_id);
     uint64_t id = state.digestState();
     request_features[id] = 1;
-    request_strangers[absl::StrCat(log_user_id_prefix, log_user_id)] = id;
+    if (record_strangers) {
+      request_strangers[absl::StrCat(log_user_id_prefix, log_user_id)] = id;
+    }
   }
   request_features[delivery_private_features::FEATURE_HAS_USER_ID] =
       !req_.user_info().user_id().empty();
@@ -132,7 +140,9 @@ void ReadFromRequestStage::runSync() {
     state.updateState(referrer);
     uint64_t id = state.digestState();
     request_features[id] = 1;
-    request_strangers[absl::StrCat(referrer_prefix, referrer)] = id;
+    if (record_strangers) {
+      request_strangers[absl::StrCat(referrer_prefix, referrer)] = id;
+    }
   }
 
   processPlacementFeatures(req_, request_features);
@@ -147,8 +157,10 @@ void ReadFromRequestStage::runSync() {
                      const FeatureScope&) {
           uint64_t id = hashlib::makeHash(insertion.content_id());
           scope.features[id] = 1;
-          scope.stranger_feature_paths[absl::StrCat(
-              content_id_prefix, insertion.content_id())] = id;
+          if (scope.record_stranger_paths) {
+            scope.stranger_feature_paths[absl::StrCat(
+                content_id_prefix, insertion.content_id())] = id;
+          }
 
           if (insertion.has_retrieval_score()) {
             scope.features[delivery_private_features::RETRIEVAL_SCORE] =
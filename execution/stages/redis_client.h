@@ -8,6 +8,7 @@
 #include <atomic>
 #include <chrono>
 #include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -28,6 +29,19 @@ class RedisClient {
   virtual void hGetAll(const std::string& key,
                        std::function<void(std::vector<std::string>)>&& cb) = 0;
 
+  // Feeds one value per field into the callback, with missing fields as
+  // nullopt. If there's an error, feeds an empty vector into the callback
+  // instead, so that errors can be told apart from missing keys.
+  virtual void hMGet(
+      const std::string& key, const std::vector<std::string>& fields,
+      std::function<void(std::vector<std::optional<std::string>>)>&& cb) = 0;
+
+  // Feeds one value per key into the callback, with missing keys as nullopt.
+  // If there's an error, feeds an empty vector into the callback instead.
+  virtual void mGet(
+      const std::vector<std::string>& keys,
+      std::function<void(std::vector<std::optional<std::string>>)>&& cb) = 0;
+
   // Writers.
 
   // If there's an error, feeds 0 into the callback (as compared to the
@@ -39,7 +53,15 @@ class RedisClient {
   // No callback because this isn't intended to be followed by anything.
   virtual void expire(const std::string& key, int64_t ttl) = 0;
 
+  // Sets `key` to `value`, expiring after `ttl_millis`. No callback because
+  // this isn't intended to be followed by anything.
+  virtual void pSetEx(const std::string& key, int64_t ttl_millis,
+                      const std::string& value) = 0;
+
   // No callback because this isn't intended to be followed by anything.
   virtual void lTrim(const std::string& key, int64_t start, int64_t stop) = 0;
+
+  // No callback because this isn't intended to be followed by anything.
+  virtual void del(const std::vector<std::string>& keys) = 0;
 };
 }  // namespace delivery
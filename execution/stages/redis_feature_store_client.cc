@@ -0,0 +1,84 @@
+#include "execution/stages/redis_feature_store_client.h"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+
+namespace delivery {
+namespace {
+// Shared by all of the reads of a readBatch() call.
+struct BatchReadState {
+  std::function<void(std::vector<FeatureStoreResult>)> cb;
+  std::mutex mutex;
+  std::vector<FeatureStoreResult> results;
+  size_t remaining = 0;
+};
+}  // namespace
+
+std::string makeRedisFeatureStoreKey(std::string_view table,
+                                     std::string_view key) {
+  return absl::StrCat(table, ":", key);
+}
+
+void RedisFeatureStoreClient::read(
+    const std::string& table, const std::string& key_column,
+    const std::string& key, const std::string& columns,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
+  readBatch(table, key_column, {key}, columns, std::move(cb));
+}
+
+void RedisFeatureStoreClient::readBatch(
+    const std::string& table, const std::string& key_column,
+    const std::vector<std::string>& keys, const std::string& columns,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
+  if (keys.empty()) {
+    cb({});
+    return;
+  }
+  // The key isn't stored as a field of its own row.
+  std::vector<std::string> fields;
+  for (std::string_view column : absl::StrSplit(columns, ',')) {
+    if (!column.empty() && column != key_column) {
+      fields.emplace_back(column);
+    }
+  }
+
+  auto state = std::make_shared<BatchReadState>();
+  state->cb = std::move(cb);
+  state->results.reserve(keys.size());
+  state->remaining = keys.size();
+  const size_t num_fields = fields.size();
+  for (const auto& key : keys) {
+    client_->hMGet(
+        makeRedisFeatureStoreKey(table, key), fields,
+        [state, key,
+         num_fields](std::vector<std::optional<std::string>> values) {
+          FeatureStoreResult result;
+          result.key = key;
+          // An empty reply for a non-empty request means the read failed.
+          result.unprocessed = values.empty() && num_fields > 0;
+          for (auto& value : values) {
+            if (value.has_value()) {
+              result.columns_bytes.emplace_back(std::move(*value));
+            }
+          }
+          std::vector<FeatureStoreResult> results;
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            // Rows without any of the columns don't exist.
+            if (result.unprocessed || !result.columns_bytes.empty()) {
+              state->results.emplace_back(std::move(result));
+            }
+            if (--state->remaining > 0) {
+              return;
+            }
+            results = std::move(state->results);
+          }
+          state->cb(std::move(results));
+        });
+  }
+}
+}  // namespace delivery
@@ -0,0 +1,39 @@
+// Reads feature store rows out of Redis. Each row is a hash whose fields are
+// the row's columns, holding the same FeaturesList bytes as DynamoDB does.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "execution/stages/feature_store_client.h"
+#include "execution/stages/redis_client.h"
+
+namespace delivery {
+// The Redis key for a row of `table`.
+std::string makeRedisFeatureStoreKey(std::string_view table,
+                                     std::string_view key);
+
+class RedisFeatureStoreClient : public FeatureStoreClient {
+ public:
+  explicit RedisFeatureStoreClient(std::unique_ptr<RedisClient> client)
+      : client_(std::move(client)) {}
+
+  void read(
+      const std::string& table, const std::string& key_column,
+      const std::string& key, const std::string& columns,
+      std::function<void(std::vector<FeatureStoreResult>)>&& cb) const override;
+  // Issues one HMGET per key. These are pipelined on the client's connection.
+  void readBatch(
+      const std::string& table, const std::string& key_column,
+      const std::vector<std::string>& keys, const std::string& columns,
+      std::function<void(std::vector<FeatureStoreResult>)>&& cb) const override;
+
+ private:
+  std::unique_ptr<RedisClient> client_;
+};
+}  // namespace delivery
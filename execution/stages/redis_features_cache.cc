@@ -0,0 +1,85 @@
+#include "execution/stages/redis_features_cache.h"
+
+#include <cstring>
+#include <optional>
+
+#include "absl/strings/str_cat.h"
+#include "execution/decoded_features.h"
+#include "execution/stages/feature_snapshot.h"
+
+namespace delivery {
+std::string makeRedisFeaturesCacheKey(std::string_view table,
+                                      std::string_view key) {
+  return absl::StrCat("features:", table, ":", key);
+}
+
+void RedisFeaturesCache::find(std::string_view table,
+                              const std::vector<std::string>& keys,
+                              std::function<void(Entries)>&& cb) {
+  if (keys.empty()) {
+    cb({});
+    return;
+  }
+  std::vector<std::string> redis_keys;
+  redis_keys.reserve(keys.size());
+  for (const auto& key : keys) {
+    redis_keys.emplace_back(makeRedisFeaturesCacheKey(table, key));
+  }
+  auto on_values = [cb, num_keys = keys.size()](
+                       std::vector<std::optional<std::string>> values) {
+    Entries entries(num_keys);
+    // An empty reply means the read failed.
+    if (values.size() != num_keys) {
+      cb(std::move(entries));
+      return;
+    }
+    for (size_t i = 0; i < num_keys; ++i) {
+      const auto& value = values[i];
+      if (!value.has_value() || value->size() < 2 * sizeof(uint64_t)) {
+        continue;
+      }
+      auto entry = std::make_shared<FeaturesEntry>();
+      std::memcpy(&entry->soft_expire_time, value->data(), sizeof(uint64_t));
+      std::memcpy(&entry->expire_time, value->data() + sizeof(uint64_t),
+                  sizeof(uint64_t));
+      auto features = std::make_shared<DecodedFeatures>();
+      if (!decodeFeatureSnapshotValue(
+              std::string_view(*value).substr(2 * sizeof(uint64_t)),
+              *features)) {
+        continue;
+      }
+      entry->features = std::move(features);
+      entries[i] = std::move(entry);
+    }
+    cb(std::move(entries));
+  };
+  client_->mGet(redis_keys, std::move(on_values));
+}
+
+void RedisFeaturesCache::insert(std::string_view table, std::string_view key,
+                                const FeaturesEntry& entry, uint64_t now) {
+  if (now >= entry.soft_expire_time) {
+    return;
+  }
+  std::string value(2 * sizeof(uint64_t), '\0');
+  std::memcpy(value.data(), &entry.soft_expire_time, sizeof(uint64_t));
+  std::memcpy(value.data() + sizeof(uint64_t), &entry.expire_time,
+              sizeof(uint64_t));
+  encodeFeatureSnapshotValue(*entry.features, value);
+  client_->pSetEx(makeRedisFeaturesCacheKey(table, key),
+                  entry.soft_expire_time - now, value);
+}
+
+void RedisFeaturesCache::erase(std::string_view table,
+                               const std::vector<std::string>& keys) {
+  if (keys.empty()) {
+    return;
+  }
+  std::vector<std::string> redis_keys;
+  redis_keys.reserve(keys.size());
+  for (const auto& key : keys) {
+    redis_keys.emplace_back(makeRedisFeaturesCacheKey(table, key));
+  }
+  client_->del(redis_keys);
+}
+}  // namespace delivery
@@ -0,0 +1,49 @@
+// A features cache in Redis which is shared by every instance, between their
+// local caches and feature store. Without it, each instance misses on its own,
+// so scaling out or deploying multiplies feature store reads.
+//
+// Values are decoded features, encoded like FeatureSnapshot values, after
+// their soft and hard expiry times. Entries are only kept until their soft
+// expiry, so hits never need refreshing.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "execution/stages/cache.h"
+#include "execution/stages/redis_client.h"
+
+namespace delivery {
+// The Redis key for `key` of `table`.
+std::string makeRedisFeaturesCacheKey(std::string_view table,
+                                      std::string_view key);
+
+class RedisFeaturesCache {
+ public:
+  using Entries = std::vector<std::shared_ptr<const FeaturesEntry>>;
+
+  explicit RedisFeaturesCache(std::unique_ptr<RedisClient> client)
+      : client_(std::move(client)) {}
+
+  // Looks up all of `keys` with one MGET. Feeds one entry per key into the
+  // callback, with misses as nullptr. Errors are treated as misses.
+  void find(std::string_view table, const std::vector<std::string>& keys,
+            std::function<void(Entries)>&& cb);
+
+  // Entries which are already past their soft expiry at `now` aren't cached.
+  void insert(std::string_view table, std::string_view key,
+              const FeaturesEntry& entry, uint64_t now);
+
+  // Erases all of `keys` with one DEL.
+  void erase(std::string_view table, const std::vector<std::string>& keys);
+
+ private:
+  std::unique_ptr<RedisClient> client_;
+};
+}  // namespace delivery
@@ -1,6 +1,7 @@
 #include "execution/stages/respond.h"
 
 #include <algorithm>
+#include <cstdint>
 
 #include "proto/delivery/delivery.pb.h"
 #include "utils/uuid.h"
@@ -8,15 +9,29 @@
 namespace delivery {
 void RespondStage::runSync() {
   resp_.set_request_id(req_.request_id());
-  resp_.mutable_paging_info()->set_cursor(
-      absl::StrCat(paging_context_.min_position + insertions_.size()));
+  // Insertions which were allocated to the current page keep their positions.
+  // The rest fill the open positions in order, and whatever doesn't fit is
+  // left for later pages.
+  size_t next_open_position = 0;
   for (const auto &insertion : insertions_) {
+    int64_t position = insertion.position();
+    if (paging_context_.has_curr_page) {
+      auto it = paging_context_.seen_infos.find(insertion.content_id());
+      if (it == paging_context_.seen_infos.end() || !it->second.on_curr_page) {
+        if (next_open_position == paging_context_.open_positions.size()) {
+          continue;
+        }
+        position = paging_context_.open_positions[next_open_position++];
+      }
+    }
     auto *resp_insertion = resp_.add_insertion();
     resp_insertion->set_content_id(insertion.content_id());
-    resp_insertion->set_position(insertion.position());
+    resp_insertion->set_position(position);
     // Truncate the UUID from 32 characters to 20 to save space.
     resp_insertion->set_insertion_id(uuid().substr(0, 20));
   }
+  resp_.mutable_paging_info()->set_cursor(
+      absl::StrCat(paging_context_.min_position + resp_.insertion_size()));
   // Clients expect insertions sorted by position (ascending).
   std::sort(resp_.mutable_insertion()->begin(),
             resp_.mutable_insertion()->end(),
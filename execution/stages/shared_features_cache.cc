@@ -0,0 +1,329 @@
+#include "execution/stages/shared_features_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "execution/decoded_features.h"
+#include "execution/stages/feature_snapshot.h"
+
+namespace delivery {
+namespace {
+constexpr char segment_magic[8] = {'P', 'F', 'S', 'H', 'M', '0', '0', '1'};
+constexpr size_t cache_line_bytes = 64;
+constexpr size_t slots_per_bucket = 4;
+constexpr size_t max_locks = 256;
+// Readers miss rather than wait on a slot which keeps being written.
+constexpr int max_read_attempts = 4;
+constexpr int max_lock_attempts = 1'000;
+constexpr int lock_spins_before_yield = 100;
+constexpr auto max_init_wait = std::chrono::seconds(1);
+
+// Values of Header::state.
+constexpr uint32_t uninitialized = 0;
+constexpr uint32_t initializing = 1;
+constexpr uint32_t initialized = 2;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+size_t roundUp(size_t size, size_t multiple) {
+  return (size + multiple - 1) / multiple * multiple;
+}
+
+// Processes have different absl::Hash seeds, so this has to be stable.
+// FNV-1a, with a final mix since buckets are picked by modulus.
+uint64_t stableHash(std::string_view key) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+}  // namespace
+
+// Segments are zero-filled when they're created, which is a valid
+// uninitialized header and empty slots.
+struct SharedFeaturesCache::Header {
+  char magic[8];
+  std::atomic<uint32_t> state;
+  uint32_t unused;
+  uint64_t num_buckets;
+  uint64_t slot_bytes;
+};
+
+// Followed by the key and then the encoded value. Readers can copy a slot
+// while it's being written, and only trust the copy if `sequence` is even
+// and unchanged afterwards.
+struct SharedFeaturesCache::Slot {
+  std::atomic<uint64_t> sequence;
+  uint64_t hash;
+  uint64_t soft_expire_time;
+  // 0 if the slot is empty.
+  uint64_t expire_time;
+  uint32_t key_size;
+  uint32_t value_size;
+};
+
+SharedFeaturesCache::~SharedFeaturesCache() { munmap(data_, size_); }
+
+std::shared_ptr<SharedFeaturesCache> SharedFeaturesCache::open(
+    const std::string& name, size_t max_size, size_t slot_bytes,
+    std::string& error) {
+  size_t num_buckets =
+      std::max<size_t>(1, (max_size + slots_per_bucket - 1) / slots_per_bucket);
+  slot_bytes =
+      roundUp(std::max(slot_bytes, sizeof(Slot) + 1), cache_line_bytes);
+  size_t num_locks = std::min(num_buckets, max_locks);
+  size_t locks_offset = roundUp(sizeof(Header), cache_line_bytes);
+  size_t slots_offset = locks_offset + num_locks * cache_line_bytes;
+  size_t size = slots_offset + num_buckets * slots_per_bucket * slot_bytes;
+
+  const std::string shm_name = name.rfind('/', 0) == 0 ? name : "/" + name;
+  int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd < 0) {
+    error = absl::StrCat("Unable to open shared features cache ", name, ": ",
+                         std::strerror(errno));
+    return nullptr;
+  }
+  // Every process sizes the segment in case it's first. Resizing to the same
+  // size is a no-op.
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (st.st_size != 0 && static_cast<size_t>(st.st_size) != size) ||
+      (st.st_size == 0 && ftruncate(fd, size) != 0)) {
+    close(fd);
+    error = absl::StrCat("Shared features cache ", name,
+                         " exists with a different size, or can't be sized");
+    return nullptr;
+  }
+  void* data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    error = absl::StrCat("Unable to map shared features cache ", name, ": ",
+                         std::strerror(errno));
+    return nullptr;
+  }
+  std::shared_ptr<SharedFeaturesCache> cache(
+      new SharedFeaturesCache(static_cast<char*>(data), size));
+  cache->num_buckets_ = num_buckets;
+  cache->num_locks_ = num_locks;
+  cache->slot_bytes_ = slot_bytes;
+  cache->locks_offset_ = locks_offset;
+  cache->slots_offset_ = slots_offset;
+
+  // The first process to open the segment initializes it, and the others
+  // wait for that.
+  Header& header = cache->header();
+  uint32_t state = uninitialized;
+  if (header.state.compare_exchange_strong(state, initializing)) {
+    std::memcpy(header.magic, segment_magic, sizeof(segment_magic));
+    header.num_buckets = num_buckets;
+    header.slot_bytes = slot_bytes;
+    header.state.store(initialized, std::memory_order_release);
+  } else {
+    auto deadline = std::chrono::steady_clock::now() + max_init_wait;
+    while (header.state.load(std::memory_order_acquire) != initialized) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        error = absl::StrCat("Shared features cache ", name,
+                             " was never initialized");
+        return nullptr;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  if (std::memcmp(header.magic, segment_magic, sizeof(segment_magic)) != 0 ||
+      header.num_buckets != num_buckets || header.slot_bytes != slot_bytes) {
+    error = absl::StrCat("Shared features cache ", name,
+                         " has a different format or size");
+    return nullptr;
+  }
+  return cache;
+}
+
+SharedFeaturesCache::Header& SharedFeaturesCache::header() const {
+  return *reinterpret_cast<Header*>(data_);
+}
+
+std::atomic<uint32_t>& SharedFeaturesCache::lock(size_t bucket) const {
+  return *reinterpret_cast<std::atomic<uint32_t>*>(
+      data_ + locks_offset_ + bucket % num_locks_ * cache_line_bytes);
+}
+
+SharedFeaturesCache::Slot& SharedFeaturesCache::slot(size_t index) const {
+  return *reinterpret_cast<Slot*>(data_ + slots_offset_ +
+                                  index * slot_bytes_);
+}
+
+char* SharedFeaturesCache::slotData(size_t index) const {
+  return data_ + slots_offset_ + index * slot_bytes_ + sizeof(Slot);
+}
+
+std::shared_ptr<const FeaturesEntry> SharedFeaturesCache::find(
+    std::string_view key) const {
+  const uint64_t hash = stableHash(key);
+  const size_t bucket = hash % num_buckets_;
+  const size_t capacity = slot_bytes_ - sizeof(Slot);
+  std::string copy;
+  for (size_t i = 0; i < slots_per_bucket; ++i) {
+    const size_t index = bucket * slots_per_bucket + i;
+    const Slot& slot = this->slot(index);
+    for (int attempt = 0; attempt < max_read_attempts; ++attempt) {
+      uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence % 2 == 1) {
+        continue;
+      }
+      uint64_t slot_hash = slot.hash;
+      uint64_t soft_expire_time = slot.soft_expire_time;
+      uint64_t expire_time = slot.expire_time;
+      size_t key_size = slot.key_size;
+      size_t value_size = slot.value_size;
+      // A torn read of another key is also just a mismatch.
+      if (slot_hash != hash || key_size != key.size() || key_size > capacity ||
+          value_size > capacity - key_size) {
+        break;
+      }
+      copy.assign(slotData(index), key_size + value_size);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+        continue;
+      }
+      if (std::string_view(copy).substr(0, key_size) != key) {
+        break;
+      }
+      auto features = std::make_shared<DecodedFeatures>();
+      if (!decodeFeatureSnapshotValue(
+              std::string_view(copy).substr(key_size), *features)) {
+        return nullptr;
+      }
+      auto entry = std::make_shared<FeaturesEntry>();
+      entry->features = std::move(features);
+      entry->soft_expire_time = soft_expire_time;
+      entry->expire_time = expire_time;
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+bool SharedFeaturesCache::insert(std::string_view key,
+                                 const FeaturesEntry& entry) {
+  std::string value;
+  encodeFeatureSnapshotValue(*entry.features, value);
+  if (key.size() + value.size() > slot_bytes_ - sizeof(Slot)) {
+    return false;
+  }
+  const uint64_t hash = stableHash(key);
+  const size_t bucket = hash % num_buckets_;
+
+  std::atomic<uint32_t>& lock = this->lock(bucket);
+  if (!tryLock(lock)) {
+    return false;
+  }
+
+  // Replace the key if it's cached, or else use an empty slot, or else evict
+  // whichever entry expires first.
+  size_t victim = bucket * slots_per_bucket;
+  for (size_t i = 0; i < slots_per_bucket; ++i) {
+    const size_t index = bucket * slots_per_bucket + i;
+    const Slot& slot = this->slot(index);
+    if (slot.hash == hash && slot.key_size == key.size() &&
+        std::string_view(slotData(index), slot.key_size) == key) {
+      victim = index;
+      break;
+    }
+    if (slot.expire_time < this->slot(victim).expire_time) {
+      victim = index;
+    }
+  }
+
+  Slot& slot = this->slot(victim);
+  const uint64_t writing = beginWrite(slot);
+  slot.hash = hash;
+  slot.soft_expire_time = entry.soft_expire_time;
+  slot.expire_time = entry.expire_time;
+  slot.key_size = key.size();
+  slot.value_size = value.size();
+  char* data = slotData(victim);
+  std::memcpy(data, key.data(), key.size());
+  std::memcpy(data + key.size(), value.data(), value.size());
+  slot.sequence.store(writing + 1, std::memory_order_release);
+
+  lock.store(0, std::memory_order_release);
+  return true;
+}
+
+bool SharedFeaturesCache::erase(std::string_view key) {
+  const uint64_t hash = stableHash(key);
+  const size_t bucket = hash % num_buckets_;
+  std::atomic<uint32_t>& lock = this->lock(bucket);
+  if (!tryLock(lock)) {
+    return false;
+  }
+  bool erased = false;
+  for (size_t i = 0; i < slots_per_bucket && !erased; ++i) {
+    const size_t index = bucket * slots_per_bucket + i;
+    Slot& slot = this->slot(index);
+    if (slot.hash != hash || slot.key_size != key.size() ||
+        std::string_view(slotData(index), slot.key_size) != key) {
+      continue;
+    }
+    const uint64_t writing = beginWrite(slot);
+    slot.hash = 0;
+    slot.soft_expire_time = 0;
+    slot.expire_time = 0;
+    slot.key_size = 0;
+    slot.value_size = 0;
+    slot.sequence.store(writing + 1, std::memory_order_release);
+    erased = true;
+  }
+  lock.store(0, std::memory_order_release);
+  return erased;
+}
+
+bool SharedFeaturesCache::tryLock(std::atomic<uint32_t>& lock) {
+  for (int attempt = 0; attempt < max_lock_attempts; ++attempt) {
+    uint32_t unlocked = 0;
+    if (lock.compare_exchange_weak(unlocked, 1, std::memory_order_acquire)) {
+      return true;
+    }
+    if (attempt >= lock_spins_before_yield) {
+      std::this_thread::yield();
+    }
+  }
+  return false;
+}
+
+uint64_t SharedFeaturesCache::beginWrite(Slot& slot) {
+  uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  // An odd sequence was left by a writer which died, so skip past it.
+  uint64_t writing = sequence % 2 == 0 ? sequence + 1 : sequence + 2;
+  slot.sequence.store(writing, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  return writing;
+}
+
+CacheStats SharedFeaturesCache::stats() const {
+  CacheStats stats;
+  for (size_t i = 0; i < num_buckets_ * slots_per_bucket; ++i) {
+    stats.entries += slot(i).expire_time != 0;
+  }
+  stats.bytes = size_;
+  return stats;
+}
+}  // namespace delivery
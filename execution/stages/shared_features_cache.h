@@ -0,0 +1,85 @@
+// A features cache in a POSIX shared memory segment, so that delivery
+// processes on the same host share one copy of hot keys instead of each
+// caching and fetching them.
+//
+// The segment is a fixed number of fixed-size slots, grouped into small
+// buckets. A key can only live in its bucket, and inserting into a full
+// bucket evicts the entry which expires first. Entries are encoded like
+// FeatureSnapshot values, so each lookup decodes a copy.
+//
+// Reads don't lock. Each slot has a sequence number which is odd while it's
+// being written, and readers retry or miss if it changed while they copied
+// the slot. Writers take one of a fixed set of spinlocks by bucket. Locks are
+// only tried for a bounded time, so a process which dies while holding one
+// can't block the others, although inserts into its buckets then fail until
+// the segment is recreated.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "execution/stages/cache.h"
+
+namespace delivery {
+class SharedFeaturesCache {
+ public:
+  ~SharedFeaturesCache();
+  SharedFeaturesCache(const SharedFeaturesCache&) = delete;
+  SharedFeaturesCache& operator=(const SharedFeaturesCache&) = delete;
+
+  // Opens the segment `name`, creating it if no other process has. Keys and
+  // values over `slot_bytes` in total aren't cached. Every process has to
+  // open the segment with the same sizes. Returns nullptr and sets `error` on
+  // failure.
+  static std::shared_ptr<SharedFeaturesCache> open(const std::string& name,
+                                                   size_t max_size,
+                                                   size_t slot_bytes,
+                                                   std::string& error);
+
+  // Returns nullptr if `key` isn't cached. Expired entries are still
+  // returned.
+  std::shared_ptr<const FeaturesEntry> find(std::string_view key) const;
+
+  // Inserts or replaces the entry for `key`. Returns false if it's too big or
+  // its bucket's lock couldn't be taken.
+  bool insert(std::string_view key, const FeaturesEntry& entry);
+
+  // Returns false if `key` isn't cached or its bucket's lock couldn't be
+  // taken.
+  bool erase(std::string_view key);
+
+  // Entries are the slots in use, which may include expired entries. Bytes
+  // are the size of the whole segment.
+  CacheStats stats() const;
+
+ private:
+  struct Header;
+  struct Slot;
+
+  SharedFeaturesCache(char* data, size_t size) : data_(data), size_(size) {}
+
+  // Tries to take a bucket's spinlock for a bounded time.
+  static bool tryLock(std::atomic<uint32_t>& lock);
+  // Makes `slot`'s sequence odd, and returns it.
+  static uint64_t beginWrite(Slot& slot);
+
+  Header& header() const;
+  std::atomic<uint32_t>& lock(size_t bucket) const;
+  Slot& slot(size_t index) const;
+  char* slotData(size_t index) const;
+
+  char* data_;
+  size_t size_;
+  size_t num_buckets_ = 0;
+  size_t num_locks_ = 0;
+  size_t slot_bytes_ = 0;
+  size_t locks_offset_ = 0;
+  size_t slots_offset_ = 0;
+};
+}  // namespace delivery
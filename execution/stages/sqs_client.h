@@ -4,6 +4,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace delivery {
 class SqsClient {
@@ -12,5 +13,13 @@ class SqsClient {
 
   // No callback because this isn't intended to be followed by anything.
   virtual void sendMessage(const std::string& message_body) const = 0;
+
+  // Sends up to 10 messages, whose bodies total at most 256KiB, in one call.
+  virtual void sendMessageBatch(
+      const std::vector<std::string>& message_bodies) const = 0;
+
+  // Returns once every message sent through this client has a response, such
+  // as before shutting down.
+  virtual void waitForSends() const {}
 };
 }  // namespace delivery
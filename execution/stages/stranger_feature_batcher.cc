@@ -0,0 +1,118 @@
+#include "execution/stages/stranger_feature_batcher.h"
+
+#include <json/writer.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#include "execution/stages/lru_cache.h"
+
+namespace delivery {
+namespace {
+// Quotes, a colon, a comma, and up to 20 digits.
+constexpr size_t per_path_bytes = 24;
+}  // namespace
+
+StrangerFeatureBatcher::StrangerFeatureBatcher(
+    std::unique_ptr<SqsClient> sqs_client, Scheduler&& scheduler,
+    std::chrono::milliseconds max_delay, size_t max_seen_paths,
+    uint64_t seen_ttl_millis)
+    : sqs_client_(std::move(sqs_client)),
+      scheduler_(std::move(scheduler)),
+      max_delay_(max_delay),
+      seen_ttl_millis_(seen_ttl_millis),
+      seen_(max_seen_paths),
+      message_(Json::objectValue) {}
+
+void StrangerFeatureBatcher::add(
+    const absl::flat_hash_map<std::string, uint64_t>& paths, uint64_t now) {
+  // IDs are hashes of their paths, so paths alone identify what was reported.
+  // Concurrent requests may both report a path, which is harmless.
+  std::vector<std::pair<std::string_view, uint64_t>> novel_paths;
+  for (const auto& [path, id] : paths) {
+    LruCacheKey key(path);
+    if (seen_.contains(key, now)) {
+      continue;
+    }
+    seen_.insert(key, now + seen_ttl_millis_);
+    novel_paths.emplace_back(path, id);
+  }
+  if (novel_paths.empty()) {
+    return;
+  }
+
+  std::vector<std::vector<std::string>> full_batches;
+  bool schedule_flush = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [path, id] : novel_paths) {
+      const size_t bytes = path.size() + per_path_bytes;
+      if (message_bytes_ > 0 && message_bytes_ + bytes > max_message_bytes) {
+        finishMessage();
+        if (messages_.size() == max_batch_messages) {
+          full_batches.emplace_back(std::move(messages_));
+          messages_.clear();
+        }
+      }
+      message_[std::string(path)] = static_cast<Json::UInt64>(id);
+      message_bytes_ += bytes;
+    }
+    if (!flush_scheduled_) {
+      flush_scheduled_ = true;
+      schedule_flush = true;
+    }
+  }
+
+  for (auto& batch : full_batches) {
+    send(std::move(batch));
+  }
+  // Whatever is left when the flush runs is sent, however recently it was
+  // added.
+  if (schedule_flush) {
+    scheduler_(max_delay_, [this]() { flush(); });
+  }
+}
+
+void StrangerFeatureBatcher::flush() {
+  std::vector<std::string> messages;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_scheduled_ = false;
+    if (message_bytes_ > 0) {
+      finishMessage();
+    }
+    messages = std::move(messages_);
+    messages_.clear();
+  }
+  for (size_t i = 0; i < messages.size(); i += max_batch_messages) {
+    size_t end = std::min(messages.size(), i + max_batch_messages);
+    send(std::vector<std::string>(
+        std::make_move_iterator(messages.begin() + i),
+        std::make_move_iterator(messages.begin() + end)));
+  }
+}
+
+void StrangerFeatureBatcher::flushAndWait() {
+  flush();
+  sqs_client_->waitForSends();
+}
+
+void StrangerFeatureBatcher::finishMessage() {
+  Json::StreamWriterBuilder builder;
+  // This causes no whitespace to be produced.
+  builder["indentation"] = "";
+  messages_.emplace_back(Json::writeString(builder, message_));
+  message_ = Json::Value(Json::objectValue);
+  message_bytes_ = 0;
+}
+
+void StrangerFeatureBatcher::send(std::vector<std::string> messages) {
+  if (messages.size() == 1) {
+    sqs_client_->sendMessage(messages[0]);
+  } else if (!messages.empty()) {
+    sqs_client_->sendMessageBatch(messages);
+  }
+}
+}  // namespace delivery
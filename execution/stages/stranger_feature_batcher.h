@@ -0,0 +1,76 @@
+// Collects stranger feature paths from sampled requests and sends the ones
+// which weren't reported recently to SQS, in batches. Almost every path of a
+// request was already reported by an earlier one, so sending each request's
+// paths on its own mostly repeats them.
+//
+// Messages are JSON objects of paths to IDs, like those the
+// WriteOutStrangerFeatures stage sends per request.
+
+#pragma once
+
+#include <json/value.h>
+#include <stddef.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "execution/stages/negative_cache.h"
+#include "execution/stages/sqs_client.h"
+
+namespace delivery {
+class StrangerFeatureBatcher {
+ public:
+  // Runs the callback after the delay.
+  using Scheduler = std::function<void(const std::chrono::duration<double>&,
+                                       std::function<void()>&&)>;
+
+  // Messages are sent once there are enough for a SendMessageBatch call, or
+  // `max_delay` after a path is added, whichever is first. Up to
+  // `max_seen_paths` reported paths are remembered, and each is reported
+  // again after `seen_ttl_millis` so that lost messages are caught up on.
+  StrangerFeatureBatcher(std::unique_ptr<SqsClient> sqs_client,
+                         Scheduler&& scheduler,
+                         std::chrono::milliseconds max_delay,
+                         size_t max_seen_paths, uint64_t seen_ttl_millis);
+
+  // Queues the paths which weren't reported in the TTL before `now`.
+  void add(const absl::flat_hash_map<std::string, uint64_t>& paths,
+           uint64_t now);
+
+  // Sends everything which is queued.
+  void flush();
+
+  // Sends everything which is queued, and returns once SQS has responded to
+  // every send, such as on shutdown.
+  void flushAndWait();
+
+ private:
+  // SendMessageBatch takes up to 10 messages of up to 256KiB in total.
+  static constexpr size_t max_batch_messages = 10;
+  static constexpr size_t max_message_bytes = 25 * 1024;
+
+  // Serializes the message being built. Requires `mutex_`.
+  void finishMessage();
+  void send(std::vector<std::string> messages);
+
+  std::unique_ptr<SqsClient> sqs_client_;
+  Scheduler scheduler_;
+  std::chrono::milliseconds max_delay_;
+  uint64_t seen_ttl_millis_;
+  // Only used as a bounded set of path fingerprints with expiry.
+  NegativeCache seen_;
+
+  std::mutex mutex_;
+  Json::Value message_;
+  // Approximate size of `message_` once serialized.
+  size_t message_bytes_ = 0;
+  std::vector<std::string> messages_;
+  bool flush_scheduled_ = false;
+};
+}  // namespace delivery
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "execution/stages/batching_feature_store_client.h"
+#include "execution/stages/feature_store_client.h"
+#include "execution/stages/tests/mock_clients.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+class FeatureStoreBatcherTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<FeatureStoreBatcher> makeBatcher(size_t max_keys) {
+    return std::make_unique<FeatureStoreBatcher>(
+        [this]() {
+          auto client = std::make_unique<MockFeatureStoreClient>();
+          EXPECT_CALL(*client, readBatch)
+              .WillOnce([this](auto&, auto&, const auto& keys, auto&,
+                               auto&& cb) {
+                sent_keys_.emplace_back(keys);
+                cbs_.emplace_back(std::move(cb));
+              });
+          return client;
+        },
+        [this](const std::chrono::duration<double>&,
+               std::function<void()>&& cb) {
+          scheduled_.emplace_back(std::move(cb));
+        },
+        std::chrono::milliseconds(1), max_keys);
+  }
+
+  static FeatureStoreResult makeResult(const std::string& key) {
+    FeatureStoreResult result;
+    result.key = key;
+    result.columns_bytes.emplace_back(key + "_bytes");
+    return result;
+  }
+
+  std::vector<std::vector<std::string>> sent_keys_;
+  std::vector<std::function<void(std::vector<FeatureStoreResult>)>> cbs_;
+  std::vector<std::function<void()>> scheduled_;
+};
+
+TEST_F(FeatureStoreBatcherTest, BatchesConcurrentReads) {
+  auto batcher = makeBatcher(/*max_keys=*/100);
+  BatchingFeatureStoreClient client_1(*batcher);
+  BatchingFeatureStoreClient client_2(*batcher);
+  std::vector<FeatureStoreResult> results_1;
+  std::vector<FeatureStoreResult> results_2;
+  client_1.readBatch("table", "pk", {"a", "b"}, "pk,features",
+                     [&results_1](std::vector<FeatureStoreResult> results) {
+                       results_1 = std::move(results);
+                     });
+  client_2.read("table", "pk", "b", "pk,features",
+                [&results_2](std::vector<FeatureStoreResult> results) {
+                  results_2 = std::move(results);
+                });
+  EXPECT_TRUE(sent_keys_.empty());
+
+  // Only the first read of a batch schedules it.
+  ASSERT_EQ(scheduled_.size(), 1);
+  scheduled_[0]();
+  ASSERT_EQ(sent_keys_.size(), 1);
+  EXPECT_THAT(sent_keys_[0], testing::ElementsAre("a", "b"));
+
+  // "a" doesn't exist.
+  cbs_[0]({makeResult("b")});
+  EXPECT_THAT(results_1, testing::ElementsAre(testing::Field(
+                             &FeatureStoreResult::key, "b")));
+  ASSERT_EQ(results_2.size(), 1);
+  EXPECT_EQ(results_2[0].key, "b");
+  EXPECT_THAT(results_2[0].columns_bytes, testing::ElementsAre("b_bytes"));
+}
+
+TEST_F(FeatureStoreBatcherTest, SendsFullBatches) {
+  auto batcher = makeBatcher(/*max_keys=*/2);
+  int num_called = 0;
+  auto cb = [&num_called](std::vector<FeatureStoreResult>) { ++num_called; };
+  batcher->read("table", "pk", {"a", "b", "c"}, "pk,features", cb);
+  ASSERT_EQ(sent_keys_.size(), 1);
+  EXPECT_THAT(sent_keys_[0], testing::ElementsAre("a", "b"));
+
+  // Different columns can't share a batch.
+  batcher->read("table", "pk", {"d"}, "pk,other", cb);
+  ASSERT_EQ(scheduled_.size(), 3);
+  // The full batch's flush is a no-op.
+  scheduled_[0]();
+  EXPECT_EQ(sent_keys_.size(), 1);
+  scheduled_[1]();
+  scheduled_[2]();
+  ASSERT_EQ(sent_keys_.size(), 3);
+  EXPECT_THAT(sent_keys_[1], testing::ElementsAre("c"));
+  EXPECT_THAT(sent_keys_[2], testing::ElementsAre("d"));
+
+  // The first read waits on both of its batches.
+  cbs_[0]({});
+  cbs_[2]({});
+  EXPECT_EQ(num_called, 1);
+  cbs_[1]({});
+  EXPECT_EQ(num_called, 2);
+}
+}  // namespace delivery
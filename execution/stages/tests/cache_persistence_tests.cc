@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "execution/decoded_features.h"
+#include "execution/stages/cache.h"
+#include "execution/stages/cache_persistence.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "utils/time.h"
+
+namespace delivery {
+class CachePersistenceTest : public ::testing::Test {
+ protected:
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  void insert(FeaturesCache& cache, const std::string& key, double value,
+              uint64_t expire_time) {
+    FeaturesEntry entry;
+    auto features = std::make_shared<DecodedFeatures>();
+    features->sparse = {{1, value}};
+    entry.features = std::move(features);
+    entry.expire_time = expire_time;
+    entry.soft_expire_time = expire_time;
+    cache.insert(CacheKey(key.data(), key.size()), CachedFeatures(entry));
+  }
+
+  std::string path_ = testing::TempDir() + "features_cache_dump";
+};
+
+TEST_F(CachePersistenceTest, DumpAndWarm) {
+  uint64_t now = millisSinceEpoch();
+  FeaturesCache cache(100, /*num_shards=*/2);
+  insert(cache, "a", 1, now + 1'000);
+  insert(cache, "b", 2, now + 1'000);
+  insert(cache, "expired", 3, now);
+
+  size_t num_dumped = 0;
+  std::string error;
+  ASSERT_TRUE(dumpFeaturesCache(cache, path_, 100, now, num_dumped, error))
+      << error;
+  EXPECT_EQ(num_dumped, 2);
+
+  FeaturesCache warmed(100, /*num_shards=*/2);
+  size_t num_warmed = 0;
+  ASSERT_TRUE(warmFeaturesCache(warmed, path_, now, 60'000, 0, num_warmed,
+                                error))
+      << error;
+  EXPECT_EQ(num_warmed, 2);
+  EXPECT_EQ(warmed.size(), 2);
+
+  FeaturesCache::ConstAccessor accessor;
+  ASSERT_TRUE(warmed.find(accessor, CacheKey("b", 1)));
+  auto entry = accessor->load();
+  EXPECT_THAT(entry->features->sparse,
+              testing::ElementsAre(testing::Pair(1, 2)));
+  EXPECT_GT(entry->expire_time, now);
+  EXPECT_EQ(entry->soft_expire_time, entry->expire_time);
+  EXPECT_FALSE(warmed.find(accessor, CacheKey("expired", 7)));
+}
+
+TEST_F(CachePersistenceTest, DumpsHottestKeys) {
+  uint64_t now = millisSinceEpoch();
+  FeaturesCache cache(100, /*num_shards=*/1);
+  insert(cache, "a", 1, now + 1'000);
+  insert(cache, "b", 2, now + 1'000);
+  insert(cache, "c", 3, now + 1'000);
+  FeaturesCache::ConstAccessor accessor;
+  ASSERT_TRUE(cache.find(accessor, CacheKey("a", 1)));
+
+  size_t num_dumped = 0;
+  std::string error;
+  ASSERT_TRUE(dumpFeaturesCache(cache, path_, 2, now, num_dumped, error))
+      << error;
+  EXPECT_EQ(num_dumped, 2);
+
+  FeaturesCache warmed(100, /*num_shards=*/1);
+  size_t num_warmed = 0;
+  ASSERT_TRUE(warmFeaturesCache(warmed, path_, now, 60'000, 0, num_warmed,
+                                error))
+      << error;
+  EXPECT_TRUE(warmed.find(accessor, CacheKey("a", 1)));
+  EXPECT_FALSE(warmed.find(accessor, CacheKey("b", 1)));
+  EXPECT_TRUE(warmed.find(accessor, CacheKey("c", 1)));
+}
+
+TEST_F(CachePersistenceTest, WarmSkipsOldAndMissingDumps) {
+  uint64_t now = millisSinceEpoch();
+  FeaturesCache cache(100, /*num_shards=*/1);
+  size_t num_warmed = 1;
+  std::string error;
+  EXPECT_TRUE(
+      warmFeaturesCache(cache, path_, now, 60'000, 0, num_warmed, error));
+  EXPECT_EQ(num_warmed, 0);
+
+  insert(cache, "a", 1, now + 1'000);
+  size_t num_dumped = 0;
+  ASSERT_TRUE(dumpFeaturesCache(cache, path_, 100, now, num_dumped, error))
+      << error;
+  FeaturesCache warmed(100, /*num_shards=*/1);
+  EXPECT_TRUE(warmFeaturesCache(warmed, path_, now + 120'000, 60'000, 0,
+                                num_warmed, error));
+  EXPECT_EQ(num_warmed, 0);
+  EXPECT_EQ(warmed.size(), 0);
+}
+}  // namespace delivery
@@ -206,7 +206,8 @@ TEST_F(CountersParsingTest, CacheAsideReadNullCache) {
   bool called_finish = false;
 
   EXPECT_CALL(*client_, hGetAll).WillOnce(testing::InvokeArgument<1>(data));
-  stage.cacheAsideRead(cache, table_, "some_key", millisSinceEpoch(), counts,
+  stage.cacheAsideRead(cache, CacheTtl(), table_, "some_key",
+                       millisSinceEpoch(), counts,
                        std::make_shared<std::function<void()>>(
                            [&called_finish]() { called_finish = true; }));
   EXPECT_EQ(counts.size(), 1);
@@ -223,19 +224,20 @@ TEST_F(CountersParsingTest, CacheAsideReadMissAndInsert) {
   auto stage = getStageForParsing(user_agent);
   std::string some_key = "some_key";
   int some_millis = 200;
-  std::string timed_key = makeTimedKey(some_key, some_millis);
   bool called_finish = false;
 
   EXPECT_CALL(*client_, hGetAll).WillOnce(testing::InvokeArgument<1>(data));
-  stage.cacheAsideRead(cache, table_, some_key, some_millis, counts,
+  stage.cacheAsideRead(cache, CacheTtl(), table_, some_key, some_millis,
+                       counts,
                        std::make_shared<std::function<void()>>(
                            [&called_finish]() { called_finish = true; }));
   EXPECT_EQ(counts.size(), 1);
   EXPECT_EQ(counts[1], 2);
   // Check that counts were cached.
   Cache::ConstAccessor accessor;
-  EXPECT_TRUE(cache->find(accessor, {timed_key.data(), timed_key.size()}));
-  EXPECT_EQ(accessor.get()->size(), counts.size());
+  ASSERT_TRUE(cache->find(accessor, {some_key.data(), some_key.size()}));
+  EXPECT_EQ(accessor->load()->counts.size(), counts.size());
+  EXPECT_GE(accessor->load()->expire_time, some_millis + CacheTtl().millis);
   EXPECT_TRUE(called_finish);
 }
 
@@ -248,19 +250,20 @@ TEST_F(CountersParsingTest, CacheAsideReadMissAndInsertEmpty) {
   auto stage = getStageForParsing(user_agent);
   std::string some_key = "some_key";
   int some_millis = 200;
-  std::string timed_key = makeTimedKey(some_key, some_millis);
   bool called_finish = false;
 
   EXPECT_CALL(*client_, hGetAll)
       .WillOnce(testing::InvokeArgument<1>(empty_data));
-  stage.cacheAsideRead(cache, table_, some_key, some_millis, counts,
+  stage.cacheAsideRead(cache, CacheTtl(), table_, some_key, some_millis,
+                       counts,
                        std::make_shared<std::function<void()>>(
                            [&called_finish]() { called_finish = true; }));
   EXPECT_TRUE(counts.empty());
   // Check that counts were cached.
   Cache::ConstAccessor accessor;
-  EXPECT_TRUE(cache->find(accessor, {timed_key.data(), timed_key.size()}));
-  EXPECT_EQ(accessor.get()->size(), counts.size());
+  ASSERT_TRUE(cache->find(accessor, {some_key.data(), some_key.size()}));
+  EXPECT_EQ(accessor->load()->counts.size(), counts.size());
+  EXPECT_GE(accessor->load()->expire_time, some_millis + CacheTtl().millis);
   EXPECT_TRUE(called_finish);
 }
 
@@ -269,8 +272,9 @@ TEST_F(CountersParsingTest, CacheAsideReadHit) {
   auto cache = std::make_unique<Cache>(100);
   absl::flat_hash_map<uint64_t, uint64_t> counts = {{1, 2}};
   int some_millis = 200;
-  std::string timed_key = makeTimedKey(some_key, some_millis);
-  cache->insert({timed_key.data(), timed_key.size()}, counts);
+  cache->insert({some_key.data(), some_key.size()},
+                RefreshableEntry<CountsEntry>(
+                    {.counts = counts, .expire_time = some_millis + 1}));
   counts.clear();
   UserAgent user_agent;
   table_.feature_ids = {1};
@@ -279,7 +283,8 @@ TEST_F(CountersParsingTest, CacheAsideReadHit) {
   bool called_finish = false;
 
   EXPECT_CALL(*client_, hGetAll).Times(0);
-  stage.cacheAsideRead(cache, table_, some_key, some_millis, counts,
+  stage.cacheAsideRead(cache, CacheTtl(), table_, some_key, some_millis,
+                       counts,
                        std::make_shared<std::function<void()>>(
                            [&called_finish]() { called_finish = true; }));
   EXPECT_EQ(counts.size(), 1);
@@ -287,14 +292,43 @@ TEST_F(CountersParsingTest, CacheAsideReadHit) {
   EXPECT_TRUE(called_finish);
 }
 
+TEST_F(CountersParsingTest, CacheAsideReadExpired) {
+  std::string some_key = "some_key";
+  auto cache = std::make_unique<Cache>(100);
+  absl::flat_hash_map<uint64_t, uint64_t> counts = {{1, 2}};
+  int some_millis = 200;
+  cache->insert({some_key.data(), some_key.size()},
+                RefreshableEntry<CountsEntry>(
+                    {.counts = counts, .expire_time = some_millis}));
+  counts.clear();
+  UserAgent user_agent;
+  table_.feature_ids = {1};
+  std::vector<std::string> data = {"1", "3"};
+  auto stage = getStageForParsing(user_agent);
+  bool called_finish = false;
+
+  EXPECT_CALL(*client_, hGetAll).WillOnce(testing::InvokeArgument<1>(data));
+  stage.cacheAsideRead(cache, CacheTtl(), table_, some_key, some_millis,
+                       counts,
+                       std::make_shared<std::function<void()>>(
+                           [&called_finish]() { called_finish = true; }));
+  EXPECT_EQ(counts[1], 3);
+  // The expired entry was refreshed.
+  Cache::ConstAccessor accessor;
+  ASSERT_TRUE(cache->find(accessor, {some_key.data(), some_key.size()}));
+  EXPECT_EQ(accessor->load()->counts.at(1), 3);
+  EXPECT_TRUE(called_finish);
+}
+
 TEST_F(CountersParsingTest, CacheAsideReadSegments) {
   std::string some_key = "some_key";
   auto cache = std::make_unique<Cache>(100);
   absl::flat_hash_map<uint64_t, uint64_t> counts = {{1, 2}};
   std::vector<std::string> empty_data;
   int some_millis = 200;
-  std::string timed_key = makeTimedKey(some_key, some_millis);
-  cache->insert({timed_key.data(), timed_key.size()}, counts);
+  cache->insert({some_key.data(), some_key.size()},
+                RefreshableEntry<CountsEntry>(
+                    {.counts = counts, .expire_time = some_millis + 1}));
   counts.clear();
   UserAgent user_agent;
   table_.feature_ids = {1};
@@ -304,7 +338,8 @@ TEST_F(CountersParsingTest, CacheAsideReadSegments) {
 
   EXPECT_CALL(*client_, hGetAll)
       .WillOnce(testing::InvokeArgument<1>(empty_data));
-  stage.cacheAsideRead(cache, table_, some_key, some_millis, counts,
+  stage.cacheAsideRead(cache, CacheTtl(), table_, some_key, some_millis,
+                       counts,
                        std::make_shared<std::function<void()>>(
                            [&called_finish]() { called_finish = true; }),
                        "some_segment");
@@ -0,0 +1,35 @@
+#include <string>
+
+#include "execution/stages/feature_compression.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+TEST(FeatureCompressionTest, RoundTrip) {
+  const std::string value = "some repetitive value, some repetitive value";
+  for (const std::string dictionary : {"", "some repetitive dictionary"}) {
+    std::string compressed;
+    std::string error;
+    ASSERT_TRUE(compressFeatureValue(value, dictionary, /*level=*/3,
+                                     compressed, error));
+    EXPECT_TRUE(isCompressedFeatureValue(compressed));
+    EXPECT_FALSE(isCompressedFeatureValue(value));
+
+    auto decompressor = FeatureDecompressor::create(dictionary, error);
+    ASSERT_NE(decompressor, nullptr);
+    std::string decompressed;
+    ASSERT_TRUE(decompressor->decompress(compressed, decompressed, error));
+    EXPECT_EQ(decompressed, value);
+  }
+}
+
+TEST(FeatureCompressionTest, Truncated) {
+  std::string compressed;
+  std::string error;
+  ASSERT_TRUE(compressFeatureValue("some value", "", /*level=*/3, compressed,
+                                   error));
+  auto decompressor = FeatureDecompressor::create("", error);
+  std::string decompressed;
+  EXPECT_FALSE(decompressor->decompress(compressed.substr(0, 8), decompressed,
+                                        error));
+}
+}  // namespace delivery
@@ -0,0 +1,103 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "execution/decoded_features.h"
+#include "execution/stages/feature_snapshot.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+class FeatureSnapshotTest : public ::testing::Test {
+ protected:
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  std::string path_ = testing::TempDir() + "feature_snapshot";
+};
+
+TEST_F(FeatureSnapshotTest, WriteAndFind) {
+  std::vector<std::pair<std::string, DecodedFeatures>> entries;
+  {
+    auto& [key, features] = entries.emplace_back();
+    key = "b";
+    features.sparse = {{1, 1.5}, {2, 2.5}};
+    features.sparse_id = {{3, -3}};
+    features.sparse_id_list = {{4, {5, 6}}, {7, {}}};
+  }
+  entries.emplace_back().first = "a";
+  entries.emplace_back().first = "c";
+  entries.back().second.sparse = {{8, 9}};
+  std::string error;
+  ASSERT_TRUE(writeFeatureSnapshot(path_, entries, error)) << error;
+
+  auto snapshot = FeatureSnapshot::open(path_, error);
+  ASSERT_NE(snapshot, nullptr) << error;
+  EXPECT_EQ(snapshot->size(), 3);
+
+  auto b = snapshot->find("b");
+  ASSERT_NE(b, nullptr);
+  EXPECT_THAT(b->sparse, testing::ElementsAre(testing::Pair(1, 1.5),
+                                              testing::Pair(2, 2.5)));
+  EXPECT_THAT(b->sparse_id, testing::ElementsAre(testing::Pair(3, -3)));
+  ASSERT_EQ(b->sparse_id_list.size(), 2);
+  EXPECT_EQ(b->sparse_id_list[0].first, 4);
+  EXPECT_THAT(b->sparse_id_list[0].second, testing::ElementsAre(5, 6));
+  EXPECT_EQ(b->sparse_id_list[1].first, 7);
+  EXPECT_TRUE(b->sparse_id_list[1].second.empty());
+
+  auto a = snapshot->find("a");
+  ASSERT_NE(a, nullptr);
+  EXPECT_TRUE(a->empty());
+  auto c = snapshot->find("c");
+  ASSERT_NE(c, nullptr);
+  EXPECT_THAT(c->sparse, testing::ElementsAre(testing::Pair(8, 9)));
+
+  EXPECT_EQ(snapshot->find(""), nullptr);
+  EXPECT_EQ(snapshot->find("bb"), nullptr);
+  EXPECT_EQ(snapshot->find("d"), nullptr);
+}
+
+// Readers of the old snapshot are unaffected by a new one being written.
+TEST_F(FeatureSnapshotTest, Replace) {
+  std::string error;
+  ASSERT_TRUE(writeFeatureSnapshot(path_, {{"old", {}}}, error));
+  auto old_snapshot = FeatureSnapshot::open(path_, error);
+  ASSERT_NE(old_snapshot, nullptr);
+  ASSERT_TRUE(writeFeatureSnapshot(path_, {{"new", {}}}, error));
+  auto new_snapshot = FeatureSnapshot::open(path_, error);
+  ASSERT_NE(new_snapshot, nullptr);
+
+  EXPECT_NE(old_snapshot->find("old"), nullptr);
+  EXPECT_EQ(old_snapshot->find("new"), nullptr);
+  EXPECT_EQ(new_snapshot->find("old"), nullptr);
+  EXPECT_NE(new_snapshot->find("new"), nullptr);
+}
+
+TEST_F(FeatureSnapshotTest, OpenInvalid) {
+  std::string error;
+  EXPECT_EQ(FeatureSnapshot::open(path_ + "_missing", error), nullptr);
+  EXPECT_FALSE(error.empty());
+
+  std::ofstream(path_) << "not a snapshot, but long enough to have a header";
+  error.clear();
+  EXPECT_EQ(FeatureSnapshot::open(path_, error), nullptr);
+  EXPECT_THAT(error, testing::HasSubstr("unknown format"));
+
+  // Truncate a valid snapshot within its index.
+  ASSERT_TRUE(writeFeatureSnapshot(path_, {{"a", {}}, {"b", {}}}, error));
+  std::string bytes;
+  {
+    std::ifstream in(path_, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  std::ofstream(path_, std::ios::binary | std::ios::trunc)
+      << bytes.substr(0, 50);
+  error.clear();
+  EXPECT_EQ(FeatureSnapshot::open(path_, error), nullptr);
+  EXPECT_THAT(error, testing::HasSubstr("corrupt"));
+}
+}  // namespace delivery
@@ -0,0 +1,254 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "execution/stages/lru_cache.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+TEST(ShardedLruCacheTest, FindAndInsert) {
+  ShardedLruCache<int> cache(/*max_size=*/10, /*num_shards=*/2);
+  ShardedLruCache<int>::ConstAccessor accessor;
+  EXPECT_FALSE(cache.find(accessor, {"a", 1}));
+  EXPECT_FALSE(accessor.found());
+  EXPECT_TRUE(cache.insert({"a", 1}, 1));
+  // Existing values aren't overwritten.
+  EXPECT_FALSE(cache.insert({"a", 1}, 2));
+  ASSERT_TRUE(cache.find(accessor, {"a", 1}));
+  EXPECT_EQ(*accessor, 1);
+  EXPECT_EQ(cache.size(), 1);
+  cache.clear();
+  EXPECT_FALSE(cache.find(accessor, {"a", 1}));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(ShardedLruCacheTest, Erase) {
+  ShardedLruCache<int> cache(/*max_size=*/10, /*num_shards=*/1,
+                             CacheAdmission::tiny_lfu);
+  EXPECT_FALSE(cache.erase({"a", 1}));
+  cache.insert({"a", 1}, 1);
+  cache.insert({"b", 1}, 2);
+  // "a" was moved out of the window.
+  EXPECT_TRUE(cache.erase({"a", 1}));
+  EXPECT_TRUE(cache.erase({"b", 1}));
+  ShardedLruCache<int>::ConstAccessor accessor;
+  EXPECT_FALSE(cache.find(accessor, {"a", 1}));
+  EXPECT_EQ(cache.stats().entries, 0);
+  EXPECT_EQ(cache.stats().bytes, 0);
+}
+
+TEST(ShardedLruCacheTest, EvictsLeastRecentlyUsed) {
+  ShardedLruCache<int> cache(/*max_size=*/2, /*num_shards=*/1);
+  cache.insert({"a", 1}, 1);
+  cache.insert({"b", 1}, 2);
+  ShardedLruCache<int>::ConstAccessor accessor;
+  // This makes "b" the least recently used.
+  ASSERT_TRUE(cache.find(accessor, {"a", 1}));
+  cache.insert({"c", 1}, 3);
+  EXPECT_TRUE(cache.find(accessor, {"a", 1}));
+  EXPECT_FALSE(cache.find(accessor, {"b", 1}));
+  EXPECT_TRUE(cache.find(accessor, {"c", 1}));
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(ShardedLruCacheTest, Stats) {
+  ShardedLruCache<int> cache(/*max_size=*/2, /*num_shards=*/1);
+  ShardedLruCache<int>::ConstAccessor accessor;
+  cache.find(accessor, {"a", 1});
+  cache.insert({"a", 1}, 1);
+  cache.insert({"a", 1}, 1);
+  cache.find(accessor, {"a", 1});
+  cache.insert({"b", 1}, 2);
+  cache.insert({"c", 1}, 3);
+  cache.erase({"c", 1});
+  CacheStats stats = cache.stats();
+  EXPECT_EQ(stats.entries, 1);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  // Only inserts of new keys count.
+  EXPECT_EQ(stats.inserts, 3);
+  EXPECT_EQ(stats.evictions, 1);
+}
+
+TEST(ShardedLruCacheTest, FindMany) {
+  ShardedLruCache<int> cache(/*max_size=*/1'000, /*num_shards=*/4);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 100; ++i) {
+    keys.emplace_back(std::to_string(i));
+    if (i % 3 == 0) {
+      cache.insert(LruCacheKey(keys.back()), i);
+    }
+  }
+  std::vector<ShardedLruCache<int>::ConstAccessor> accessors;
+  EXPECT_EQ(cache.findMany(keys, accessors), 34);
+  ASSERT_EQ(accessors.size(), keys.size());
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(accessors[i].found(), i % 3 == 0) << i;
+    if (accessors[i].found()) {
+      EXPECT_EQ(*accessors[i], i);
+    }
+  }
+  EXPECT_EQ(cache.findMany({}, accessors), 0);
+  EXPECT_TRUE(accessors.empty());
+}
+// Reads each of `keys`, and inserts the ones which are missing.
+void readThrough(ShardedLruCache<int>& cache,
+                 const std::vector<std::string>& keys) {
+  for (const auto& key : keys) {
+    ShardedLruCache<int>::ConstAccessor accessor;
+    if (!cache.find(accessor, LruCacheKey(key))) {
+      cache.insert(LruCacheKey(key), 0);
+    }
+  }
+}
+
+size_t numCached(ShardedLruCache<int>& cache,
+                 const std::vector<std::string>& keys) {
+  std::vector<ShardedLruCache<int>::ConstAccessor> accessors;
+  return cache.findMany(keys, accessors);
+}
+
+// A scan of one-off keys evicts hot keys from a plain LRU, but not with
+// TinyLFU admission.
+TEST(ShardedLruCacheTest, TinyLfuResistsScans) {
+  std::vector<std::string> hot_keys;
+  for (int i = 0; i < 90; ++i) {
+    hot_keys.emplace_back(absl::StrCat("hot", i));
+  }
+  std::vector<std::string> scan_keys;
+  for (int i = 0; i < 1'000; ++i) {
+    scan_keys.emplace_back(absl::StrCat("scan", i));
+  }
+
+  ShardedLruCache<int> lru(/*max_size=*/100, /*num_shards=*/1);
+  ShardedLruCache<int> tiny_lfu(/*max_size=*/100, /*num_shards=*/1,
+                                CacheAdmission::tiny_lfu);
+  for (int i = 0; i < 5; ++i) {
+    readThrough(lru, hot_keys);
+    readThrough(tiny_lfu, hot_keys);
+  }
+  readThrough(lru, scan_keys);
+  readThrough(tiny_lfu, scan_keys);
+  EXPECT_EQ(numCached(lru, hot_keys), 0);
+  // The sketch is approximate, so a few scanned keys can still get in.
+  EXPECT_GE(numCached(tiny_lfu, hot_keys), 60);
+  EXPECT_EQ(tiny_lfu.size(), 100);
+}
+
+TEST(ShardedLruCacheTest, ByteBudget) {
+  // Each value weighs itself.
+  ShardedLruCache<int> cache(/*max_size=*/100, /*num_shards=*/1,
+                             CacheAdmission::lru, /*max_bytes=*/1'000,
+                             [](int value) { return value; });
+  cache.insert({"a", 1}, 100);
+  CacheStats stats = cache.stats();
+  EXPECT_EQ(stats.entries, 1);
+  EXPECT_GT(stats.bytes, 100);
+  EXPECT_LT(stats.bytes, 1'000);
+  const size_t overhead = stats.bytes - 100;
+
+  // This only fits if "a" is evicted.
+  cache.insert({"b", 1}, 1'000 - overhead - 50);
+  ShardedLruCache<int>::ConstAccessor accessor;
+  EXPECT_FALSE(cache.find(accessor, {"a", 1}));
+  EXPECT_TRUE(cache.find(accessor, {"b", 1}));
+  EXPECT_EQ(cache.stats().bytes, 1'000 - 50);
+
+  // A shard always keeps its newest entry, even if it's too big.
+  cache.insert({"c", 1}, 2'000);
+  EXPECT_EQ(cache.stats().entries, 1);
+  EXPECT_EQ(cache.stats().bytes, 2'000 + overhead);
+  cache.clear();
+  EXPECT_EQ(cache.stats().bytes, 0);
+}
+
+TEST(ShardedLruCacheTest, Reweigh) {
+  auto value = std::make_shared<int>(100);
+  ShardedLruCache<std::shared_ptr<int>> cache(
+      /*max_size=*/100, /*num_shards=*/1, CacheAdmission::lru,
+      /*max_bytes=*/0, [](const std::shared_ptr<int>& value) {
+        return static_cast<size_t>(*value);
+      });
+  cache.insert({"a", 1}, value);
+  size_t bytes = cache.stats().bytes;
+  *value = 300;
+  cache.reweigh({"a", 1});
+  EXPECT_EQ(cache.stats().bytes, bytes + 200);
+}
+
+TEST(FrequencySketchTest, Estimate) {
+  FrequencySketch sketch(/*max_size=*/100);
+  EXPECT_EQ(sketch.estimate(1), 0);
+  for (int i = 0; i < 3; ++i) {
+    sketch.increment(1);
+  }
+  EXPECT_GE(sketch.estimate(1), 3);
+  // Counts saturate.
+  for (int i = 0; i < 100; ++i) {
+    sketch.increment(2);
+  }
+  EXPECT_EQ(sketch.estimate(2), 15);
+}
+
+TEST(LocalCacheTest, FindAndInsert) {
+  LocalCache<int> cache(/*capacity=*/2, /*generation=*/7);
+  EXPECT_EQ(cache.generation(), 7);
+  EXPECT_EQ(cache.find({"a", 1}), nullptr);
+  cache.insert({"a", 1}, std::make_shared<const int>(1));
+  ASSERT_NE(cache.find({"a", 1}), nullptr);
+  EXPECT_EQ(*cache.find({"a", 1}), 1);
+  // Existing values are replaced.
+  cache.insert({"a", 1}, std::make_shared<const int>(2));
+  EXPECT_EQ(*cache.find({"a", 1}), 2);
+}
+
+TEST(LocalCacheTest, DropsErased) {
+  ShardedLruCache<int> shared(/*max_size=*/10);
+  LocalCache<int> cache(/*capacity=*/2, shared.generation(),
+                        &shared.eraseEpochs());
+  const uint64_t erase_epoch = shared.eraseEpochs().current();
+  cache.insert({"a", 1}, std::make_shared<const int>(1), erase_epoch);
+  ASSERT_NE(cache.find({"a", 1}), nullptr);
+  // The key was evicted or never in the shared cache, but is still erased.
+  EXPECT_FALSE(shared.erase({"a", 1}));
+  EXPECT_EQ(cache.find({"a", 1}), nullptr);
+
+  // Values read after the erasure are kept.
+  cache.insert({"a", 1}, std::make_shared<const int>(3),
+               shared.eraseEpochs().current());
+  ASSERT_NE(cache.find({"a", 1}), nullptr);
+  EXPECT_EQ(*cache.find({"a", 1}), 3);
+}
+
+// Copies of erased keys can't be matched by prefix, so all of them are dropped.
+TEST(LocalCacheTest, DropsErasedByPrefix) {
+  ShardedLruCache<int> shared(/*max_size=*/10, /*num_shards=*/2);
+  shared.insert({"a", 1}, 1);
+  shared.insert({"aios", 4}, 2);
+  shared.insert({"b", 1}, 3);
+  LocalCache<int> cache(/*capacity=*/2, shared.generation(),
+                        &shared.eraseEpochs());
+  cache.insert({"b", 1}, std::make_shared<const int>(3),
+               shared.eraseEpochs().current());
+
+  EXPECT_EQ(shared.erasePrefix("a"), 2);
+  ShardedLruCache<int>::ConstAccessor accessor;
+  EXPECT_FALSE(shared.find(accessor, {"a", 1}));
+  EXPECT_FALSE(shared.find(accessor, {"aios", 4}));
+  EXPECT_TRUE(shared.find(accessor, {"b", 1}));
+  EXPECT_EQ(cache.find({"b", 1}), nullptr);
+}
+
+TEST(LocalCacheTest, EvictsUnreferenced) {
+  LocalCache<int> cache(/*capacity=*/2, /*generation=*/1);
+  cache.insert({"a", 1}, std::make_shared<const int>(1));
+  cache.insert({"b", 1}, std::make_shared<const int>(2));
+  // Only "a" is referenced, so "b" is evicted.
+  cache.find({"a", 1});
+  cache.insert({"c", 1}, std::make_shared<const int>(3));
+  EXPECT_NE(cache.find({"a", 1}), nullptr);
+  EXPECT_EQ(cache.find({"b", 1}), nullptr);
+  EXPECT_NE(cache.find({"c", 1}), nullptr);
+}
+}  // namespace delivery
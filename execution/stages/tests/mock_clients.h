@@ -4,6 +4,7 @@
 #pragma once
 
 #include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -26,12 +27,25 @@ class MockRedisClient : public RedisClient {
               (const std::string&,
                std::function<void(std::vector<std::string>)>&&),
               (override));
+  MOCK_METHOD(
+      void, hMGet,
+      (const std::string&, const std::vector<std::string>&,
+       std::function<void(std::vector<std::optional<std::string>>)>&&),
+      (override));
+  MOCK_METHOD(
+      void, mGet,
+      (const std::vector<std::string>&,
+       std::function<void(std::vector<std::optional<std::string>>)>&&),
+      (override));
   MOCK_METHOD(void, rPush,
               (const std::string&, const std::vector<std::string>&,
                std::function<void(int64_t)>&&),
               (override));
   MOCK_METHOD(void, expire, (const std::string&, int64_t), (override));
+  MOCK_METHOD(void, pSetEx, (const std::string&, int64_t, const std::string&),
+              (override));
   MOCK_METHOD(void, lTrim, (const std::string&, int64_t, int64_t), (override));
+  MOCK_METHOD(void, del, (const std::vector<std::string>&), (override));
 };
 
 class MockFeatureStoreClient : public FeatureStoreClient {
@@ -65,6 +79,9 @@ class MockDeliveryLogWriter : public DeliveryLogWriter {
 class MockSqsClient : public SqsClient {
  public:
   MOCK_METHOD(void, sendMessage, (const std::string&), (const, override));
+  MOCK_METHOD(void, sendMessageBatch, (const std::vector<std::string>&),
+              (const, override));
+  MOCK_METHOD(void, waitForSends, (), (const, override));
 };
 
 class MockMonitoringClient : public MonitoringClient {
@@ -0,0 +1,45 @@
+#include <string>
+
+#include "execution/stages/lru_cache.h"
+#include "execution/stages/negative_cache.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+TEST(NegativeCacheTest, InsertAndExpire) {
+  NegativeCache cache(100, /*num_shards=*/2);
+  EXPECT_FALSE(cache.contains(LruCacheKey("a"), 0));
+  cache.insert(LruCacheKey("a"), 100);
+  EXPECT_TRUE(cache.contains(LruCacheKey("a"), 99));
+  EXPECT_FALSE(cache.contains(LruCacheKey("a"), 100));
+  EXPECT_FALSE(cache.contains(LruCacheKey("b"), 0));
+
+  // Inserting again extends the expiry.
+  cache.insert(LruCacheKey("a"), 200);
+  EXPECT_TRUE(cache.contains(LruCacheKey("a"), 150));
+  CacheStats stats = cache.stats();
+  EXPECT_EQ(stats.entries, 1);
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 3);
+  EXPECT_EQ(stats.inserts, 2);
+  EXPECT_EQ(stats.evictions, 0);
+
+  cache.erase(LruCacheKey("a"));
+  EXPECT_FALSE(cache.contains(LruCacheKey("a"), 0));
+  EXPECT_EQ(cache.stats().entries, 0);
+}
+
+TEST(NegativeCacheTest, FixedSize) {
+  NegativeCache cache(64, /*num_shards=*/1);
+  const size_t bytes = cache.stats().bytes;
+  EXPECT_EQ(bytes, 64 * 2 * sizeof(uint64_t));
+  for (int i = 0; i < 1'000; ++i) {
+    cache.insert(LruCacheKey(std::to_string(i)), 1'000 + i);
+  }
+  EXPECT_LE(cache.stats().entries, 64);
+  EXPECT_EQ(cache.stats().bytes, bytes);
+  // Entries which expire later are kept over those which expire sooner.
+  EXPECT_TRUE(cache.contains(LruCacheKey("999"), 0));
+  cache.clear();
+  EXPECT_EQ(cache.stats().entries, 0);
+}
+}  // namespace delivery
@@ -15,6 +15,7 @@
 #include "execution/paging_context.h"
 #include "execution/stages/paging.h"
 #include "execution/stages/redis_client.h"
+#include "execution/stages/respond.h"
 #include "execution/stages/tests/mock_clients.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -321,6 +322,83 @@ TEST(PagingTest, MakeAllocs) {
   // alloc.
 }
 
+TEST(PagingTest, IsFullyAllocated) {
+  PagingContext context;
+  context.min_position = 2;
+  context.max_position = 3;
+  context.open_positions = {3};
+  SeenInfo info_a;
+  info_a.on_curr_page = true;
+  SeenInfo info_b;
+  info_b.on_curr_page = false;
+  context.seen_infos = {{"a", info_a}, {"b", info_b}};
+  EXPECT_FALSE(isFullyAllocated(context));
+
+  context.open_positions.clear();
+  // Closed positions without an alloc for each of them.
+  EXPECT_FALSE(isFullyAllocated(context));
+
+  context.seen_infos["b"].on_curr_page = true;
+  EXPECT_TRUE(isFullyAllocated(context));
+}
+
+TEST(PagingTest, UseAllocsForCurrPage) {
+  PagingContext context;
+  context.min_position = 1;
+  context.max_position = 2;
+  SeenInfo info_a;
+  info_a.insertion.set_content_id("a");
+  info_a.insertion.set_position(2);
+  info_a.on_curr_page = true;
+  SeenInfo info_b;
+  info_b.insertion.set_content_id("b");
+  info_b.insertion.set_position(0);
+  info_b.on_curr_page = false;
+  SeenInfo info_c;
+  info_c.insertion.set_content_id("c");
+  info_c.insertion.set_position(1);
+  info_c.on_curr_page = true;
+  context.seen_infos = {{"a", info_a}, {"b", info_b}, {"c", info_c}};
+  // Allocated insertions don't have to be on the request.
+  std::vector<delivery::Insertion> insertions(/*n=*/5);
+  useAllocsForCurrPage(context, insertions);
+
+  ASSERT_EQ(insertions.size(), 2);
+  EXPECT_EQ(insertions[0].content_id(), "c");
+  EXPECT_EQ(insertions[1].content_id(), "a");
+}
+
+TEST(PagingTest, MakePreallocs) {
+  PagingContext context;
+  context.min_position = 0;
+  context.max_position = 1;
+  SeenInfo info_d;
+  info_d.insertion.set_position(2);
+  context.seen_infos.emplace("d", info_d);
+  delivery::Response resp;
+  resp.add_insertion()->set_content_id("a");
+  resp.add_insertion()->set_content_id("b");
+  std::vector<delivery::Insertion> insertions;
+  for (const auto* id : {"a", "b", "c", "d", "e", "f", "g"}) {
+    insertions.emplace_back().set_content_id(id);
+  }
+
+  auto preallocs = makePreallocs(context, resp, insertions, /*num_pages=*/1);
+  // Only one page worth, skipping what was responded with or already seen.
+  ASSERT_EQ(preallocs.size(), 2);
+  delivery::Insertion prealloc;
+  ASSERT_TRUE(prealloc.ParseFromString(preallocs[0]));
+  EXPECT_EQ(prealloc.content_id(), "c");
+  // Positions start after the existing preallocation.
+  EXPECT_EQ(prealloc.position(), 3);
+  ASSERT_TRUE(prealloc.ParseFromString(preallocs[1]));
+  EXPECT_EQ(prealloc.content_id(), "e");
+  EXPECT_EQ(prealloc.position(), 4);
+
+  EXPECT_TRUE(
+      makePreallocs(context, resp, insertions, /*num_pages=*/0).empty());
+}
+
 // This verifies that the stage both calls `rPush` and the callback which is
 // passed in.
 TEST(PagingTest, WriteCalls) {
@@ -332,7 +410,9 @@ TEST(PagingTest, WriteCalls) {
   PagingContext context;
   // Imply a novel insertion so writing isn't a no-op.
   context.open_positions = {0};
-  WriteToPagingStage stage(0, std::move(client_ptr), config, resp, context);
+  std::vector<delivery::Insertion> insertions;
+  WriteToPagingStage stage(0, std::move(client_ptr), config, resp, insertions,
+                           context);
   EXPECT_CALL(client, rPush)
       .WillOnce(testing::InvokeArgument<2>(/*num_values=*/0));
   EXPECT_CALL(client, expire).Times(1);
@@ -349,11 +429,78 @@ TEST(PagingTest, WriteCallsWithTrim) {
   resp.add_insertion();
   PagingContext context;
   context.open_positions = {0};
-  WriteToPagingStage stage(0, std::move(client_ptr), config, resp, context);
+  std::vector<delivery::Insertion> insertions;
+  WriteToPagingStage stage(0, std::move(client_ptr), config, resp, insertions,
+                           context);
   EXPECT_CALL(client, rPush)
       .WillOnce(testing::InvokeArgument<2>(/*num_values=*/1'000'000));
   EXPECT_CALL(client, expire).Times(1);
   EXPECT_CALL(client, lTrim).Times(1);
   stage.runSync();
 }
+// The first page responds with part of the list and preallocates the rest, so
+// the second page is served entirely from paging.
+TEST(PagingTest, ServeNextPageFromPreallocs) {
+  PagingConfig config;
+  config.num_preallocated_pages = 1;
+  std::vector<delivery::Insertion> req_insertions;
+  for (const auto* id : {"a", "b", "c", "d", "e"}) {
+    req_insertions.emplace_back().set_content_id(id);
+  }
+  std::vector<std::string> allocs;
+  auto serve_page = [&config, &req_insertions, &allocs](
+                        const std::string& cursor) {
+    delivery::Request req;
+    req.mutable_paging()->set_cursor(cursor);
+    req.mutable_paging()->set_size(2);
+    std::vector<delivery::Insertion> insertions = req_insertions;
+    PagingContext context;
+    auto read_client = std::make_unique<MockRedisClient>();
+    EXPECT_CALL(*read_client, lRange)
+        .WillOnce(testing::InvokeArgument<3>(allocs));
+    ReadFromPagingStage read_stage(0, std::move(read_client), config, req,
+                                   insertions, context);
+    read_stage.run(
+        []() {},
+        [](const std::chrono::duration<double>&, std::function<void()>&&) {});
+
+    delivery::Response resp;
+    RespondStage respond_stage(1, req, context, insertions, resp,
+                               [](const delivery::Response&) {});
+    respond_stage.runSync();
+
+    auto write_client = std::make_unique<MockRedisClient>();
+    EXPECT_CALL(*write_client, rPush)
+        .Times(testing::AtMost(1))
+        .WillOnce([&allocs](const std::string&,
+                            const std::vector<std::string>& values,
+                            std::function<void(int64_t)>&&) {
+          allocs.insert(allocs.end(), values.begin(), values.end());
+        });
+    WriteToPagingStage write_stage(2, std::move(write_client), config, resp,
+                                   insertions, context);
+    write_stage.runSync();
+    return std::make_pair(context.is_fully_allocated, resp);
+  };
+
+  auto [first_fully_allocated, first_resp] = serve_page("0");
+  EXPECT_FALSE(first_fully_allocated);
+  ASSERT_EQ(first_resp.insertion_size(), 2);
+  EXPECT_EQ(first_resp.insertion(0).content_id(), "a");
+  EXPECT_EQ(first_resp.insertion(0).position(), 0);
+  EXPECT_EQ(first_resp.insertion(1).content_id(), "b");
+  EXPECT_EQ(first_resp.insertion(1).position(), 1);
+  EXPECT_EQ(first_resp.paging_info().cursor(), "2");
+  // Two allocs for the response and two preallocs for the next page.
+  EXPECT_EQ(allocs.size(), 4);
+
+  auto [second_fully_allocated, second_resp] = serve_page("2");
+  EXPECT_TRUE(second_fully_allocated);
+  ASSERT_EQ(second_resp.insertion_size(), 2);
+  EXPECT_EQ(second_resp.insertion(0).content_id(), "c");
+  EXPECT_EQ(second_resp.insertion(0).position(), 2);
+  EXPECT_EQ(second_resp.insertion(1).content_id(), "d");
+  EXPECT_EQ(second_resp.insertion(1).position(), 3);
+  EXPECT_EQ(second_resp.paging_info().cursor(), "4");
+}
 }  // namespace delivery
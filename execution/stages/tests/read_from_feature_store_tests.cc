@@ -1,6 +1,9 @@
 #include <google/protobuf/stubs/port.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <cstdio>
 #include <functional>
 #include <memory>
 #include <string>
@@ -8,10 +11,18 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "config/feature_store_config.h"
+#include "execution/decoded_features.h"
 #include "execution/stages/cache.h"
+#include "execution/stages/feature_compression.h"
+#include "execution/stages/feature_snapshot.h"
 #include "execution/stages/feature_store_client.h"
+#include "execution/stages/negative_cache.h"
 #include "execution/stages/read_from_feature_store.h"
+#include "execution/stages/redis_features_cache.h"
+#include "execution/stages/shared_features_cache.h"
 #include "execution/stages/tests/mock_clients.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -19,6 +30,17 @@
 #include "utils/time.h"
 
 namespace delivery {
+TEST(ReadFromFeatureStoreTest, ParseFeatureStoreTimeout) {
+  bool valid = false;
+  EXPECT_EQ(parseFeatureStoreTimeout("250", &valid), 250);
+  EXPECT_TRUE(valid);
+  EXPECT_EQ(parseFeatureStoreTimeout("10ms"), 10);
+  EXPECT_EQ(parseFeatureStoreTimeout("", &valid), 500);
+  EXPECT_FALSE(valid);
+  EXPECT_EQ(parseFeatureStoreTimeout("-1", &valid), 500);
+  EXPECT_FALSE(valid);
+}
+
 TEST(ReadFromFeatureStoreTest, DeserializeAndCache) {
   std::string some_key = "some_key";
   std::string another_key = "another_key";
@@ -33,58 +55,341 @@ TEST(ReadFromFeatureStoreTest, DeserializeAndCache) {
 
   uint64_t start_time = 2001;
   FeaturesCache cache(1'000);
-  absl::flat_hash_map<std::string, delivery_private_features::Features>
+  absl::flat_hash_map<std::string, std::shared_ptr<const DecodedFeatures>>
       id_to_features;
-  std::function<void(std::string_view, delivery_private_features::Features)>
-      feature_adder =
-          [&id_to_features](std::string_view id,
-                            delivery_private_features::Features features) {
-            id_to_features[id] = std::move(features);
-          };
+  std::function<void(std::string_view, std::shared_ptr<const DecodedFeatures>)>
+      feature_adder = [&id_to_features](
+                          std::string_view id,
+                          std::shared_ptr<const DecodedFeatures> features) {
+        id_to_features[id] = std::move(features);
+      };
   std::vector<std::string> errors;
 
-  deserializeAndCache(results, keys_to_fetch, start_time, cache, feature_adder,
-                      errors);
+  FeatureStoreConfig config;
+  config.ttl_jitter = 0;
+  deserializeAndCache(results, keys_to_fetch, start_time, cache,
+                      /*negative_cache=*/nullptr, config,
+                      /*decompressor=*/nullptr, feature_adder, errors);
   FeaturesCache::ConstAccessor accessor;
   {
-    std::string timed_key = makeTimedKey(some_key, start_time);
-    EXPECT_TRUE(cache.find(accessor, {timed_key.data(), timed_key.size()}));
+    ASSERT_TRUE(cache.find(accessor, {some_key.data(), some_key.size()}));
+    EXPECT_EQ(accessor->load()->expire_time, start_time + 15 * 60 * 1'000);
     ASSERT_TRUE(id_to_features.contains(some_key));
-    ASSERT_TRUE(id_to_features[some_key].sparse().contains(8));
-    EXPECT_EQ(id_to_features[some_key].sparse().at(8), 9);
+    EXPECT_THAT(id_to_features[some_key]->sparse,
+                testing::ElementsAre(testing::Pair(8, 9)));
+    // The cache shares the decoded features with the request.
+    EXPECT_EQ(accessor->load()->features, id_to_features[some_key]);
     EXPECT_TRUE(errors.empty());
   }
   {
-    std::string timed_key = makeTimedKey(another_key, start_time);
-    EXPECT_TRUE(cache.find(accessor, {timed_key.data(), timed_key.size()}));
+    ASSERT_TRUE(
+        cache.find(accessor, {another_key.data(), another_key.size()}));
+    EXPECT_TRUE(accessor->load()->features->empty());
     EXPECT_FALSE(id_to_features.contains(another_key));
     EXPECT_TRUE(errors.empty());
   }
 }
 
+// Unprocessed keys, such as throttled ones, might exist and so aren't cached as
+// missing.
+TEST(ReadFromFeatureStoreTest, DeserializeAndCacheUnprocessed) {
+  std::vector<FeatureStoreResult> results;
+  auto& result = results.emplace_back();
+  result.key = "unprocessed";
+  result.unprocessed = true;
+  FeaturesCache cache(1'000);
+  int num_added = 0;
+  std::function<void(std::string_view, std::shared_ptr<const DecodedFeatures>)>
+      feature_adder =
+          [&num_added](std::string_view,
+                       std::shared_ptr<const DecodedFeatures>) { ++num_added; };
+  std::vector<std::string> errors;
+
+  deserializeAndCache(results, {"unprocessed", "missing"}, /*start_time=*/500,
+                      cache, /*negative_cache=*/nullptr, FeatureStoreConfig(),
+                      /*decompressor=*/nullptr, feature_adder, errors);
+  FeaturesCache::ConstAccessor accessor;
+  EXPECT_FALSE(cache.find(accessor, {"unprocessed", 11}));
+  EXPECT_TRUE(cache.find(accessor, {"missing", 7}));
+  EXPECT_EQ(num_added, 0);
+  EXPECT_THAT(errors, testing::ElementsAre(
+                          "1 of 2 feature store keys were unprocessed"));
+}
+
+// Compressed and uncompressed columns can be mixed.
+// Missing keys are only cached in the negative cache, and served as empty.
+TEST(ReadFromFeatureStoreTest, NegativeCache) {
+  FeaturesCache cache(1'000);
+  NegativeCache negative_cache(1'000);
+  // This was cached before it was deleted.
+  cache.insert({"missing", 7}, CachedFeatures(FeaturesEntry()));
+  std::function<void(std::string_view, std::shared_ptr<const DecodedFeatures>)>
+      deserialize_adder =
+          [](std::string_view, std::shared_ptr<const DecodedFeatures>) {};
+  std::vector<std::string> errors;
+  FeatureStoreConfig config;
+  config.negative_ttl_millis = 100;
+  config.ttl_jitter = 0;
+  deserializeAndCache({}, {"missing"}, /*start_time=*/500, cache,
+                      &negative_cache, config, /*decompressor=*/nullptr,
+                      deserialize_adder, errors);
+  EXPECT_TRUE(errors.empty());
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_TRUE(negative_cache.contains({"missing", 7}, 599));
+  EXPECT_FALSE(negative_cache.contains({"missing", 7}, 600));
+
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  std::function<void(std::string_view, const DecodedFeatures&)> feature_adder =
+      [&id_to_features](std::string_view id, const DecodedFeatures& features) {
+        id_to_features[id] = features;
+      };
+  std::vector<std::string> keys_to_fetch;
+  std::vector<std::string> keys_to_refresh;
+  processCachedKeys({"missing", "uncached"}, /*start_time=*/550, cache,
+                    &negative_cache, config, feature_adder, keys_to_fetch,
+                    keys_to_refresh);
+  EXPECT_EQ(id_to_features.size(), 1);
+  EXPECT_TRUE(id_to_features["missing"].empty());
+  EXPECT_THAT(keys_to_fetch, testing::ElementsAre("uncached"));
+
+  // Expired keys are read again.
+  keys_to_fetch.clear();
+  processCachedKeys({"missing"}, /*start_time=*/600, cache, &negative_cache,
+                    config, feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_THAT(keys_to_fetch, testing::ElementsAre("missing"));
+}
+
+// Keys added to feature store since they were negatively cached are served
+// once read again, such as by a prefetch.
+TEST(ReadFromFeatureStoreTest, NegativeCacheErasedOnResult) {
+  FeaturesCache cache(1'000);
+  NegativeCache negative_cache(1'000);
+  negative_cache.insert({"added", 5}, /*expire_time=*/1'000);
+  std::function<void(std::string_view, std::shared_ptr<const DecodedFeatures>)>
+      deserialize_adder =
+          [](std::string_view, std::shared_ptr<const DecodedFeatures>) {};
+  std::vector<FeatureStoreResult> results;
+  auto& result = results.emplace_back();
+  result.key = "added";
+  delivery_private_features::FeaturesList features_list;
+  (*features_list.add_features()->mutable_sparse())[1] = 2;
+  features_list.SerializeToString(&result.columns_bytes.emplace_back());
+  std::vector<std::string> errors;
+  FeatureStoreConfig config;
+  deserializeAndCache(results, {"added"}, /*start_time=*/500, cache,
+                      &negative_cache, config, /*decompressor=*/nullptr,
+                      deserialize_adder, errors);
+  EXPECT_TRUE(errors.empty());
+  EXPECT_FALSE(negative_cache.contains({"added", 5}, 600));
+
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  std::function<void(std::string_view, const DecodedFeatures&)> feature_adder =
+      [&id_to_features](std::string_view id, const DecodedFeatures& features) {
+        id_to_features[id] = features;
+      };
+  std::vector<std::string> keys_to_fetch;
+  std::vector<std::string> keys_to_refresh;
+  processCachedKeys({"added"}, /*start_time=*/600, cache, &negative_cache,
+                    config, feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_TRUE(keys_to_fetch.empty());
+  EXPECT_THAT(id_to_features["added"].sparse,
+              testing::ElementsAre(testing::Pair(1, 2)));
+}
+
+TEST(ReadFromFeatureStoreTest, DeserializeAndCacheCompressed) {
+  const std::string dictionary = "some dictionary content";
+  std::string error;
+  auto decompressor = FeatureDecompressor::create(dictionary, error);
+  ASSERT_NE(decompressor, nullptr);
+  std::vector<FeatureStoreResult> results;
+  auto& result = results.emplace_back();
+  result.key = "a";
+  delivery_private_features::FeaturesList features_list;
+  (*features_list.add_features()->mutable_sparse())[8] = 9;
+  ASSERT_TRUE(compressFeatureValue(features_list.SerializeAsString(),
+                                   dictionary, /*level=*/3,
+                                   result.columns_bytes.emplace_back(), error));
+  features_list.Clear();
+  (*features_list.add_features()->mutable_sparse())[10] = 11;
+  features_list.SerializeToString(&result.columns_bytes.emplace_back());
+  FeatureStoreResult corrupt_result;
+  corrupt_result.key = "b";
+  corrupt_result.columns_bytes.emplace_back(
+      result.columns_bytes[0].substr(0, 8));
+  results.emplace_back(std::move(corrupt_result));
+  FeaturesCache cache(1'000);
+  absl::flat_hash_map<std::string, std::shared_ptr<const DecodedFeatures>>
+      id_to_features;
+  std::function<void(std::string_view, std::shared_ptr<const DecodedFeatures>)>
+      feature_adder = [&id_to_features](
+                          std::string_view id,
+                          std::shared_ptr<const DecodedFeatures> features) {
+        id_to_features[id] = std::move(features);
+      };
+  std::vector<std::string> errors;
+
+  deserializeAndCache(results, {"a", "b"}, /*start_time=*/500, cache,
+                      /*negative_cache=*/nullptr, FeatureStoreConfig(),
+                      decompressor.get(), feature_adder, errors);
+  ASSERT_TRUE(id_to_features.contains("a"));
+  EXPECT_THAT(id_to_features["a"]->sparse,
+              testing::ElementsAre(testing::Pair(8, 9), testing::Pair(10, 11)));
+  ASSERT_TRUE(id_to_features.contains("b"));
+  EXPECT_TRUE(id_to_features["b"]->empty());
+  ASSERT_EQ(errors.size(), 1);
+  EXPECT_THAT(errors[0], testing::EndsWith(" for ID b"));
+}
+
 TEST(ReadFromFeatureStoreTest, ProcessCachedKeys) {
   std::vector<std::string> keys{"a", "b"};
   FeaturesCache cache(1'000);
   uint64_t start_time = 2002;
   // Cache the first key. Don't care about the value.
-  std::string timed_key = makeTimedKey(keys[0], start_time);
-  CacheKey cache_key(timed_key.data(), timed_key.size());
-  cache.insert(cache_key, {});
-  absl::flat_hash_map<std::string, delivery_private_features::Features>
-      id_to_features;
-  std::function<void(std::string_view, delivery_private_features::Features)>
-      feature_adder =
-          [&id_to_features](std::string_view id,
-                            delivery_private_features::Features features) {
-            id_to_features[id] = std::move(features);
-          };
+  cache.insert({keys[0].data(), keys[0].size()},
+               CachedFeatures({.soft_expire_time = start_time + 1,
+                               .expire_time = start_time + 1}));
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  std::function<void(std::string_view, const DecodedFeatures&)> feature_adder =
+      [&id_to_features](std::string_view id, const DecodedFeatures& features) {
+        id_to_features[id] = features;
+      };
   std::vector<std::string> keys_to_fetch;
+  std::vector<std::string> keys_to_refresh;
 
-  processCachedKeys(keys, start_time, cache, feature_adder, keys_to_fetch);
+  processCachedKeys(keys, start_time, cache, /*negative_cache=*/nullptr,
+                    FeatureStoreConfig(), feature_adder, keys_to_fetch,
+                    keys_to_refresh);
   EXPECT_EQ(id_to_features.size(), 1);
   EXPECT_TRUE(id_to_features.contains("a"));
   ASSERT_EQ(keys_to_fetch.size(), 1);
   EXPECT_EQ(keys_to_fetch[0], "b");
+  EXPECT_TRUE(keys_to_refresh.empty());
+}
+
+TEST(ReadFromFeatureStoreTest, ProcessCachedKeysStaleWhileRevalidate) {
+  FeatureStoreConfig config;
+  config.soft_ttl_millis = 100;
+  config.hard_ttl_millis = 1'000;
+  FeaturesCache cache(1'000);
+  cache.insert({"fresh", 5}, CachedFeatures({.soft_expire_time = 1'050,
+                                             .expire_time = 1'950}));
+  cache.insert({"stale", 5}, CachedFeatures({.soft_expire_time = 600,
+                                             .expire_time = 1'500}));
+  cache.insert({"expired", 7},
+               CachedFeatures({.soft_expire_time = 100, .expire_time = 1'000}));
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  std::function<void(std::string_view, const DecodedFeatures&)> feature_adder =
+      [&id_to_features](std::string_view id, const DecodedFeatures& features) {
+        id_to_features[id] = features;
+      };
+  std::vector<std::string> keys_to_fetch;
+  std::vector<std::string> keys_to_refresh;
+
+  processCachedKeys({"fresh", "stale", "expired", "missing"},
+                    /*start_time=*/1'000, cache, /*negative_cache=*/nullptr,
+                    config, feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_EQ(id_to_features.size(), 2);
+  EXPECT_TRUE(id_to_features.contains("fresh"));
+  EXPECT_TRUE(id_to_features.contains("stale"));
+  EXPECT_THAT(keys_to_fetch, testing::ElementsAre("expired", "missing"));
+  EXPECT_THAT(keys_to_refresh, testing::ElementsAre("stale"));
+}
+
+// Fresh entries stay in the thread's local cache until the shared cache is
+// cleared.
+TEST(ReadFromFeatureStoreTest, ProcessCachedKeysLocalCache) {
+  FeaturesCache cache(/*max_size=*/1, /*num_shards=*/1);
+  auto features = std::make_shared<DecodedFeatures>();
+  features->sparse.emplace_back(8, 9);
+  cache.insert({"a", 1}, CachedFeatures({.features = features,
+                                         .soft_expire_time = 100,
+                                         .expire_time = 100}));
+  int num_added = 0;
+  std::function<void(std::string_view, const DecodedFeatures&)> feature_adder =
+      [&num_added](std::string_view, const DecodedFeatures&) { ++num_added; };
+  std::vector<std::string> keys_to_fetch;
+  std::vector<std::string> keys_to_refresh;
+  processCachedKeys({"a"}, /*start_time=*/1, cache,
+                    /*negative_cache=*/nullptr, FeatureStoreConfig(),
+                    feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_EQ(num_added, 1);
+
+  // Evict "a" from the shared cache.
+  cache.insert({"b", 1}, CachedFeatures({}));
+  processCachedKeys({"a"}, /*start_time=*/2, cache,
+                    /*negative_cache=*/nullptr, FeatureStoreConfig(),
+                    feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_EQ(num_added, 2);
+  EXPECT_TRUE(keys_to_fetch.empty());
+
+  // The local entry isn't served past its soft TTL.
+  processCachedKeys({"a"}, /*start_time=*/100, cache,
+                    /*negative_cache=*/nullptr, FeatureStoreConfig(),
+                    feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_EQ(num_added, 2);
+  EXPECT_THAT(keys_to_fetch, testing::ElementsAre("a"));
+
+  keys_to_fetch.clear();
+  cache.clear();
+  processCachedKeys({"a"}, /*start_time=*/3, cache,
+                    /*negative_cache=*/nullptr, FeatureStoreConfig(),
+                    feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_EQ(num_added, 2);
+  EXPECT_THAT(keys_to_fetch, testing::ElementsAre("a"));
+}
+
+// Invalidating keys erases them from every thread's local cache too.
+TEST(ReadFromFeatureStoreTest, ProcessCachedKeysLocalCacheErase) {
+  FeaturesCache cache(/*max_size=*/10, /*num_shards=*/1);
+  cache.insert({"a", 1}, CachedFeatures({.soft_expire_time = 100,
+                                         .expire_time = 100}));
+  int num_added = 0;
+  std::function<void(std::string_view, const DecodedFeatures&)> feature_adder =
+      [&num_added](std::string_view, const DecodedFeatures&) { ++num_added; };
+  std::vector<std::string> keys_to_fetch;
+  std::vector<std::string> keys_to_refresh;
+  processCachedKeys({"a"}, /*start_time=*/1, cache,
+                    /*negative_cache=*/nullptr, FeatureStoreConfig(),
+                    feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_EQ(num_added, 1);
+
+  EXPECT_TRUE(cache.erase({"a", 1}));
+  processCachedKeys({"a"}, /*start_time=*/2, cache,
+                    /*negative_cache=*/nullptr, FeatureStoreConfig(),
+                    feature_adder, keys_to_fetch, keys_to_refresh);
+  EXPECT_EQ(num_added, 1);
+  EXPECT_THAT(keys_to_fetch, testing::ElementsAre("a"));
+}
+
+TEST(ReadFromFeatureStoreTest, DeserializeAndCacheRefreshes) {
+  FeatureStoreConfig config;
+  config.soft_ttl_millis = 100;
+  config.hard_ttl_millis = 1'000;
+  config.ttl_jitter = 0;
+  FeaturesCache cache(1'000);
+  cache.insert({"a", 1},
+               CachedFeatures({.soft_expire_time = 1, .expire_time = 1}));
+  std::vector<FeatureStoreResult> results;
+  auto& result = results.emplace_back();
+  result.key = "a";
+  delivery_private_features::FeaturesList features_list;
+  (*features_list.add_features()->mutable_sparse())[8] = 9;
+  features_list.SerializeToString(&result.columns_bytes.emplace_back());
+  std::function<void(std::string_view, std::shared_ptr<const DecodedFeatures>)>
+      feature_adder = [](std::string_view,
+                         std::shared_ptr<const DecodedFeatures>) {};
+  std::vector<std::string> errors;
+
+  deserializeAndCache(results, {"a"}, /*start_time=*/500, cache,
+                      /*negative_cache=*/nullptr, config,
+                      /*decompressor=*/nullptr, feature_adder, errors);
+  FeaturesCache::ConstAccessor accessor;
+  ASSERT_TRUE(cache.find(accessor, {"a", 1}));
+  auto entry = accessor->load();
+  EXPECT_EQ(entry->soft_expire_time, 600);
+  EXPECT_EQ(entry->expire_time, 1'500);
+  EXPECT_THAT(entry->features->sparse,
+              testing::ElementsAre(testing::Pair(8, 9)));
 }
 
 TEST(ReadFromFeatureStoreTest, Read) {
@@ -99,12 +404,10 @@ TEST(ReadFromFeatureStoreTest, Read) {
   auto key_generator = []() -> std::vector<std::string> {
     return {"some_key"};
   };
-  absl::flat_hash_map<std::string, delivery_private_features::Features>
-      id_to_features;
-  auto feature_adder = [&id_to_features](
-                           std::string_view id,
-                           delivery_private_features::Features features) {
-    id_to_features[id] = std::move(features);
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  auto feature_adder = [&id_to_features](std::string_view id,
+                                         const DecodedFeatures& features) {
+    id_to_features[id] = features;
   };
   ReadFromFeatureStoreStage stage(0, cache, std::move(client_ptr), config,
                                   timeout, 2001, key_generator, feature_adder);
@@ -130,12 +433,10 @@ TEST(ReadFromFeatureStoreTest, ReadBatch) {
   auto key_generator = []() -> std::vector<std::string> {
     return {"some_key", "some_other_key"};
   };
-  absl::flat_hash_map<std::string, delivery_private_features::Features>
-      id_to_features;
-  auto feature_adder = [&id_to_features](
-                           std::string_view id,
-                           delivery_private_features::Features features) {
-    id_to_features[id] = std::move(features);
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  auto feature_adder = [&id_to_features](std::string_view id,
+                                         const DecodedFeatures& features) {
+    id_to_features[id] = features;
   };
   ReadFromFeatureStoreStage stage(0, cache, std::move(client_ptr), config,
                                   timeout, 2001, key_generator, feature_adder);
@@ -148,4 +449,386 @@ TEST(ReadFromFeatureStoreTest, ReadBatch) {
   EXPECT_TRUE(ran);
   EXPECT_TRUE(timed_out);
 }
+
+TEST(ReadFromFeatureStoreTest, InFlightReads) {
+  InFlightReads in_flight(/*stale_after_millis=*/100);
+  int calls = 0;
+  auto waiter = [&calls](const DecodedFeatures& features) {
+    EXPECT_THAT(features.sparse, testing::ElementsAre(testing::Pair(1, 2)));
+    ++calls;
+  };
+  EXPECT_TRUE(in_flight.join("a", /*now=*/1'000, waiter));
+  EXPECT_FALSE(in_flight.join("a", /*now=*/1'050, waiter));
+  // Stale leaders get taken over, but earlier waiters are kept.
+  EXPECT_TRUE(in_flight.join("a", /*now=*/1'100, waiter));
+  EXPECT_TRUE(in_flight.join("b", /*now=*/1'100, waiter));
+  EXPECT_EQ(in_flight.size(), 2);
+
+  DecodedFeatures features;
+  features.sparse = {{1, 2}};
+  in_flight.complete("a", features);
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(in_flight.size(), 1);
+  // Completing again is a no-op.
+  in_flight.complete("a", features);
+  EXPECT_EQ(calls, 3);
+}
+
+// A second request for a key which is already being read waits on the first
+// read instead of issuing its own.
+TEST(ReadFromFeatureStoreTest, ReadCoalesced) {
+  FeaturesCache cache(1'000);
+  FeatureStoreConfig config;
+  std::string timeout = "10ms";
+  auto key_generator = []() -> std::vector<std::string> {
+    return {"coalesced_key"};
+  };
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  auto feature_adder = [&id_to_features](std::string_view id,
+                                         const DecodedFeatures& features) {
+    id_to_features[id] = features;
+  };
+  auto timeout_cb = [](const std::chrono::duration<double>&,
+                       std::function<void()>&&) {};
+
+  auto leader_client_ptr = std::make_unique<MockFeatureStoreClient>();
+  auto& leader_client = *leader_client_ptr;
+  ReadFromFeatureStoreStage leader(0, cache, std::move(leader_client_ptr),
+                                   config, timeout, 2001, key_generator,
+                                   feature_adder);
+  std::function<void(std::vector<FeatureStoreResult>)> leader_cb;
+  EXPECT_CALL(leader_client, read)
+      .WillOnce([&leader_cb](auto&, auto&, auto&, auto&, auto&& cb) {
+        leader_cb = std::move(cb);
+      });
+  bool leader_ran = false;
+  leader.run([&leader_ran]() { leader_ran = true; }, timeout_cb);
+
+  auto follower_client_ptr = std::make_unique<MockFeatureStoreClient>();
+  auto& follower_client = *follower_client_ptr;
+  ReadFromFeatureStoreStage follower(1, cache, std::move(follower_client_ptr),
+                                     config, timeout, 2001, key_generator,
+                                     feature_adder);
+  EXPECT_CALL(follower_client, read).Times(0);
+  bool follower_ran = false;
+  follower.run([&follower_ran]() { follower_ran = true; }, timeout_cb);
+  EXPECT_FALSE(leader_ran);
+  EXPECT_FALSE(follower_ran);
+
+  ASSERT_TRUE(leader_cb != nullptr);
+  leader_cb({});
+  EXPECT_TRUE(leader_ran);
+  EXPECT_TRUE(follower_ran);
+  EXPECT_EQ(featureStoreInFlightReads().size(), 0);
+}
+
+// Stale entries don't make the request wait, but are refreshed in the
+// background.
+TEST(ReadFromFeatureStoreTest, ReadStaleWhileRevalidate) {
+  FeaturesCache cache(1'000);
+  FeatureStoreConfig config;
+  config.soft_ttl_millis = 100;
+  config.hard_ttl_millis = 1'000;
+  config.ttl_jitter = 0;
+  cache.insert({"swr_key", 7}, CachedFeatures({.soft_expire_time = 1'100,
+                                               .expire_time = 2'000}));
+  auto client_ptr = std::make_unique<MockFeatureStoreClient>();
+  auto& client = *client_ptr;
+  std::string timeout = "10ms";
+  auto key_generator = []() -> std::vector<std::string> {
+    return {"swr_key"};
+  };
+  int num_added = 0;
+  auto feature_adder = [&num_added](std::string_view, const DecodedFeatures&) {
+    ++num_added;
+  };
+  ReadFromFeatureStoreStage stage(0, cache, std::move(client_ptr), config,
+                                  timeout, /*start_time=*/1'500, key_generator,
+                                  feature_adder);
+  std::function<void(std::vector<FeatureStoreResult>)> refresh_cb;
+  EXPECT_CALL(client, read)
+      .WillOnce([&refresh_cb](auto&, auto&, auto&, auto&, auto&& cb) {
+        refresh_cb = std::move(cb);
+      });
+  bool ran = false;
+  bool timed_out = false;
+  stage.run(
+      [&ran]() { ran = true; },
+      [&timed_out](const std::chrono::duration<double>&,
+                   std::function<void()>&&) { timed_out = true; });
+  EXPECT_TRUE(ran);
+  EXPECT_FALSE(timed_out);
+  EXPECT_EQ(num_added, 1);
+
+  ASSERT_TRUE(refresh_cb != nullptr);
+  refresh_cb({});
+  EXPECT_EQ(num_added, 1);
+  FeaturesCache::ConstAccessor accessor;
+  ASSERT_TRUE(cache.find(accessor, {"swr_key", 7}));
+  EXPECT_EQ(accessor->load()->expire_time, 2'500);
+  EXPECT_EQ(featureStoreInFlightReads().size(), 0);
+}
+
+// Keys in the snapshot are served and cached without going to feature store.
+TEST(ReadFromFeatureStoreTest, ReadFromSnapshot) {
+  std::string path = testing::TempDir() + "read_from_snapshot";
+  DecodedFeatures snapshot_features;
+  snapshot_features.sparse = {{1, 2}};
+  std::string error;
+  ASSERT_TRUE(writeFeatureSnapshot(path, {{"in_snapshot", snapshot_features}},
+                                   error));
+  auto snapshot = FeatureSnapshot::open(path, error);
+  ASSERT_NE(snapshot, nullptr) << error;
+  std::remove(path.c_str());
+
+  FeaturesCache cache(1'000);
+  FeatureStoreConfig config;
+  config.ttl_jitter = 0;
+  auto client_ptr = std::make_unique<MockFeatureStoreClient>();
+  auto& client = *client_ptr;
+  std::string timeout = "10ms";
+  auto key_generator = []() -> std::vector<std::string> {
+    return {"in_snapshot", "not_in_snapshot"};
+  };
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  auto feature_adder = [&id_to_features](std::string_view id,
+                                         const DecodedFeatures& features) {
+    id_to_features[id] = features;
+  };
+  ReadFromFeatureStoreStage stage(0, cache, std::move(client_ptr), config,
+                                  timeout, 2001, key_generator, feature_adder,
+                                  snapshot);
+  EXPECT_CALL(client, read(testing::_, testing::_, "not_in_snapshot",
+                           testing::_, testing::_))
+      .WillOnce(testing::InvokeArgument<4>(std::vector<FeatureStoreResult>()));
+  bool ran = false;
+  stage.run([&ran]() { ran = true; },
+            [](const std::chrono::duration<double>&, std::function<void()>&&) {
+            });
+  EXPECT_TRUE(ran);
+  ASSERT_TRUE(id_to_features.contains("in_snapshot"));
+  EXPECT_THAT(id_to_features["in_snapshot"].sparse,
+              testing::ElementsAre(testing::Pair(1, 2)));
+  FeaturesCache::ConstAccessor accessor;
+  ASSERT_TRUE(cache.find(accessor, {"in_snapshot", 11}));
+  EXPECT_EQ(accessor->load()->expire_time, 2001 + 15 * 60 * 1'000);
+}
+
+// Keys in the shared cache are served without going to feature store, and
+// what's read from feature store is shared.
+TEST(ReadFromFeatureStoreTest, ReadFromSharedCache) {
+  const std::string name =
+      absl::StrCat("/read_from_shared_cache_", getpid());
+  std::string error;
+  auto shared_cache = SharedFeaturesCache::open(name, 100, 256, error);
+  shm_unlink(name.c_str());
+  ASSERT_NE(shared_cache, nullptr) << error;
+  FeaturesEntry shared_entry;
+  auto shared_features = std::make_shared<DecodedFeatures>();
+  shared_features->sparse = {{1, 2}};
+  shared_entry.features = shared_features;
+  shared_entry.soft_expire_time = 3'000;
+  shared_entry.expire_time = 5'000;
+  ASSERT_TRUE(shared_cache->insert("shared", shared_entry));
+  shared_entry.soft_expire_time = 1'000;
+  ASSERT_TRUE(shared_cache->insert("stale", shared_entry));
+
+  FeaturesCache cache(1'000);
+  FeatureStoreConfig config;
+  config.ttl_jitter = 0;
+  auto client_ptr = std::make_unique<MockFeatureStoreClient>();
+  auto& client = *client_ptr;
+  std::string timeout = "10ms";
+  auto key_generator = []() -> std::vector<std::string> {
+    return {"shared", "stale", "not_shared"};
+  };
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  auto feature_adder = [&id_to_features](std::string_view id,
+                                         const DecodedFeatures& features) {
+    id_to_features[id] = features;
+  };
+  ReadFromFeatureStoreStage stage(
+      0, cache, std::move(client_ptr), config, timeout, 2001, key_generator,
+      feature_adder, /*snapshot=*/nullptr, /*decompressor=*/nullptr,
+      shared_cache);
+  std::vector<FeatureStoreResult> results;
+  auto& result = results.emplace_back();
+  result.key = "not_shared";
+  delivery_private_features::FeaturesList features_list;
+  (*features_list.add_features()->mutable_sparse())[3] = 4;
+  features_list.SerializeToString(&result.columns_bytes.emplace_back());
+  // The stale key is only refreshed, apart from the key the stage waits on.
+  EXPECT_CALL(client, read(testing::_, testing::_, "stale", testing::_,
+                           testing::_))
+      .WillOnce(testing::InvokeArgument<4>(std::vector<FeatureStoreResult>{}));
+  EXPECT_CALL(client, read(testing::_, testing::_, "not_shared", testing::_,
+                           testing::_))
+      .WillOnce(testing::InvokeArgument<4>(results));
+  bool ran = false;
+  stage.run([&ran]() { ran = true; },
+            [](const std::chrono::duration<double>&, std::function<void()>&&) {
+            });
+  EXPECT_TRUE(ran);
+  EXPECT_EQ(id_to_features.size(), 3);
+  EXPECT_THAT(id_to_features["shared"].sparse,
+              testing::ElementsAre(testing::Pair(1, 2)));
+  FeaturesCache::ConstAccessor accessor;
+  ASSERT_TRUE(cache.find(accessor, {"shared", 6}));
+  EXPECT_EQ(accessor->load()->expire_time, 5'000);
+
+  auto fetched = shared_cache->find("not_shared");
+  ASSERT_NE(fetched, nullptr);
+  EXPECT_THAT(fetched->features->sparse,
+              testing::ElementsAre(testing::Pair(3, 4)));
+  EXPECT_EQ(fetched->expire_time, 2001 + 15 * 60 * 1'000);
+}
+
+TEST(ReadFromFeatureStoreTest, ReadFromRedisCache) {
+  auto redis_client_ptr = std::make_unique<MockRedisClient>();
+  auto& redis_client = *redis_client_ptr;
+  auto redis_cache =
+      std::make_shared<RedisFeaturesCache>(std::move(redis_client_ptr));
+  // Entries are only shared until their soft expiry, which is in real time.
+  const uint64_t start_time = millisSinceEpoch();
+  FeaturesEntry redis_entry;
+  auto redis_features = std::make_shared<DecodedFeatures>();
+  redis_features->sparse = {{1, 2}};
+  redis_entry.features = redis_features;
+  redis_entry.soft_expire_time = start_time + 60'000;
+  redis_entry.expire_time = start_time + 120'000;
+  std::string value;
+  EXPECT_CALL(redis_client, pSetEx("features:t:shared", testing::_, testing::_))
+      .WillOnce(testing::SaveArg<2>(&value));
+  redis_cache->insert("t", "shared", redis_entry, start_time);
+
+  FeaturesCache cache(1'000);
+  FeatureStoreConfig config;
+  config.table = "t";
+  config.ttl_jitter = 0;
+  auto client_ptr = std::make_unique<MockFeatureStoreClient>();
+  auto& client = *client_ptr;
+  std::string timeout = "10ms";
+  auto key_generator = []() -> std::vector<std::string> {
+    return {"shared", "fetched", "missing"};
+  };
+  absl::flat_hash_map<std::string, DecodedFeatures> id_to_features;
+  auto feature_adder = [&id_to_features](std::string_view id,
+                                         const DecodedFeatures& features) {
+    id_to_features[id] = features;
+  };
+  ReadFromFeatureStoreStage stage(
+      0, cache, std::move(client_ptr), config, timeout, start_time,
+      key_generator, feature_adder, /*snapshot=*/nullptr,
+      /*decompressor=*/nullptr, /*shared_cache=*/nullptr,
+      /*negative_cache=*/nullptr, redis_cache);
+  EXPECT_CALL(redis_client,
+              mGet(testing::UnorderedElementsAre("features:t:shared",
+                                                 "features:t:fetched",
+                                                 "features:t:missing"),
+                   testing::_))
+      .WillOnce([&value](const std::vector<std::string>& keys, auto&& cb) {
+        std::vector<std::optional<std::string>> values;
+        for (const auto& key : keys) {
+          values.emplace_back(key == "features:t:shared"
+                                  ? std::optional<std::string>(value)
+                                  : std::nullopt);
+        }
+        cb(std::move(values));
+      });
+  std::vector<FeatureStoreResult> results;
+  auto& result = results.emplace_back();
+  result.key = "fetched";
+  delivery_private_features::FeaturesList features_list;
+  (*features_list.add_features()->mutable_sparse())[3] = 4;
+  features_list.SerializeToString(&result.columns_bytes.emplace_back());
+  // Only the keys missing from Redis are read, and then written to it.
+  EXPECT_CALL(client, readBatch(testing::_, testing::_,
+                                testing::UnorderedElementsAre("fetched",
+                                                              "missing"),
+                                testing::_, testing::_))
+      .WillOnce(testing::InvokeArgument<4>(results));
+  EXPECT_CALL(redis_client,
+              pSetEx("features:t:fetched", testing::_, testing::_));
+  EXPECT_CALL(redis_client,
+              pSetEx("features:t:missing", testing::_, testing::_));
+  bool ran = false;
+  stage.run([&ran]() { ran = true; },
+            [](const std::chrono::duration<double>&, std::function<void()>&&) {
+            });
+  EXPECT_TRUE(ran);
+  EXPECT_EQ(id_to_features.size(), 3);
+  EXPECT_THAT(id_to_features["shared"].sparse,
+              testing::ElementsAre(testing::Pair(1, 2)));
+  EXPECT_THAT(id_to_features["fetched"].sparse,
+              testing::ElementsAre(testing::Pair(3, 4)));
+  FeaturesCache::ConstAccessor accessor;
+  ASSERT_TRUE(cache.find(accessor, {"shared", 6}));
+  EXPECT_EQ(accessor->load()->expire_time, start_time + 120'000);
+}
+
+// Stale keys are refreshed even if Redis only responds after the timeout.
+TEST(ReadFromFeatureStoreTest, RefreshWithoutWaitingOnRedis) {
+  auto redis_client_ptr = std::make_unique<MockRedisClient>();
+  auto& redis_client = *redis_client_ptr;
+  auto redis_cache =
+      std::make_shared<RedisFeaturesCache>(std::move(redis_client_ptr));
+  const uint64_t start_time = millisSinceEpoch();
+  FeaturesCache cache(1'000);
+  cache.insert({"stale_redis", 11},
+               CachedFeatures({.soft_expire_time = start_time - 1,
+                               .expire_time = start_time + 60'000}));
+  FeatureStoreConfig config;
+  config.table = "t";
+  auto client_ptr = std::make_unique<MockFeatureStoreClient>();
+  auto& client = *client_ptr;
+  std::string timeout = "10ms";
+  auto key_generator = []() -> std::vector<std::string> {
+    return {"stale_redis", "missing_redis"};
+  };
+  auto feature_adder = [](std::string_view, const DecodedFeatures&) {};
+  ReadFromFeatureStoreStage stage(
+      0, cache, std::move(client_ptr), config, timeout, start_time,
+      key_generator, feature_adder, /*snapshot=*/nullptr,
+      /*decompressor=*/nullptr, /*shared_cache=*/nullptr,
+      /*negative_cache=*/nullptr, redis_cache);
+  std::function<void(std::vector<std::optional<std::string>>)> redis_cb;
+  EXPECT_CALL(redis_client,
+              mGet(testing::ElementsAre("features:t:missing_redis"),
+                   testing::_))
+      .WillOnce([&redis_cb](const std::vector<std::string>&, auto&& cb) {
+        redis_cb = cb;
+      });
+  EXPECT_CALL(client, read(testing::_, testing::_, "stale_redis", testing::_,
+                           testing::_));
+  std::function<void()> timeout_cb;
+  bool ran = false;
+  stage.run([&ran]() { ran = true; },
+            [&timeout_cb](const std::chrono::duration<double>&,
+                          std::function<void()>&& cb) { timeout_cb = cb; });
+  testing::Mock::VerifyAndClearExpectations(&client);
+
+  timeout_cb();
+  EXPECT_TRUE(ran);
+  // Nothing else is read once the stage is done.
+  EXPECT_CALL(client, read).Times(0);
+  EXPECT_CALL(client, readBatch).Times(0);
+  redis_cb({std::nullopt});
+}
+
+TEST(ReadFromFeatureStoreTest, JitteredExpireTime) {
+  EXPECT_EQ(jitteredExpireTime("a", /*now=*/100, /*ttl_millis=*/1'000,
+                               /*jitter=*/0),
+            1'100);
+  absl::flat_hash_set<uint64_t> expire_times;
+  for (int i = 0; i < 100; ++i) {
+    uint64_t expire_time = jitteredExpireTime(absl::StrCat(i), /*now=*/100,
+                                              /*ttl_millis=*/1'000,
+                                              /*jitter=*/0.5);
+    EXPECT_GE(expire_time, 1'100);
+    EXPECT_LT(expire_time, 1'600);
+    expire_times.emplace(expire_time);
+  }
+  // Entries written together shouldn't all expire together.
+  EXPECT_GT(expire_times.size(), 1);
+}
 }  // namespace delivery
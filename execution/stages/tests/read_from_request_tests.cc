@@ -151,6 +151,23 @@ TEST_F(ReadFromRequestTest, UserAgentStranger) {
       scope.stranger_feature_paths.contains(user_agent_prefix + "unknown"));
 }
 
+TEST_F(ReadFromRequestTest, StrangersNotSampled) {
+  *req_.mutable_device()->mutable_browser()->mutable_user_agent() = "unknown";
+  *req_.mutable_device()->mutable_browser()->mutable_referrer() = "a";
+  insertions_.emplace_back().set_content_id("b");
+  context_.initialize(insertions_, /*record_stranger_paths=*/false);
+  getStage().runSync();
+
+  const auto& scope = context_.getRequestFeatures();
+  hashlib::HashState state;
+  state.updateState(referrer_prefix);
+  state.updateState(std::string("a"));
+  EXPECT_EQ(scope.features.at(state.digestState()), 1);
+  EXPECT_TRUE(scope.stranger_feature_paths.empty());
+  EXPECT_TRUE(
+      context_.getInsertionFeatures("b").stranger_feature_paths.empty());
+}
+
 TEST_F(ReadFromRequestTest, UserInfo) {
   *req_.mutable_user_info()->mutable_log_user_id() = "a";
   *req_.mutable_user_info()->mutable_user_id() = "b";
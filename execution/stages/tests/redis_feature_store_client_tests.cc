@@ -0,0 +1,71 @@
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "execution/stages/feature_store_client.h"
+#include "execution/stages/redis_feature_store_client.h"
+#include "execution/stages/tests/mock_clients.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+TEST(RedisFeatureStoreClientTest, Read) {
+  auto redis_client_ptr = std::make_unique<MockRedisClient>();
+  auto& redis_client = *redis_client_ptr;
+  RedisFeatureStoreClient client(std::move(redis_client_ptr));
+  EXPECT_CALL(redis_client,
+              hMGet("table:a", testing::ElementsAre("features"), testing::_))
+      .WillOnce(testing::InvokeArgument<2>(
+          std::vector<std::optional<std::string>>{"bytes"}));
+
+  std::vector<FeatureStoreResult> results;
+  client.read("table", "pk", "a", "pk,features",
+              [&results](std::vector<FeatureStoreResult> res) {
+                results = std::move(res);
+              });
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].key, "a");
+  EXPECT_THAT(results[0].columns_bytes, testing::ElementsAre("bytes"));
+  EXPECT_FALSE(results[0].unprocessed);
+}
+
+TEST(RedisFeatureStoreClientTest, ReadBatch) {
+  auto redis_client_ptr = std::make_unique<MockRedisClient>();
+  auto& redis_client = *redis_client_ptr;
+  RedisFeatureStoreClient client(std::move(redis_client_ptr));
+  std::vector<std::function<void(std::vector<std::optional<std::string>>)>>
+      cbs;
+  EXPECT_CALL(redis_client,
+              hMGet(testing::_, testing::ElementsAre("f1", "f2"), testing::_))
+      .Times(3)
+      .WillRepeatedly([&cbs](auto&, auto&, auto&& cb) {
+        cbs.emplace_back(std::move(cb));
+      });
+
+  bool called = false;
+  std::vector<FeatureStoreResult> results;
+  client.readBatch("table", "pk", {"found", "missing", "failed"}, "pk,f1,f2",
+                   [&called, &results](std::vector<FeatureStoreResult> res) {
+                     called = true;
+                     results = std::move(res);
+                   });
+  ASSERT_EQ(cbs.size(), 3);
+  cbs[0]({"bytes1", std::nullopt});
+  cbs[1]({std::nullopt, std::nullopt});
+  EXPECT_FALSE(called);
+  // Errors feed an empty vector.
+  cbs[2]({});
+  ASSERT_TRUE(called);
+
+  ASSERT_EQ(results.size(), 2);
+  EXPECT_EQ(results[0].key, "found");
+  EXPECT_THAT(results[0].columns_bytes, testing::ElementsAre("bytes1"));
+  EXPECT_FALSE(results[0].unprocessed);
+  EXPECT_EQ(results[1].key, "failed");
+  EXPECT_TRUE(results[1].columns_bytes.empty());
+  EXPECT_TRUE(results[1].unprocessed);
+}
+}  // namespace delivery
@@ -0,0 +1,85 @@
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "execution/decoded_features.h"
+#include "execution/stages/cache.h"
+#include "execution/stages/redis_features_cache.h"
+#include "execution/stages/tests/mock_clients.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+TEST(RedisFeaturesCacheTest, InsertAndFind) {
+  auto redis_client_ptr = std::make_unique<MockRedisClient>();
+  auto& redis_client = *redis_client_ptr;
+  RedisFeaturesCache cache(std::move(redis_client_ptr));
+
+  FeaturesEntry entry;
+  auto features = std::make_shared<DecodedFeatures>();
+  features->sparse = {{1, 2}};
+  features->sparse_id_list = {{3, {4, 5}}};
+  entry.features = features;
+  entry.soft_expire_time = 3'000;
+  entry.expire_time = 5'000;
+  std::string value;
+  EXPECT_CALL(redis_client, pSetEx("features:table:a", 2'000, testing::_))
+      .WillOnce(testing::SaveArg<2>(&value));
+  cache.insert("table", "a", entry, /*now=*/1'000);
+  // Past its soft expiry, there's nothing to share.
+  cache.insert("table", "b", entry, /*now=*/3'000);
+
+  EXPECT_CALL(redis_client,
+              mGet(testing::ElementsAre("features:table:a",
+                                        "features:table:b"),
+                   testing::_))
+      .WillOnce(testing::InvokeArgument<1>(
+          std::vector<std::optional<std::string>>{value, std::nullopt}));
+  RedisFeaturesCache::Entries entries;
+  cache.find("table", {"a", "b"},
+             [&entries](RedisFeaturesCache::Entries found) {
+               entries = std::move(found);
+             });
+  ASSERT_EQ(entries.size(), 2);
+  ASSERT_NE(entries[0], nullptr);
+  EXPECT_EQ(entries[0]->soft_expire_time, 3'000);
+  EXPECT_EQ(entries[0]->expire_time, 5'000);
+  EXPECT_THAT(entries[0]->features->sparse,
+              testing::ElementsAre(testing::Pair(1, 2)));
+  EXPECT_THAT(
+      entries[0]->features->sparse_id_list,
+      testing::ElementsAre(testing::Pair(3, testing::ElementsAre(4, 5))));
+  EXPECT_EQ(entries[1], nullptr);
+}
+
+TEST(RedisFeaturesCacheTest, Erase) {
+  auto redis_client_ptr = std::make_unique<MockRedisClient>();
+  auto& redis_client = *redis_client_ptr;
+  RedisFeaturesCache cache(std::move(redis_client_ptr));
+
+  EXPECT_CALL(redis_client, del(testing::ElementsAre("features:table:a",
+                                                     "features:table:b")));
+  cache.erase("table", {"a", "b"});
+  // Nothing to erase.
+  cache.erase("table", {});
+}
+
+TEST(RedisFeaturesCacheTest, FindErrors) {
+  auto redis_client_ptr = std::make_unique<MockRedisClient>();
+  auto& redis_client = *redis_client_ptr;
+  RedisFeaturesCache cache(std::move(redis_client_ptr));
+  EXPECT_CALL(redis_client, mGet(testing::SizeIs(2), testing::_))
+      .WillOnce(testing::InvokeArgument<1>(
+          std::vector<std::optional<std::string>>{}));
+
+  RedisFeaturesCache::Entries entries;
+  cache.find("table", {"a", "b"},
+             [&entries](RedisFeaturesCache::Entries found) {
+               entries = std::move(found);
+             });
+  EXPECT_THAT(entries, testing::ElementsAre(nullptr, nullptr));
+}
+}  // namespace delivery
@@ -76,4 +76,35 @@ TEST(RespondStageTest, SortByPosition) {
   EXPECT_EQ(resp.insertion(0).position(), 100);
   EXPECT_EQ(resp.insertion(1).position(), 101);
 }
+TEST(RespondStageTest, CutToCurrPage) {
+  delivery::Request req;
+  PagingContext paging_context;
+  paging_context.has_curr_page = true;
+  paging_context.min_position = 2;
+  paging_context.max_position = 4;
+  paging_context.open_positions = {2, 4};
+  SeenInfo seen_info;
+  seen_info.insertion.set_content_id("a");
+  seen_info.insertion.set_position(3);
+  seen_info.on_curr_page = true;
+  paging_context.seen_infos.emplace("a", seen_info);
+  std::vector<delivery::Insertion> insertions;
+  for (const auto *id : {"b", "a", "c", "d"}) {
+    insertions.emplace_back().set_content_id(id);
+  }
+  insertions[1].set_position(3);
+  delivery::Response resp;
+  RespondStage stage(0, req, paging_context, insertions, resp,
+                     [](const delivery::Response &) {});
+  stage.runSync();
+
+  ASSERT_EQ(resp.insertion_size(), 3);
+  EXPECT_EQ(resp.insertion(0).content_id(), "b");
+  EXPECT_EQ(resp.insertion(0).position(), 2);
+  EXPECT_EQ(resp.insertion(1).content_id(), "a");
+  EXPECT_EQ(resp.insertion(1).position(), 3);
+  EXPECT_EQ(resp.insertion(2).content_id(), "c");
+  EXPECT_EQ(resp.insertion(2).position(), 4);
+  EXPECT_EQ(resp.paging_info().cursor(), "5");
+}
 }  // namespace delivery
@@ -0,0 +1,126 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "execution/decoded_features.h"
+#include "execution/stages/cache.h"
+#include "execution/stages/shared_features_cache.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+class SharedFeaturesCacheTest : public ::testing::Test {
+ protected:
+  void TearDown() override { shm_unlink(name_.c_str()); }
+
+  FeaturesEntry makeEntry(double value, uint64_t expire_time) {
+    FeaturesEntry entry;
+    auto features = std::make_shared<DecodedFeatures>();
+    features->sparse = {{1, value}};
+    features->sparse_id_list = {{2, {3, 4}}};
+    entry.features = std::move(features);
+    entry.soft_expire_time = expire_time - 1;
+    entry.expire_time = expire_time;
+    return entry;
+  }
+
+  std::string name_ = absl::StrCat("/shared_features_cache_test_", getpid());
+};
+
+TEST_F(SharedFeaturesCacheTest, InsertAndFind) {
+  std::string error;
+  auto cache = SharedFeaturesCache::open(name_, 100, 256, error);
+  ASSERT_NE(cache, nullptr) << error;
+  EXPECT_EQ(cache->find("a"), nullptr);
+
+  EXPECT_TRUE(cache->insert("a", makeEntry(1.5, 100)));
+  auto entry = cache->find("a");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_THAT(entry->features->sparse,
+              testing::ElementsAre(testing::Pair(1, 1.5)));
+  ASSERT_EQ(entry->features->sparse_id_list.size(), 1);
+  EXPECT_THAT(entry->features->sparse_id_list[0].second,
+              testing::ElementsAre(3, 4));
+  EXPECT_EQ(entry->soft_expire_time, 99);
+  EXPECT_EQ(entry->expire_time, 100);
+
+  // Inserting again replaces the entry.
+  EXPECT_TRUE(cache->insert("a", makeEntry(2.5, 200)));
+  entry = cache->find("a");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_THAT(entry->features->sparse,
+              testing::ElementsAre(testing::Pair(1, 2.5)));
+  EXPECT_EQ(cache->stats().entries, 1);
+
+  EXPECT_TRUE(cache->erase("a"));
+  EXPECT_FALSE(cache->erase("a"));
+  EXPECT_EQ(cache->find("a"), nullptr);
+  EXPECT_EQ(cache->stats().entries, 0);
+}
+
+TEST_F(SharedFeaturesCacheTest, SharedAcrossMappings) {
+  std::string error;
+  auto writer = SharedFeaturesCache::open(name_, 100, 256, error);
+  ASSERT_NE(writer, nullptr) << error;
+  auto reader = SharedFeaturesCache::open(name_, 100, 256, error);
+  ASSERT_NE(reader, nullptr) << error;
+  EXPECT_TRUE(writer->insert("a", makeEntry(1, 100)));
+  auto entry = reader->find("a");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_THAT(entry->features->sparse,
+              testing::ElementsAre(testing::Pair(1, 1)));
+
+  // Every process has to agree on the size.
+  EXPECT_EQ(SharedFeaturesCache::open(name_, 1'000, 256, error), nullptr);
+  EXPECT_FALSE(error.empty());
+}
+
+TEST_F(SharedFeaturesCacheTest, TooBig) {
+  std::string error;
+  auto cache = SharedFeaturesCache::open(name_, 100, 64, error);
+  ASSERT_NE(cache, nullptr) << error;
+  EXPECT_FALSE(cache->insert("a", makeEntry(1, 100)));
+  EXPECT_EQ(cache->find("a"), nullptr);
+}
+
+TEST_F(SharedFeaturesCacheTest, EvictsFirstToExpire) {
+  std::string error;
+  // This is a single bucket.
+  auto cache = SharedFeaturesCache::open(name_, 4, 256, error);
+  ASSERT_NE(cache, nullptr) << error;
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(cache->insert(std::to_string(i), makeEntry(i, 100 + i)));
+  }
+  EXPECT_TRUE(cache->insert("4", makeEntry(4, 200)));
+  EXPECT_EQ(cache->find("0"), nullptr);
+  for (int i = 1; i < 5; ++i) {
+    EXPECT_NE(cache->find(std::to_string(i)), nullptr) << i;
+  }
+}
+
+TEST_F(SharedFeaturesCacheTest, ConcurrentReadsAndWrites) {
+  std::string error;
+  auto cache = SharedFeaturesCache::open(name_, 4, 256, error);
+  ASSERT_NE(cache, nullptr) << error;
+  // Readers only see whole entries, whose values match their expiry.
+  std::thread writer([this, &cache]() {
+    for (int i = 1; i <= 10'000; ++i) {
+      cache->insert("a", makeEntry(i, i));
+    }
+  });
+  for (int i = 0; i < 10'000; ++i) {
+    auto entry = cache->find("a");
+    if (entry != nullptr) {
+      ASSERT_THAT(entry->features->sparse,
+                  testing::ElementsAre(testing::Pair(
+                      1, static_cast<double>(entry->expire_time))));
+    }
+  }
+  writer.join();
+}
+}  // namespace delivery
@@ -0,0 +1,108 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "execution/stages/stranger_feature_batcher.h"
+#include "execution/stages/tests/mock_clients.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+class StrangerFeatureBatcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto sqs_client = std::make_unique<MockSqsClient>();
+    sqs_client_ = sqs_client.get();
+    batcher_ = std::make_unique<StrangerFeatureBatcher>(
+        std::move(sqs_client),
+        [this](const std::chrono::duration<double>& delay,
+               std::function<void()>&& cb) {
+          delay_ = delay;
+          scheduled_.emplace_back(std::move(cb));
+        },
+        std::chrono::milliseconds(500), /*max_seen_paths=*/1'000,
+        /*seen_ttl_millis=*/1'000);
+  }
+
+  void runScheduled() {
+    auto scheduled = std::move(scheduled_);
+    scheduled_.clear();
+    for (auto& cb : scheduled) {
+      cb();
+    }
+  }
+
+  MockSqsClient* sqs_client_;
+  std::unique_ptr<StrangerFeatureBatcher> batcher_;
+  std::chrono::duration<double> delay_;
+  std::vector<std::function<void()>> scheduled_;
+};
+
+TEST_F(StrangerFeatureBatcherTest, FlushOnSchedule) {
+  batcher_->add({{"a", 1}, {"b", 2}}, 100);
+  batcher_->add({{"b", 2}, {"c", 3}}, 200);
+  // Only the first add schedules a flush.
+  ASSERT_EQ(scheduled_.size(), 1);
+  EXPECT_EQ(delay_, std::chrono::milliseconds(500));
+
+  std::string message;
+  EXPECT_CALL(*sqs_client_, sendMessage)
+      .WillOnce(testing::SaveArg<0>(&message));
+  runScheduled();
+  EXPECT_EQ(message, R"({"a":1,"b":2,"c":3})");
+
+  // Nothing is sent for paths which were reported recently.
+  EXPECT_CALL(*sqs_client_, sendMessage).Times(0);
+  batcher_->add({{"a", 1}, {"c", 3}}, 1'000);
+  EXPECT_TRUE(scheduled_.empty());
+  batcher_->flush();
+}
+
+TEST_F(StrangerFeatureBatcherTest, FlushAndWait) {
+  batcher_->add({{"a", 1}}, 100);
+  testing::InSequence in_sequence;
+  EXPECT_CALL(*sqs_client_, sendMessage);
+  EXPECT_CALL(*sqs_client_, waitForSends);
+  batcher_->flushAndWait();
+}
+
+TEST_F(StrangerFeatureBatcherTest, ReportAgainAfterTtl) {
+  batcher_->add({{"a", 1}}, 100);
+  batcher_->add({{"b", 2}}, 600);
+  EXPECT_CALL(*sqs_client_, sendMessage).Times(1);
+  batcher_->flush();
+
+  std::string message;
+  EXPECT_CALL(*sqs_client_, sendMessage)
+      .WillOnce(testing::SaveArg<0>(&message));
+  batcher_->add({{"a", 1}, {"b", 2}}, 1'200);
+  batcher_->flush();
+  EXPECT_EQ(message, R"({"a":1})");
+}
+
+TEST_F(StrangerFeatureBatcherTest, SendBatches) {
+  // Each path is about 1KiB, so messages hold about 25 of them.
+  absl::flat_hash_map<std::string, uint64_t> paths;
+  for (uint64_t i = 0; i < 300; ++i) {
+    paths[std::to_string(i) + std::string(1'000, 'x')] = i;
+  }
+  std::vector<std::string> messages;
+  // A full batch is sent as soon as it's ready.
+  EXPECT_CALL(*sqs_client_, sendMessageBatch(testing::SizeIs(10)))
+      .WillOnce(testing::SaveArg<0>(&messages));
+  batcher_->add(paths, 100);
+  testing::Mock::VerifyAndClearExpectations(sqs_client_);
+  for (const auto& message : messages) {
+    EXPECT_LE(message.size(), 25 * 1024);
+  }
+
+  // The rest are sent on flush.
+  EXPECT_CALL(*sqs_client_, sendMessageBatch(testing::SizeIs(3)));
+  runScheduled();
+}
+}  // namespace delivery
@@ -0,0 +1,64 @@
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "execution/stages/feature_store_client.h"
+#include "execution/stages/tests/mock_clients.h"
+#include "execution/stages/timed_feature_store_client.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "json/json.h"
+#include "utils/histogram.h"
+#include "utils/trace.h"
+
+namespace delivery {
+TEST(TimedFeatureStoreClientTest, RecordOnCallback) {
+  auto mock_client = std::make_unique<MockFeatureStoreClient>();
+  std::function<void(std::vector<FeatureStoreResult>)> read_cb;
+  EXPECT_CALL(*mock_client, read("table", "key", "a", "features", testing::_))
+      .WillOnce(
+          [&read_cb](auto&, auto&, auto&, auto&, auto&& cb) { read_cb = cb; });
+  EXPECT_CALL(*mock_client,
+              readBatch("table", "key", testing::ElementsAre("b", "c"),
+                        "features", testing::_))
+      .WillOnce(testing::InvokeArgument<4>(std::vector<FeatureStoreResult>{}));
+  Histogram histogram;
+  TimedFeatureStoreClient client(std::move(mock_client), histogram);
+
+  size_t num_results = 0;
+  client.read("table", "key", "a", "features",
+              [&num_results](std::vector<FeatureStoreResult> results) {
+                num_results = results.size();
+              });
+  // Nothing is recorded until the read calls back.
+  EXPECT_EQ(histogram.count(), 0);
+  read_cb({FeatureStoreResult{.key = "a"}});
+  EXPECT_EQ(num_results, 1);
+  EXPECT_EQ(histogram.count(), 1);
+
+  client.readBatch("table", "key", {"b", "c"}, "features",
+                   [](std::vector<FeatureStoreResult>) {});
+  EXPECT_EQ(histogram.count(), 2);
+}
+
+TEST(TimedFeatureStoreClientTest, AddSpans) {
+  auto mock_client = std::make_unique<MockFeatureStoreClient>();
+  EXPECT_CALL(*mock_client, read)
+      .WillOnce(testing::InvokeArgument<4>(std::vector<FeatureStoreResult>{}));
+  Histogram histogram;
+  auto trace = std::make_shared<Trace>("request");
+  TimedFeatureStoreClient client(std::move(mock_client), histogram, trace);
+  client.read("table", "key", "a", "features",
+              [](std::vector<FeatureStoreResult>) {});
+
+  Json::Value events(Json::arrayValue);
+  trace->appendEvents(events, /*pid=*/1);
+  // After the process name.
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[1]["name"], "FeatureStore");
+  EXPECT_EQ(events[1]["cat"], "backend");
+  EXPECT_EQ(events[1]["args"]["table"], "table");
+}
+}  // namespace delivery
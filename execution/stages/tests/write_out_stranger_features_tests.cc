@@ -1,4 +1,6 @@
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -7,6 +9,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "execution/feature_context.h"
 #include "execution/stages/sqs_client.h"
+#include "execution/stages/stranger_feature_batcher.h"
 #include "execution/stages/tests/mock_clients.h"
 #include "execution/stages/write_out_stranger_features.h"
 #include "gmock/gmock.h"
@@ -60,6 +63,13 @@ TEST(WriteOutStrangerFeaturesTest, InSample) {
   stage.runSync();
 }
 
+TEST(WriteOutStrangerFeaturesTest, SampleStrangerFeatures) {
+  EXPECT_FALSE(sampleStrangerFeatures(0, 100000));
+  EXPECT_FALSE(sampleStrangerFeatures(0.1, 100015));
+  EXPECT_TRUE(sampleStrangerFeatures(0.2, 100015));
+  EXPECT_TRUE(sampleStrangerFeatures(1, 100099));
+}
+
 TEST(WriteOutStrangerFeaturesTest, SendMessage) {
   double sample_rate = 0.2;
   uint64_t start_time = 100015;
@@ -92,4 +102,41 @@ TEST(WriteOutStrangerFeaturesTest, SendMessage) {
 
   EXPECT_EQ(message, R"({"a":1,"b":2,"c":3,"d":4})");
 }
+
+TEST(WriteOutStrangerFeaturesTest, Batch) {
+  double sample_rate = 0.2;
+  uint64_t start_time = 100015;
+  std::vector<delivery::Insertion> insertions;
+  insertions.emplace_back().set_content_id("c");
+  FeatureContext context;
+  context.initialize(insertions);
+  context.processUserFeatures([](FeatureScope& scope) {
+    scope.stranger_feature_paths = {{"a", 1}};
+  });
+  context.processRequestFeatures([](FeatureScope& scope) {
+    scope.stranger_feature_paths = {{"b", 2}};
+  });
+  context.processInsertionFeatures(
+      "c", [](FeatureScope& scope, const FeatureScope&, const FeatureScope&) {
+        scope.stranger_feature_paths = {{"c", 3}};
+      });
+  auto batcher_client = std::make_unique<MockSqsClient>();
+  std::string message;
+  EXPECT_CALL(*batcher_client, sendMessage)
+      .WillOnce(testing::SaveArg<0>(&message));
+  StrangerFeatureBatcher batcher(
+      std::move(batcher_client),
+      [](const std::chrono::duration<double>&, std::function<void()>&&) {},
+      std::chrono::milliseconds(1'000), /*max_seen_paths=*/100,
+      /*seen_ttl_millis=*/1'000);
+  auto mock_client = std::make_unique<MockSqsClient>();
+  EXPECT_CALL(*mock_client, sendMessage).Times(0);
+  WriteOutStrangerFeaturesStage stage(0, sample_rate, start_time, context,
+                                      insertions, std::move(mock_client),
+                                      &batcher);
+  stage.runSync();
+  batcher.flush();
+
+  EXPECT_EQ(message, R"({"a":1,"b":2,"c":3})");
+}
 }  // namespace delivery
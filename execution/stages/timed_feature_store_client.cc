@@ -0,0 +1,42 @@
+#include "execution/stages/timed_feature_store_client.h"
+
+#include <cstdint>
+
+#include "utils/histogram.h"
+#include "utils/time.h"
+#include "utils/trace.h"
+
+namespace delivery {
+void TimedFeatureStoreClient::read(
+    const std::string& table, const std::string& key_column,
+    const std::string& key, const std::string& columns,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
+  client_->read(table, key_column, key, columns, timed(table, std::move(cb)));
+}
+
+void TimedFeatureStoreClient::readBatch(
+    const std::string& table, const std::string& key_column,
+    const std::vector<std::string>& keys, const std::string& columns,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
+  client_->readBatch(table, key_column, keys, columns,
+                     timed(table, std::move(cb)));
+}
+
+std::function<void(std::vector<FeatureStoreResult>)>
+TimedFeatureStoreClient::timed(
+    const std::string& table,
+    std::function<void(std::vector<FeatureStoreResult>)>&& cb) const {
+  // The histogram outlives this client, which may not outlive the read.
+  return [&histogram = histogram_, trace = trace_, table,
+          start = microsForDuration(),
+          cb = std::move(cb)](std::vector<FeatureStoreResult> results) {
+    const uint64_t end = microsForDuration();
+    histogram.record(end - start);
+    if (trace != nullptr) {
+      trace->addSpan("FeatureStore", "backend", start, end,
+                     {{"table", table}});
+    }
+    cb(std::move(results));
+  };
+}
+}  // namespace delivery
@@ -0,0 +1,49 @@
+// Records the latency of every read through another client, from the call to
+// the callback, in micros. Reads are also added as "backend" spans to the
+// request's trace, if it's sampled.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "execution/stages/feature_store_client.h"
+
+namespace delivery {
+class Histogram;
+class Trace;
+}  // namespace delivery
+
+namespace delivery {
+class TimedFeatureStoreClient : public FeatureStoreClient {
+ public:
+  TimedFeatureStoreClient(std::unique_ptr<const FeatureStoreClient> client,
+                          Histogram& histogram,
+                          std::shared_ptr<Trace> trace = nullptr)
+      : client_(std::move(client)),
+        histogram_(histogram),
+        trace_(std::move(trace)) {}
+
+  void read(const std::string& table, const std::string& key_column,
+            const std::string& key, const std::string& columns,
+            std::function<void(std::vector<FeatureStoreResult>)>&& cb)
+      const override;
+  void readBatch(const std::string& table, const std::string& key_column,
+                 const std::vector<std::string>& keys,
+                 const std::string& columns,
+                 std::function<void(std::vector<FeatureStoreResult>)>&& cb)
+      const override;
+
+ private:
+  std::function<void(std::vector<FeatureStoreResult>)> timed(
+      const std::string& table,
+      std::function<void(std::vector<FeatureStoreResult>)>&& cb) const;
+
+  std::unique_ptr<const FeatureStoreClient> client_;
+  Histogram& histogram_;
+  std::shared_ptr<Trace> trace_;
+};
+}  // namespace delivery
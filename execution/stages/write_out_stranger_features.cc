@@ -11,11 +11,28 @@
 #include "sqs_client.h"
 
 namespace delivery {
-void WriteOutStrangerFeaturesStage::runSync() {
+bool sampleStrangerFeatures(double sample_rate, uint64_t start_time) {
   // Assume the lowest bits of the request's starting time (in milliseconds) is
   // fair enough for sampling.
-  uint64_t max_remainder = static_cast<uint64_t>(sample_rate_ * 100);
-  if (max_remainder <= start_time_ % 100) {
+  uint64_t max_remainder = static_cast<uint64_t>(sample_rate * 100);
+  return start_time % 100 < max_remainder;
+}
+
+void WriteOutStrangerFeaturesStage::runSync() {
+  if (!sampleStrangerFeatures(sample_rate_, start_time_)) {
+    return;
+  }
+
+  if (batcher_ != nullptr) {
+    batcher_->add(feature_context_.getUserFeatures().stranger_feature_paths,
+                  start_time_);
+    batcher_->add(feature_context_.getRequestFeatures().stranger_feature_paths,
+                  start_time_);
+    for (const auto& insertion : insertions_) {
+      const auto& insertion_scope =
+          feature_context_.getInsertionFeatures(insertion.content_id());
+      batcher_->add(insertion_scope.stranger_feature_paths, start_time_);
+    }
     return;
   }
 
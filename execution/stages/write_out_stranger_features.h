@@ -13,6 +13,7 @@
 
 #include "execution/stages/sqs_client.h"
 #include "execution/stages/stage.h"
+#include "execution/stages/stranger_feature_batcher.h"
 
 namespace delivery {
 class FeatureContext;
@@ -20,19 +21,25 @@ class Insertion;
 }  // namespace delivery
 
 namespace delivery {
+// Whether a request's stranger features are written out. This is decided by
+// InitFeatures too, so that stages only build paths for sampled requests.
+bool sampleStrangerFeatures(double sample_rate, uint64_t start_time);
+
 class WriteOutStrangerFeaturesStage : public Stage {
  public:
   WriteOutStrangerFeaturesStage(
       size_t id, double sample_rate, uint64_t start_time,
       const FeatureContext& feature_context,
       const std::vector<delivery::Insertion>& insertions,
-      std::unique_ptr<SqsClient> sqs_client)
+      std::unique_ptr<SqsClient> sqs_client,
+      StrangerFeatureBatcher* batcher = nullptr)
       : Stage(id),
         sample_rate_(sample_rate),
         start_time_(start_time),
         feature_context_(feature_context),
         insertions_(insertions),
-        sqs_client_(std::move(sqs_client)) {}
+        sqs_client_(std::move(sqs_client)),
+        batcher_(batcher) {}
   std::string name() const override { return "WriteOutStrangerFeatures"; }
 
   void runSync() override;
@@ -43,5 +50,8 @@ class WriteOutStrangerFeaturesStage : public Stage {
   const FeatureContext& feature_context_;
   const std::vector<delivery::Insertion>& insertions_;
   std::unique_ptr<SqsClient> sqs_client_;
+  // If set, only paths which weren't reported recently are sent, through
+  // this instead of `sqs_client_`.
+  StrangerFeatureBatcher* batcher_;
 };
 }  // namespace delivery
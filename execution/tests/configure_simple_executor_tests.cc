@@ -85,7 +85,7 @@ TEST_F(ConfigureSimpleExecutorTest, ReadFromItemFeatureStore) {
   options_.content_features_cache_getter = [&]() -> FeaturesCache& {
     return cache;
   };
-  options_.feature_store_client_getter = []() {
+  options_.feature_store_client_getter = [](const FeatureStoreConfig&) {
     return std::make_unique<MockFeatureStoreClient>();
   };
   auto& executor = configureSimpleExecutor(std::move(context_), options_);
@@ -100,7 +100,7 @@ TEST_F(ConfigureSimpleExecutorTest, ReadFromItemFeatureStoreWithoutConfig) {
   options_.content_features_cache_getter = [&]() -> FeaturesCache& {
     return cache;
   };
-  options_.feature_store_client_getter = []() {
+  options_.feature_store_client_getter = [](const FeatureStoreConfig&) {
     return std::make_unique<MockFeatureStoreClient>();
   };
   auto& executor = configureSimpleExecutor(std::move(context_), options_);
@@ -117,7 +117,7 @@ TEST_F(ConfigureSimpleExecutorTest, ReadFromUserFeatureStore) {
   options_.non_content_features_cache_getter = [&]() -> FeaturesCache& {
     return cache;
   };
-  options_.feature_store_client_getter = []() {
+  options_.feature_store_client_getter = [](const FeatureStoreConfig&) {
     return std::make_unique<MockFeatureStoreClient>();
   };
   auto& executor = configureSimpleExecutor(std::move(context_), options_);
@@ -132,7 +132,7 @@ TEST_F(ConfigureSimpleExecutorTest, ReadFromUserFeatureStoreWithoutConfig) {
   options_.non_content_features_cache_getter = [&]() -> FeaturesCache& {
     return cache;
   };
-  options_.feature_store_client_getter = []() {
+  options_.feature_store_client_getter = [](const FeatureStoreConfig&) {
     return std::make_unique<MockFeatureStoreClient>();
   };
   auto& executor = configureSimpleExecutor(std::move(context_), options_);
@@ -318,6 +318,25 @@ TEST_F(ConfigureSimpleExecutorTest, WriteToMonitoring) {
   EXPECT_NE(executor, nullptr);
 }
 
+TEST_F(ConfigureSimpleExecutorTest, SkipWhenPreallocated) {
+  context_->platform_config.paging_config.num_preallocated_pages = 1;
+  auto& stages = context_->platform_config.execution_config.stages;
+  auto& paging_stage = stages.emplace_back();
+  paging_stage.id = 0;
+  paging_stage.type = "ReadFromPaging";
+  auto& request_stage = stages.emplace_back();
+  request_stage.id = 1;
+  request_stage.type = "ReadFromRequest";
+  request_stage.input_ids = {0};
+  options_.paging_read_redis_client_getter = []() {
+    return std::make_unique<MockRedisClient>();
+  };
+  auto& executor = configureSimpleExecutor(std::move(context_), options_);
+  ASSERT_NE(executor, nullptr);
+  EXPECT_EQ(executor->nodes()[0].skip_cb, nullptr);
+  EXPECT_NE(executor->nodes()[1].skip_cb, nullptr);
+}
+
 TEST_F(ConfigureSimpleExecutorTest, Unrecognized) {
   auto& stage =
       context_->platform_config.execution_config.stages.emplace_back();
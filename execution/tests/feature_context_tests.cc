@@ -8,6 +8,7 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/hash/hash.h"
+#include "execution/decoded_features.h"
 #include "execution/feature_context.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -157,6 +158,71 @@ TEST_F(FeatureContextTest, AddUserFeaturesProto) {
   EXPECT_THAT(scope.int_list_features.at(5), testing::ElementsAre(15, 115));
 }
 
+TEST(DecodedFeaturesTest, DecodeFeatures) {
+  delivery_private_features::Features features;
+  (*features.mutable_sparse())[3] = 13;
+  (*features.mutable_sparse())[1] = 11;
+  (*features.mutable_sparse())[2] = 12;
+  (*features.mutable_sparse_id())[5] = 15;
+  (*features.mutable_sparse_id())[4] = 14;
+  (*features.mutable_sparse_id_list())[6].add_ids(16);
+  (*features.mutable_sparse_id_list())[6].add_ids(116);
+
+  auto decoded = decodeFeatures(features);
+  EXPECT_THAT(decoded->sparse,
+              testing::ElementsAre(testing::Pair(1, 11), testing::Pair(2, 12),
+                                   testing::Pair(3, 13)));
+  EXPECT_THAT(decoded->sparse_id, testing::ElementsAre(testing::Pair(4, 14),
+                                                       testing::Pair(5, 15)));
+  ASSERT_EQ(decoded->sparse_id_list.size(), 1);
+  EXPECT_EQ(decoded->sparse_id_list[0].first, 6);
+  EXPECT_THAT(decoded->sparse_id_list[0].second,
+              testing::ElementsAre(16, 116));
+  EXPECT_FALSE(decoded->empty());
+  EXPECT_TRUE(decodeFeatures({})->empty());
+}
+
+TEST_F(FeatureContextTest, MergeInsertionFeatures) {
+  DecodedFeatures features;
+  features.sparse = {{0, 10}, {1, 11}};
+  features.sparse_id = {{2, 12}};
+  features.sparse_id_list = {{3, {13, 113}}};
+  context_.addInsertionFeatures(id_1_, {{1, 1}, {4, 14}});
+  context_.mergeInsertionFeatures(id_1_, features);
+
+  {
+    auto& scope = context_.getInsertionFeatures(id_1_);
+    EXPECT_THAT(scope.features,
+                testing::UnorderedElementsAre(testing::Pair(0, 10),
+                                              testing::Pair(1, 11),
+                                              testing::Pair(4, 14)));
+    EXPECT_THAT(scope.int_features,
+                testing::UnorderedElementsAre(testing::Pair(2, 12)));
+    ASSERT_TRUE(scope.int_list_features.contains(3));
+    EXPECT_THAT(scope.int_list_features.at(3), testing::ElementsAre(13, 113));
+  }
+  {
+    auto& scope = context_.getInsertionFeatures(id_2_);
+    EXPECT_TRUE(scope.features.empty());
+  }
+  // The shared features are left untouched.
+  EXPECT_EQ(features.sparse.size(), 2);
+}
+
+TEST_F(FeatureContextTest, MergeUserFeatures) {
+  DecodedFeatures features;
+  features.sparse = {{0, 10}};
+  features.sparse_id = {{1, 11}};
+  context_.mergeUserFeatures(features);
+
+  auto& scope = context_.getUserFeatures();
+  EXPECT_THAT(scope.features,
+              testing::UnorderedElementsAre(testing::Pair(0, 10)));
+  EXPECT_THAT(scope.int_features,
+              testing::UnorderedElementsAre(testing::Pair(1, 11)));
+  EXPECT_TRUE(scope.int_list_features.empty());
+}
+
 TEST_F(FeatureContextTest, AddStrangerInsertionFeatures) {
   absl::flat_hash_map<uint64_t, float> features;
   features[0] = 10;
@@ -214,6 +280,17 @@ TEST_F(FeatureContextTest, AddStrangerRequestFeatures) {
   EXPECT_EQ(scope.stranger_feature_paths.at("11"), 1);
 }
 
+TEST_F(FeatureContextTest, StrangerPathsNotRecorded) {
+  context_.initialize({}, /*record_stranger_paths=*/false);
+  EXPECT_FALSE(context_.recordsStrangerPaths());
+  context_.addStrangerRequestFeatures({{0, 10}}, {{"10", 0}});
+
+  auto& scope = context_.getRequestFeatures();
+  EXPECT_EQ(scope.features.size(), 1);
+  EXPECT_FALSE(scope.record_stranger_paths);
+  EXPECT_TRUE(scope.stranger_feature_paths.empty());
+}
+
 TEST_F(FeatureContextTest, AddStrangerUserFeatures) {
   absl::flat_hash_map<uint64_t, float> features;
   features[0] = 10;
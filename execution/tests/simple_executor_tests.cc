@@ -7,17 +7,23 @@
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "drogon/HttpAppFramework.h"
 #include "drogon/drogon_test.h"
+#include "execution/event_loop_probe.h"
 #include "execution/simple_executor.h"
 #include "execution/stages/stage.h"
+#include "json/json.h"
 #include "trantor/net/EventLoop.h"
+#include "utils/metrics.h"
+#include "utils/trace.h"
 
 using ::delivery::SimpleExecutor;
 using ::delivery::SimpleExecutorBuilder;
@@ -297,6 +303,144 @@ DROGON_TEST(SimpleExecutorTest) {
     });
     executor->execute();
   });
+
+  // Skipped stages don't run but still release their outputs.
+  tc.startTest();
+  app().getLoop()->queueInLoop([TEST_CTX] {
+    auto context = std::make_shared<TestContext>();
+    SimpleExecutorBuilder builder;
+    builder.addStage(std::make_unique<TestStage>(
+                         /*stage_id=*/0, *context,
+                         [TEST_CTX](TestContext& context) {
+                           CHECK(context.stages_ran == 0);
+                         }),
+                     /*input_ids=*/{});
+    builder.addStage(std::make_unique<TestStage>(
+                         /*stage_id=*/1, *context,
+                         [TEST_CTX](TestContext& context) { CHECK(false); }),
+                     /*input_ids=*/{0});
+    builder.skipIf(/*stage_id=*/1, /*decided_by_id=*/0,
+                   [context = context.get()]() {
+                     return context->stages_ran == 1;
+                   });
+    builder.addStage(std::make_unique<TestStage>(
+                         /*stage_id=*/2, *context,
+                         [TEST_CTX](TestContext& context) {
+                           CHECK(context.stages_ran == 1);
+                         }),
+                     /*input_ids=*/{1});
+    auto& executor = context->executor;
+    executor = builder.build([context]() mutable {
+      context.reset();
+      tc.finishTest();
+    });
+    executor->execute();
+  });
+
+  // Stage durations and queue delays are recorded, except for skipped stages
+  // and the final stage.
+  tc.startTest();
+  app().getLoop()->queueInLoop([TEST_CTX] {
+    auto context = std::make_shared<TestContext>();
+    auto metrics = std::make_shared<delivery::MetricsRegistry>();
+    delivery::StageMetrics stage_metrics(*metrics);
+    SimpleExecutorBuilder builder;
+    builder.recordMetrics(stage_metrics);
+    builder.addStage(std::make_unique<TestStage>(
+                         /*stage_id=*/0, *context, [](TestContext&) {}),
+                     /*input_ids=*/{});
+    builder.addStage(std::make_unique<TestTimeoutStage>(
+                         /*stage_id=*/1, *context, [](TestContext&) {}),
+                     /*input_ids=*/{0});
+    builder.addStage(std::make_unique<TestStage>(
+                         /*stage_id=*/2, *context,
+                         [TEST_CTX](TestContext& context) { CHECK(false); }),
+                     /*input_ids=*/{1});
+    builder.skipIf(/*stage_id=*/2, /*decided_by_id=*/1,
+                   []() { return true; });
+    builder.addStage(std::make_unique<TestStage>(
+                         /*stage_id=*/3, *context, [](TestContext&) {}),
+                     /*input_ids=*/{2});
+    auto& executor = context->executor;
+    executor = builder.build([TEST_CTX, context, metrics]() mutable {
+      auto& durations = metrics->histogram("delivery_stage_duration_micros",
+                                           {{"stage", "Test"}});
+      auto& queue_delays = metrics->histogram(
+          "delivery_stage_queue_delay_micros", {{"stage", "Test"}});
+      auto& timeout_durations = metrics->histogram(
+          "delivery_stage_duration_micros", {{"stage", "TestTimeout"}});
+      CHECK(durations.count() == 1);
+      CHECK(queue_delays.count() == 3);
+      CHECK(timeout_durations.count() == 1);
+      // It waits for a timeout of 1ms.
+      CHECK(timeout_durations.sum() >= 1'000);
+      context.reset();
+      tc.finishTest();
+    });
+    executor->execute();
+  });
+
+  tc.startTest();
+  app().getLoop()->queueInLoop([TEST_CTX] {
+    auto context = std::make_shared<TestContext>();
+    auto trace = std::make_shared<delivery::Trace>("request");
+    SimpleExecutorBuilder builder;
+    builder.recordTrace(trace);
+    builder.addStage(std::make_unique<TestStage>(
+                         /*stage_id=*/0, *context, [](TestContext&) {}),
+                     /*input_ids=*/{});
+    builder.addStage(std::make_unique<TestTimeoutStage>(
+                         /*stage_id=*/1, *context, [](TestContext&) {}),
+                     /*input_ids=*/{0});
+    builder.addStage(std::make_unique<TestStage>(
+                         /*stage_id=*/2, *context, [](TestContext&) {}),
+                     /*input_ids=*/{1});
+    builder.skipIf(/*stage_id=*/2, /*decided_by_id=*/1,
+                   []() { return true; });
+    auto& executor = context->executor;
+    executor = builder.build([TEST_CTX, context, trace]() mutable {
+      Json::Value events(Json::arrayValue);
+      trace->appendEvents(events, /*pid=*/1);
+      std::map<std::string, std::vector<std::string>> spans;
+      for (const auto& event : events) {
+        if (event["ph"] == "X") {
+          spans[event["cat"].asString()].emplace_back(
+              event["name"].asString());
+        }
+      }
+      CHECK(spans["queue"] ==
+            std::vector<std::string>{"Test", "TestTimeout", "Test"});
+      // The skipped stage doesn't run.
+      CHECK(spans["run"] == std::vector<std::string>{"Test", "TestTimeout"});
+      CHECK(spans["async"] == std::vector<std::string>{"TestTimeout"});
+      context.reset();
+      tc.finishTest();
+    });
+    executor->execute();
+  });
+
+  // The probe measures the loop it runs on. It keeps probing until the loop
+  // quits, so it and its metrics outlive the test.
+  tc.startTest();
+  app().getLoop()->queueInLoop([TEST_CTX] {
+    static delivery::MetricsRegistry metrics;
+    static delivery::EventLoopProbe probe(*app().getLoop(), 0,
+                                          std::chrono::milliseconds(1),
+                                          metrics);
+    probe.start();
+    app().getLoop()->runAfter(std::chrono::milliseconds(50), [TEST_CTX]() {
+      CHECK(metrics.histogram("delivery_event_loop_lag_micros",
+                              {{"loop", "0"}})
+                .count() > 0);
+      CHECK(metrics.histogram("delivery_event_loop_queue_wait_micros",
+                              {{"loop", "0"}})
+                .count() > 0);
+      CHECK(metrics.histogram("delivery_event_loop_queued_stages",
+                              {{"loop", "0"}})
+                .count() > 0);
+      tc.finishTest();
+    });
+  });
 }
 
 int main(int argc, char** argv) {
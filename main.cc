@@ -1,19 +1,30 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <chrono>
+#include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "cloud/cloudwatch_monitoring_client.h"
 #include "config/platform_config.h"
 #include "drogon/HttpAppFramework.h"
 #include "drogon/HttpResponse.h"
+#include "execution/event_loop_probe.h"
+#include "singletons/aws.h"
 #include "singletons/cache.h"
 #include "singletons/config.h"
 #include "singletons/counters.h"
 #include "singletons/env.h"
+#include "singletons/feature.h"
+#include "singletons/feature_store.h"
+#include "singletons/metrics.h"
 #include "singletons/paging.h"
 #include "singletons/user_agent.h"
+#include "trantor/net/EventLoop.h"
 #include "trantor/utils/LogStream.h"
 #include "trantor/utils/Logger.h"
 
@@ -45,18 +56,93 @@ int main() {
   // We consider caches a requirement because of how slow these stages may be
   // otherwise.
   delivery::CacheSingleton::getInstance().initializeFeaturesCaches(
-      platform_config.feature_store_content_cache_size);
+      platform_config);
+  // Without a snapshot, content features are only read from feature store.
+  if (!platform_config.feature_store_content_snapshot_path.empty()) {
+    delivery::CacheSingleton::getInstance().loadContentFeaturesSnapshot(
+        platform_config.feature_store_content_snapshot_path);
+  }
+  // Warm the caches from the last instance's dump so that a restart doesn't
+  // send every request's keys to feature store.
+  const std::string& cache_dump_dir =
+      platform_config.feature_store_cache_dump_dir;
+  if (!cache_dump_dir.empty()) {
+    delivery::CacheSingleton::getInstance().warmFeaturesCaches(
+        cache_dump_dir, platform_config.feature_store_cache_warmup_ttl_millis);
+  }
   // The CountersSingleton constructor will abort if it can't initialize.
   delivery::counters::CountersSingleton::getInstance();
+  // The FeatureStoreSingleton constructor will abort if it can't initialize.
+  delivery::FeatureStoreSingleton::getInstance();
   // The PagingSingleton constructor will abort if it can't initialize.
   delivery::PagingSingleton::getInstance();
   // This can take several seconds so just do it now instead of on the first
   // request.
   delivery::UserAgentSingleton::getInstance();
+  delivery::FeatureSingleton::getInstance();
+
+  const size_t cache_dump_max_keys =
+      platform_config.feature_store_cache_dump_max_keys;
+  if (!cache_dump_dir.empty() &&
+      platform_config.feature_store_cache_dump_interval_millis > 0) {
+    // Requests are handled by the IO loops, so dumping on the main loop only
+    // delays accepting connections.
+    drogon::app().getLoop()->runEvery(
+        static_cast<double>(
+            platform_config.feature_store_cache_dump_interval_millis) /
+            1'000,
+        [&cache_dump_dir, cache_dump_max_keys]() {
+          delivery::CacheSingleton::getInstance().dumpFeaturesCaches(
+              cache_dump_dir, cache_dump_max_keys);
+        });
+  }
+
+  // Requests only aggregate monitoring data, so it's written out from here.
+  delivery::CloudwatchMonitoringClient monitoring_client(
+      delivery::AwsSingleton::getInstance().getCloudwatchClient(
+          platform_config.region),
+      platform_config.name);
+  drogon::app().getLoop()->runEvery(
+      static_cast<double>(
+          delivery::CloudwatchMonitoringClient::batch_period_millis) /
+          1'000,
+      [&monitoring_client]() { monitoring_client.flush(); });
+
+  // The IO loops, which handle requests, only exist once the app is running.
+  std::vector<std::unique_ptr<delivery::EventLoopProbe>> event_loop_probes;
+  if (platform_config.event_loop_probe_interval_millis > 0) {
+    const std::chrono::milliseconds interval(
+        platform_config.event_loop_probe_interval_millis);
+    drogon::app().registerBeginningAdvice([&event_loop_probes, interval]() {
+      for (size_t i = 0; i < drogon::app().getThreadNum(); ++i) {
+        auto& probe = event_loop_probes.emplace_back(
+            std::make_unique<delivery::EventLoopProbe>(
+                *drogon::app().getIOLoop(i), i, interval,
+                delivery::MetricsSingleton::getInstance().getRegistry()));
+        probe->start();
+      }
+    });
+  }
 
   LOG_INFO << "Starting to listen on port " << port;
   drogon::app().run();
   LOG_INFO << "Stopping listening";
 
+  // The AWS SDK shuts down once main returns, so don't leave this in flight.
+  monitoring_client.flushAndWait();
+
+  // Stranger features queued since the last batch would otherwise be lost.
+  // Waiting keeps the AWS SDK from shutting down before they're sent.
+  auto* stranger_feature_batcher =
+      delivery::FeatureSingleton::getInstance().getStrangerFeatureBatcher();
+  if (stranger_feature_batcher != nullptr) {
+    stranger_feature_batcher->flushAndWait();
+  }
+
+  if (!cache_dump_dir.empty()) {
+    delivery::CacheSingleton::getInstance().dumpFeaturesCaches(
+        cache_dump_dir, cache_dump_max_keys);
+  }
+
   return 0;
 }
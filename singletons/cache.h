@@ -3,60 +3,207 @@
 
 #pragma once
 
+#include <stddef.h>
+
+#include <cstdint>
+#include <cstdlib>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/strings/str_cat.h"
+#include "config/counters_config.h"
+#include "config/platform_config.h"
+#include "execution/simple_executor.h"
 #include "execution/stages/cache.h"
+#include "execution/stages/cache_persistence.h"
 #include "execution/stages/counters.h"
+#include "execution/stages/feature_snapshot.h"
+#include "execution/stages/negative_cache.h"
+#include "execution/stages/redis_features_cache.h"
+#include "execution/stages/shared_features_cache.h"
 #include "singletons/singleton.h"
+#include "trantor/utils/LogStream.h"
+#include "trantor/utils/Logger.h"
+#include "utils/time.h"
 
 namespace delivery {
 
 class CacheSingleton : public Singleton<CacheSingleton> {
  public:
-  void initializeFeaturesCaches(size_t feature_store_content_cache_size) {
-    content_features_cache_ =
-        std::make_unique<FeaturesCache>(feature_store_content_cache_size);
-    non_content_features_cache_ =
-        std::make_unique<FeaturesCache>(/*maxSize=*/10'000);
+  // If the admission policy is invalid, this aborts.
+  void initializeFeaturesCaches(const PlatformConfig& config) {
+    content_features_cache_ = std::make_unique<FeaturesCache>(
+        config.feature_store_content_cache_size, /*num_shards=*/0,
+        makeCacheAdmission(config.feature_store_content_cache_admission),
+        config.feature_store_content_cache_max_bytes, cachedFeaturesBytes);
+    non_content_features_cache_ = std::make_unique<FeaturesCache>(
+        config.feature_store_non_content_cache_size, /*num_shards=*/0,
+        CacheAdmission::lru, config.feature_store_non_content_cache_max_bytes,
+        cachedFeaturesBytes);
+    // Read stages use the first feature store of each type.
+    for (const auto& feature_store_config : config.feature_store_configs) {
+      if (feature_store_config.type == item_feature_store_type &&
+          content_features_table_.empty()) {
+        content_features_table_ = feature_store_config.table;
+      } else if (feature_store_config.type == user_feature_store_type &&
+                 non_content_features_table_.empty()) {
+        non_content_features_table_ = feature_store_config.table;
+      }
+    }
+    if (config.feature_store_content_negative_cache_size > 0) {
+      content_negative_cache_ = std::make_unique<NegativeCache>(
+          config.feature_store_content_negative_cache_size);
+    }
+    if (config.feature_store_non_content_negative_cache_size > 0) {
+      non_content_negative_cache_ = std::make_unique<NegativeCache>(
+          config.feature_store_non_content_negative_cache_size);
+    }
+    // Without the shared cache, each process just caches on its own.
+    if (!config.feature_store_shared_cache_name.empty()) {
+      std::string error;
+      shared_content_features_cache_ = SharedFeaturesCache::open(
+          config.feature_store_shared_cache_name,
+          config.feature_store_shared_cache_size,
+          config.feature_store_shared_cache_slot_bytes, error);
+      if (shared_content_features_cache_ == nullptr) {
+        LOG_ERROR << error;
+      }
+    }
   }
 
-  void addCountersCaches(const std::string& name, int64_t global_rates_size,
-                         int64_t item_counts_size, int64_t user_counts_size,
-                         int64_t query_counts_size,
-                         int64_t item_query_counts_size) {
+  void addCountersCaches(const std::string& name,
+                         const CountersCacheConfig& config) {
     counters::Caches cache;
 
+    int64_t global_rates_size = config.global_rates_size;
     if (global_rates_size == 0) {
       global_rates_size = default_global_rate_cache_size_;
     }
-    cache.global_counts_cache =
-        std::make_unique<counters::Cache>(global_rates_size);
+    cache.global_counts_cache = std::make_unique<counters::Cache>(
+        global_rates_size, /*num_shards=*/0,
+        makeCacheAdmission(config.global_rates_admission),
+        config.global_rates_max_bytes, counters::cachedCountsBytes);
+    cache.global_counts_ttl =
+        makeCacheTtl(config.global_rates_ttl_millis, config.ttl_jitter);
+    int64_t item_counts_size = config.item_counts_size;
     if (item_counts_size == 0) {
       item_counts_size = default_cache_size_;
     }
-    cache.item_counts_cache =
-        std::make_unique<counters::Cache>(item_counts_size);
+    cache.item_counts_cache = std::make_unique<counters::Cache>(
+        item_counts_size, /*num_shards=*/0,
+        makeCacheAdmission(config.item_counts_admission),
+        config.item_counts_max_bytes, counters::cachedCountsBytes);
+    cache.item_counts_ttl =
+        makeCacheTtl(config.item_counts_ttl_millis, config.ttl_jitter);
+    int64_t user_counts_size = config.user_counts_size;
     if (user_counts_size == 0) {
       user_counts_size = default_cache_size_;
     }
-    cache.user_counts_cache =
-        std::make_unique<counters::Cache>(user_counts_size);
+    cache.user_counts_cache = std::make_unique<counters::Cache>(
+        user_counts_size, /*num_shards=*/0,
+        makeCacheAdmission(config.user_counts_admission),
+        config.user_counts_max_bytes, counters::cachedCountsBytes);
+    cache.user_counts_ttl =
+        makeCacheTtl(config.user_counts_ttl_millis, config.ttl_jitter);
+    int64_t query_counts_size = config.query_counts_size;
     if (query_counts_size == 0) {
       query_counts_size = default_cache_size_;
     }
-    cache.query_counts_cache =
-        std::make_unique<counters::Cache>(query_counts_size);
+    cache.query_counts_cache = std::make_unique<counters::Cache>(
+        query_counts_size, /*num_shards=*/0,
+        makeCacheAdmission(config.query_counts_admission),
+        config.query_counts_max_bytes, counters::cachedCountsBytes);
+    cache.query_counts_ttl =
+        makeCacheTtl(config.query_counts_ttl_millis, config.ttl_jitter);
+    int64_t item_query_counts_size = config.item_query_counts_size;
     if (item_query_counts_size == 0) {
       item_query_counts_size = default_cache_size_;
     }
-    cache.item_query_counts_cache =
-        std::make_unique<counters::Cache>(item_query_counts_size);
+    cache.item_query_counts_cache = std::make_unique<counters::Cache>(
+        item_query_counts_size, /*num_shards=*/0,
+        makeCacheAdmission(config.item_query_counts_admission),
+        config.item_query_counts_max_bytes, counters::cachedCountsBytes);
+    cache.item_query_counts_ttl =
+        makeCacheTtl(config.item_query_counts_ttl_millis, config.ttl_jitter);
 
     name_to_counters_caches_[name] = std::move(cache);
   }
 
+  // Atomically replaces the content features snapshot. Requests already using
+  // the previous snapshot keep it until they finish.
+  bool loadContentFeaturesSnapshot(const std::string& path) {
+    std::string error;
+    auto snapshot = FeatureSnapshot::open(path, error);
+    if (snapshot == nullptr) {
+      LOG_ERROR << error;
+      return false;
+    }
+    LOG_INFO << "Loaded content features snapshot " << path << " with "
+             << snapshot->size() << " keys";
+    std::atomic_store(&content_features_snapshot_, std::move(snapshot));
+    return true;
+  }
+
+  // Writes the hottest entries of the features caches to `dir`.
+  void dumpFeaturesCaches(const std::string& dir, size_t max_keys) {
+    uint64_t now = millisSinceEpoch();
+    for (const auto& [name, cache] : featuresCaches()) {
+      std::string path = featuresCacheDumpPath(dir, name);
+      size_t num_dumped = 0;
+      std::string error;
+      if (!dumpFeaturesCache(*cache, path, max_keys, now, num_dumped,
+                             error)) {
+        LOG_ERROR << error;
+        continue;
+      }
+      LOG_INFO << "Dumped " << num_dumped << " " << name << " keys to "
+               << path;
+    }
+  }
+
+  // Inserts the entries dumped to `dir` into the features caches. This is
+  // done before listening so that the first requests aren't all misses.
+  void warmFeaturesCaches(const std::string& dir, uint64_t ttl_millis) {
+    uint64_t now = millisSinceEpoch();
+    for (const auto& [name, cache] : featuresCaches()) {
+      std::string path = featuresCacheDumpPath(dir, name);
+      size_t num_warmed = 0;
+      std::string error;
+      // Spread the warmed entries' expiry over a second TTL.
+      if (!warmFeaturesCache(*cache, path, now, ttl_millis, /*jitter=*/1,
+                             num_warmed, error)) {
+        LOG_ERROR << error;
+        continue;
+      }
+      LOG_INFO << "Warmed " << name << " cache with " << num_warmed
+               << " keys from " << path;
+    }
+  }
+
   FeaturesCache& contentFeaturesCache() { return *content_features_cache_; }
 
+  // May be null.
+  std::shared_ptr<const FeatureSnapshot> contentFeaturesSnapshot() {
+    return std::atomic_load(&content_features_snapshot_);
+  }
+
+  // May be null.
+  NegativeCache* contentNegativeCache() {
+    return content_negative_cache_.get();
+  }
+
+  // May be null.
+  NegativeCache* nonContentNegativeCache() {
+    return non_content_negative_cache_.get();
+  }
+
+  // May be null.
+  std::shared_ptr<SharedFeaturesCache> sharedContentFeaturesCache() {
+    return shared_content_features_cache_;
+  }
+
   FeaturesCache& nonContentFeaturesCache() {
     return *non_content_features_cache_;
   }
@@ -65,11 +212,142 @@ class CacheSingleton : public Singleton<CacheSingleton> {
     return name_to_counters_caches_[name];
   }
 
+  // The current size of every cache, by name.
+  std::vector<std::pair<std::string, CacheStats>> stats() {
+    std::vector<std::pair<std::string, CacheStats>> stats;
+    for (const auto& [name, cache] : featuresCaches()) {
+      stats.emplace_back(name, cache->stats());
+    }
+    if (content_negative_cache_ != nullptr) {
+      stats.emplace_back("contentNegative", content_negative_cache_->stats());
+    }
+    if (non_content_negative_cache_ != nullptr) {
+      stats.emplace_back("nonContentNegative",
+                         non_content_negative_cache_->stats());
+    }
+    if (shared_content_features_cache_ != nullptr) {
+      stats.emplace_back("sharedContentFeatures",
+                         shared_content_features_cache_->stats());
+    }
+    for (const auto& [name, cache] : namedCountersCaches()) {
+      stats.emplace_back(name, cache->stats());
+    }
+    return stats;
+  }
+
+  // Erases `keys` from the cache named as in stats(). Features are also
+  // erased from the negative, shared, and Redis (`l2_cache`, if given) caches
+  // in front of the same feature store, so the next read goes to feature
+  // store. Counts are erased for every segment of the keys. Returns false if
+  // there's no such cache.
+  bool invalidate(const std::string& name,
+                  const std::vector<std::string>& keys, size_t& num_erased,
+                  RedisFeaturesCache* l2_cache = nullptr) {
+    num_erased = 0;
+    for (const auto& [features_name, cache] : featuresCaches()) {
+      if (features_name != name) {
+        continue;
+      }
+      NegativeCache* negative_cache = name == "contentFeatures"
+                                          ? content_negative_cache_.get()
+                                          : non_content_negative_cache_.get();
+      SharedFeaturesCache* shared_cache =
+          name == "contentFeatures" ? shared_content_features_cache_.get()
+                                    : nullptr;
+      for (const auto& key : keys) {
+        CacheKey cache_key(key);
+        num_erased += cache->erase(cache_key);
+        if (negative_cache != nullptr) {
+          negative_cache->erase(cache_key);
+        }
+        if (shared_cache != nullptr) {
+          shared_cache->erase(key);
+        }
+      }
+      const std::string& table = name == "contentFeatures"
+                                     ? content_features_table_
+                                     : non_content_features_table_;
+      if (l2_cache != nullptr && !table.empty()) {
+        l2_cache->erase(table, keys);
+      }
+      return true;
+    }
+    for (const auto& [counters_name, cache] : namedCountersCaches()) {
+      if (counters_name != name) {
+        continue;
+      }
+      // Segmented tables cache each segment under the key followed by the
+      // segment, and segments aren't known up front. Other keys which happen to
+      // start with the key are erased too, which only costs a miss.
+      for (const auto& key : keys) {
+        num_erased += cache->erasePrefix(key);
+      }
+      return true;
+    }
+    return false;
+  }
+
  private:
   friend class Singleton;
 
   CacheSingleton() = default;
 
+  CacheAdmission makeCacheAdmission(const std::string& admission) {
+    if (admission.empty() || admission == lru_cache_admission) {
+      return CacheAdmission::lru;
+    }
+    if (admission == tiny_lfu_cache_admission) {
+      return CacheAdmission::tiny_lfu;
+    }
+    LOG_FATAL << "Invalid cache admission policy: " << admission;
+    abort();
+  }
+
+  std::vector<std::pair<std::string, FeaturesCache*>> featuresCaches() {
+    std::vector<std::pair<std::string, FeaturesCache*>> caches;
+    if (content_features_cache_ != nullptr) {
+      caches.emplace_back("contentFeatures", content_features_cache_.get());
+    }
+    if (non_content_features_cache_ != nullptr) {
+      caches.emplace_back("nonContentFeatures",
+                          non_content_features_cache_.get());
+    }
+    return caches;
+  }
+
+  std::vector<std::pair<std::string, counters::Cache*>> namedCountersCaches() {
+    std::vector<std::pair<std::string, counters::Cache*>> named_caches;
+    for (const auto& [name, caches] : name_to_counters_caches_) {
+      for (const auto& [table, cache] :
+           {std::make_pair("globalRates", caches.global_counts_cache.get()),
+            std::make_pair("itemCounts", caches.item_counts_cache.get()),
+            std::make_pair("userCounts", caches.user_counts_cache.get()),
+            std::make_pair("queryCounts", caches.query_counts_cache.get()),
+            std::make_pair("itemQueryCounts",
+                           caches.item_query_counts_cache.get())}) {
+        if (cache != nullptr) {
+          named_caches.emplace_back(
+              absl::StrCat("counters.", name, ".", table), cache);
+        }
+      }
+    }
+    return named_caches;
+  }
+
+  std::string featuresCacheDumpPath(const std::string& dir,
+                                    const std::string& name) {
+    return absl::StrCat(dir, "/", name, ".snapshot");
+  }
+
+  counters::CacheTtl makeCacheTtl(int64_t ttl_millis, double jitter) {
+    counters::CacheTtl ttl;
+    if (ttl_millis > 0) {
+      ttl.millis = ttl_millis;
+    }
+    ttl.jitter = jitter;
+    return ttl;
+  }
+
   // This is the default maximum size of cache holding global rates.
   const int64_t default_global_rate_cache_size_ = 100;
   // This is the default size of the item, query, and user count caches.
@@ -77,6 +355,14 @@ class CacheSingleton : public Singleton<CacheSingleton> {
 
   std::unique_ptr<FeaturesCache> content_features_cache_;
   std::unique_ptr<FeaturesCache> non_content_features_cache_;
+  std::unique_ptr<NegativeCache> content_negative_cache_;
+  std::unique_ptr<NegativeCache> non_content_negative_cache_;
+  std::shared_ptr<const FeatureSnapshot> content_features_snapshot_;
+  std::shared_ptr<SharedFeaturesCache> shared_content_features_cache_;
+  // Feature store tables the features caches are in front of, which key their
+  // entries in Redis.
+  std::string content_features_table_;
+  std::string non_content_features_table_;
 
   absl::flat_hash_map<std::string, counters::Caches> name_to_counters_caches_;
 };
@@ -129,11 +129,7 @@ CountersSingleton::CountersSingleton() {
       abort();
     }
 
-    const auto& cache_config = config.cache_config;
-    CacheSingleton::getInstance().addCountersCaches(
-        name, cache_config.global_rates_size, cache_config.item_counts_size,
-        cache_config.user_counts_size, cache_config.query_counts_size,
-        cache_config.item_query_counts_size);
+    CacheSingleton::getInstance().addCountersCaches(name, config.cache_config);
 
     platform_to_name_to_database_[platform_config.platform_id][name] =
         std::move(database_info);
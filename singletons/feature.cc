@@ -1,10 +1,21 @@
 #include "singletons/feature.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <functional>
+#include <memory>
+#include <utility>
 #include <vector>
 
+#include "cloud/aws_sqs_client.h"
+#include "config/feature_config.h"
+#include "config/platform_config.h"
+#include "drogon/HttpAppFramework.h"
 #include "execution/stages/compute_time_features.h"
+#include "singletons/aws.h"
+#include "singletons/config.h"
+#include "trantor/net/EventLoop.h"
 #include "utils/math.h"
 
 namespace delivery {
@@ -15,6 +26,24 @@ const double month_of_year_periodic_factor = 2 * pi / 12;
 
 FeatureSingleton::FeatureSingleton() {
   periodic_time_values_ = createPeriodicTimeValues();
+
+  auto platform_config =
+      delivery::ConfigSingleton::getInstance().getPlatformConfig();
+  const auto& config = platform_config.sparse_features_config;
+  const auto& queue_name = config.stranger_feature_queue_config.queue_name;
+  if (config.stranger_feature_batch_window_millis > 0 && !queue_name.empty()) {
+    stranger_feature_batcher_ = std::make_unique<StrangerFeatureBatcher>(
+        std::make_unique<AwsSqsClient>(
+            AwsSingleton::getInstance().getSqsClientAndUrl(
+                platform_config.region, queue_name)),
+        [](const std::chrono::duration<double>& delay,
+           std::function<void()>&& cb) {
+          drogon::app().getLoop()->runAfter(delay, std::move(cb));
+        },
+        std::chrono::milliseconds(config.stranger_feature_batch_window_millis),
+        config.stranger_feature_dedupe_size,
+        config.stranger_feature_dedupe_ttl_millis);
+  }
 }
 
 PeriodicTimeValues FeatureSingleton::createPeriodicTimeValues() {
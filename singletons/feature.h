@@ -5,7 +5,10 @@
 
 #include <gtest/gtest_prod.h>
 
+#include <memory>
+
 #include "execution/stages/compute_time_features.h"
+#include "execution/stages/stranger_feature_batcher.h"
 #include "singletons/singleton.h"
 
 namespace delivery {
@@ -15,6 +18,11 @@ class FeatureSingleton : public Singleton<FeatureSingleton> {
     return periodic_time_values_;
   }
 
+  // Returns null if stranger features aren't batched.
+  StrangerFeatureBatcher* getStrangerFeatureBatcher() {
+    return stranger_feature_batcher_.get();
+  }
+
  private:
   friend class Singleton;
   FRIEND_TEST(FeatureSingletonTest, CreatePeriodicTimeValues);
@@ -24,5 +32,6 @@ class FeatureSingleton : public Singleton<FeatureSingleton> {
   static PeriodicTimeValues createPeriodicTimeValues();
 
   PeriodicTimeValues periodic_time_values_;
+  std::unique_ptr<StrangerFeatureBatcher> stranger_feature_batcher_;
 };
 }  // namespace delivery
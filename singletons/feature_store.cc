@@ -0,0 +1,182 @@
+#include "singletons/feature_store.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "cloud/dynamodb_feature_store_reader.h"
+#include "cloud/sw_redis_client.h"
+#include "config/feature_store_config.h"
+#include "config/platform_config.h"
+#include "drogon/HttpAppFramework.h"
+#include "execution/stages/batching_feature_store_client.h"
+#include "execution/stages/feature_compression.h"
+#include "execution/stages/read_from_feature_store.h"
+#include "execution/stages/redis_feature_store_client.h"
+#include "execution/stages/redis_features_cache.h"
+#include "singletons/aws.h"
+#include "singletons/config.h"
+#include "trantor/net/EventLoop.h"
+#include "trantor/utils/LogStream.h"
+#include "trantor/utils/Logger.h"
+#include "utils/network.h"
+#include "utils/time.h"
+
+namespace delivery {
+FeatureStoreSingleton::FeatureStoreSingleton() {
+  auto platform_config =
+      delivery::ConfigSingleton::getInstance().getPlatformConfig();
+  for (const auto& config : platform_config.feature_store_configs) {
+    if (config.backend == redis_feature_store_backend) {
+      if (!url_to_clients_.contains(config.redis_url)) {
+        createClients(config.redis_url, config.redis_timeout);
+      }
+    } else if (config.batch_window_micros > 0) {
+      createBatcher(config, platform_config.region,
+                    platform_config.feature_store_timeout);
+    }
+    if (!config.compression.empty()) {
+      createDecompressor(config);
+    }
+  }
+  l2_cache_url_ = platform_config.feature_store_l2_cache_redis_url;
+  if (!l2_cache_url_.empty() && !url_to_clients_.contains(l2_cache_url_)) {
+    createClients(l2_cache_url_,
+                  platform_config.feature_store_l2_cache_redis_timeout);
+  }
+}
+
+FeatureStoreSingleton::~FeatureStoreSingleton() = default;
+
+void FeatureStoreSingleton::createClients(const std::string& url,
+                                          const std::string& timeout) {
+  auto structured_url = parseRedisUrl(url);
+  if (!structured_url.successful_parse) {
+    LOG_FATAL << "Invalid feature store URL: " << url;
+    abort();
+  }
+  const int port = std::atoi(structured_url.port.c_str());
+  if (port == 0) {
+    LOG_FATAL << "Invalid feature store port: " << structured_url.port;
+    abort();
+  }
+  const int database_number = std::atoi(structured_url.database_number.c_str());
+  if (database_number == 0 && structured_url.database_number != "0") {
+    LOG_FATAL << "Invalid feature store database number: "
+              << structured_url.database_number;
+    abort();
+  }
+  int timeout_millis = -1.0;
+  try {
+    timeout_millis = std::stoi(timeout);
+  } catch (const std::exception&) {
+    LOG_FATAL << "Invalid timeout: " << timeout;
+    abort();
+  }
+
+  RedisClientArray client_array(structured_url.hostname, port, database_number,
+                                timeout_millis);
+  url_to_clients_.emplace(url, std::move(client_array));
+}
+
+void FeatureStoreSingleton::createBatcher(
+    const FeatureStoreConfig& config, const std::string& region,
+    const std::string& feature_store_timeout) {
+  if (config.max_batch_keys == 0) {
+    LOG_FATAL << "Invalid max batch keys for feature store " << config.table;
+    abort();
+  }
+  // Falls back to the same default as the stages reading through the batcher.
+  bool valid_timeout = false;
+  const uint64_t timeout_millis =
+      parseFeatureStoreTimeout(feature_store_timeout, &valid_timeout);
+  if (!valid_timeout) {
+    LOG_ERROR << "Invalid feature store timeout specified: "
+              << feature_store_timeout << ". Defaulting to " << timeout_millis
+              << "ms.";
+  }
+
+  // Batches aren't tied to any one request, so retries of unprocessed keys
+  // are bounded by the feature store timeout from when the batch is sent.
+  auto client_factory = [region, timeout_millis]() {
+    return std::make_unique<const DynamoDBFeatureStoreClient>(
+        AwsSingleton::getInstance().getDynamoDBClient(region),
+        millisSinceEpoch() + timeout_millis, drogon::app().getLoop());
+  };
+  auto scheduler = [](const std::chrono::duration<double>& delay,
+                      std::function<void()>&& cb) {
+    drogon::app().getLoop()->runAfter(delay, std::move(cb));
+  };
+  table_to_batcher_.emplace(
+      config.table,
+      std::make_unique<FeatureStoreBatcher>(
+          std::move(client_factory), std::move(scheduler),
+          std::chrono::microseconds(config.batch_window_micros),
+          config.max_batch_keys));
+}
+
+void FeatureStoreSingleton::createDecompressor(
+    const FeatureStoreConfig& config) {
+  if (config.compression != zstd_feature_compression) {
+    LOG_FATAL << "Invalid compression for feature store " << config.table
+              << ": " << config.compression;
+    abort();
+  }
+  std::string error;
+  auto decompressor =
+      config.compression_dictionary_path.empty()
+          ? FeatureDecompressor::create("", error)
+          : FeatureDecompressor::load(config.compression_dictionary_path,
+                                      error);
+  if (decompressor == nullptr) {
+    LOG_FATAL << error;
+    abort();
+  }
+  table_to_decompressor_.emplace(config.table, std::move(decompressor));
+}
+
+FeatureStoreBatcher* FeatureStoreSingleton::getBatcher(
+    const FeatureStoreConfig& config) {
+  auto it = table_to_batcher_.find(config.table);
+  return it == table_to_batcher_.end() ? nullptr : it->second.get();
+}
+
+std::shared_ptr<const FeatureDecompressor>
+FeatureStoreSingleton::getDecompressor(const FeatureStoreConfig& config) {
+  auto it = table_to_decompressor_.find(config.table);
+  return it == table_to_decompressor_.end() ? nullptr : it->second;
+}
+
+std::unique_ptr<FeatureStoreClient> FeatureStoreSingleton::getClient(
+    const FeatureStoreConfig& config, const std::string& region,
+    uint64_t deadline_millis, size_t index) {
+  if (config.backend == redis_feature_store_backend) {
+    return getRedisClient(config, index);
+  }
+  if (auto* batcher = getBatcher(config)) {
+    return std::make_unique<BatchingFeatureStoreClient>(*batcher);
+  }
+  return std::make_unique<DynamoDBFeatureStoreClient>(
+      AwsSingleton::getInstance().getDynamoDBClient(region), deadline_millis,
+      trantor::EventLoop::getEventLoopOfCurrentThread());
+}
+
+std::unique_ptr<FeatureStoreClient> FeatureStoreSingleton::getRedisClient(
+    const FeatureStoreConfig& config, size_t index) {
+  return std::make_unique<RedisFeatureStoreClient>(
+      std::make_unique<SwRedisClient>(
+          url_to_clients_.at(config.redis_url).getClient(index)));
+}
+
+std::shared_ptr<RedisFeaturesCache> FeatureStoreSingleton::getL2Cache(
+    size_t index) {
+  if (l2_cache_url_.empty()) {
+    return nullptr;
+  }
+  return std::make_shared<RedisFeaturesCache>(std::make_unique<SwRedisClient>(
+      url_to_clients_.at(l2_cache_url_).getClient(index)));
+}
+}  // namespace delivery
@@ -0,0 +1,68 @@
+// This owns the Redis clients for feature stores which use the Redis backend
+// and for the features cache in Redis, the batchers for DynamoDB feature stores
+// which batch across requests, and the decompressors for compressed feature
+// stores.
+// This is a singleton because those are inherently global state.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "singletons/redis_client_array.h"
+#include "singletons/singleton.h"
+
+namespace delivery {
+class FeatureDecompressor;
+class FeatureStoreBatcher;
+class FeatureStoreClient;
+struct FeatureStoreConfig;
+class RedisFeaturesCache;
+}  // namespace delivery
+
+namespace delivery {
+class FeatureStoreSingleton : public Singleton<FeatureStoreSingleton> {
+ public:
+  // Returns a client for `config` on the current thread's event loop. DynamoDB
+  // reads of unprocessed keys are retried until `deadline_millis`.
+  std::unique_ptr<FeatureStoreClient> getClient(
+      const FeatureStoreConfig& config, const std::string& region,
+      uint64_t deadline_millis, size_t index);
+  // Returns a Redis-backed client for `config`, which must use the Redis
+  // backend.
+  std::unique_ptr<FeatureStoreClient> getRedisClient(
+      const FeatureStoreConfig& config, size_t index);
+  // Returns nullptr if `config` doesn't batch across requests.
+  FeatureStoreBatcher* getBatcher(const FeatureStoreConfig& config);
+  // Returns nullptr if `config` isn't compressed.
+  std::shared_ptr<const FeatureDecompressor> getDecompressor(
+      const FeatureStoreConfig& config);
+  // Returns nullptr if there's no features cache in Redis.
+  std::shared_ptr<RedisFeaturesCache> getL2Cache(size_t index);
+
+ private:
+  friend class Singleton;
+
+  FeatureStoreSingleton();
+  ~FeatureStoreSingleton();
+
+  // Feature stores sharing a URL share clients.
+  absl::flat_hash_map<std::string, RedisClientArray> url_to_clients_;
+  std::string l2_cache_url_;
+  absl::flat_hash_map<std::string, std::unique_ptr<FeatureStoreBatcher>>
+      table_to_batcher_;
+  absl::flat_hash_map<std::string, std::shared_ptr<const FeatureDecompressor>>
+      table_to_decompressor_;
+
+  // If there's an error, this aborts.
+  void createClients(const std::string& url, const std::string& timeout);
+  void createBatcher(const FeatureStoreConfig& config,
+                     const std::string& region,
+                     const std::string& feature_store_timeout);
+  void createDecompressor(const FeatureStoreConfig& config);
+};
+}  // namespace delivery
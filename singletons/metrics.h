@@ -0,0 +1,20 @@
+// This holds the process's metrics, which are exported on "/metrics".
+
+#pragma once
+
+#include "singletons/singleton.h"
+#include "utils/metrics.h"
+
+namespace delivery {
+class MetricsSingleton : public Singleton<MetricsSingleton> {
+ public:
+  MetricsRegistry& getRegistry() { return registry_; }
+
+ private:
+  friend class Singleton;
+
+  MetricsSingleton() = default;
+
+  MetricsRegistry registry_;
+};
+}  // namespace delivery
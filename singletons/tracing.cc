@@ -0,0 +1,11 @@
+#include "singletons/tracing.h"
+
+#include "config/platform_config.h"
+#include "singletons/config.h"
+
+namespace delivery {
+TracingSingleton::TracingSingleton()
+    : buffer_(ConfigSingleton::getInstance()
+                  .getPlatformConfig()
+                  .trace_buffer_size) {}
+}  // namespace delivery
@@ -0,0 +1,21 @@
+// This holds the latest sampled request traces, which are exported on
+// "/tracez".
+
+#pragma once
+
+#include "singletons/singleton.h"
+#include "utils/trace.h"
+
+namespace delivery {
+class TracingSingleton : public Singleton<TracingSingleton> {
+ public:
+  TraceBuffer& getBuffer() { return buffer_; }
+
+ private:
+  friend class Singleton;
+
+  TracingSingleton();
+
+  TraceBuffer buffer_;
+};
+}  // namespace delivery
@@ -0,0 +1,91 @@
+#include "utils/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace delivery {
+size_t Histogram::bucketIndex(uint64_t value) {
+  value = std::min(value, (uint64_t{1} << max_value_bits) - 1);
+  if (value < sub_buckets) {
+    return value;
+  }
+  // The position of the highest bit picks the power of two, and the bits
+  // below it pick the bucket within that.
+  const int exponent = 63 - __builtin_clzll(value);
+  const int shift = exponent - sub_bucket_bits;
+  return (exponent - sub_bucket_bits + 1) * sub_buckets +
+         ((value >> shift) & (sub_buckets - 1));
+}
+
+uint64_t Histogram::bucketMax(size_t index) {
+  if (index < sub_buckets) {
+    return index;
+  }
+  const int shift = static_cast<int>(index / sub_buckets) - 1;
+  const uint64_t min = (sub_buckets + index % sub_buckets) << shift;
+  return min + (uint64_t{1} << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+  buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::vector<uint64_t> Histogram::quantiles(
+    const std::vector<double>& qs) const {
+  std::vector<uint64_t> counts(num_buckets);
+  uint64_t total = 0;
+  for (size_t i = 0; i < num_buckets; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+
+  std::vector<uint64_t> ret;
+  ret.reserve(qs.size());
+  for (double q : qs) {
+    if (total == 0) {
+      ret.push_back(0);
+      continue;
+    }
+    // The rank of the value at the quantile, counting from 1.
+    const uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(total))));
+    uint64_t seen = 0;
+    size_t index = 0;
+    for (; index < num_buckets - 1; ++index) {
+      seen += counts[index];
+      if (seen >= rank) {
+        break;
+      }
+    }
+    ret.push_back(bucketMax(index));
+  }
+  return ret;
+}
+
+const std::vector<uint64_t>& Histogram::cumulativeBounds() {
+  static const std::vector<uint64_t> bounds = []() {
+    std::vector<uint64_t> ret;
+    for (int bits = sub_bucket_bits; bits <= max_value_bits; ++bits) {
+      ret.push_back((uint64_t{1} << bits) - 1);
+    }
+    return ret;
+  }();
+  return bounds;
+}
+
+std::vector<uint64_t> Histogram::cumulativeCounts() const {
+  const auto& bounds = cumulativeBounds();
+  std::vector<uint64_t> ret;
+  ret.reserve(bounds.size());
+  uint64_t seen = 0;
+  for (size_t i = 0; i < num_buckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (bucketMax(i) == bounds[ret.size()]) {
+      ret.push_back(seen);
+    }
+  }
+  return ret;
+}
+}  // namespace delivery
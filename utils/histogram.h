@@ -0,0 +1,55 @@
+// A histogram of non-negative values, such as latencies in micros, which any
+// number of threads can record to without locking. Like HDR histograms,
+// buckets are log-linear: values under 16 are counted exactly, and every power
+// of two above that is split into 16 buckets, so quantiles are within 1/16 of
+// the actual values.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+namespace delivery {
+class Histogram {
+ public:
+  Histogram() = default;
+
+  // Values of 2^40 and up are counted as 2^40 - 1.
+  void record(uint64_t value);
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+  // Returns the highest value in the bucket of each quantile in [0, 1], or 0
+  // if nothing was recorded. Records which race with this may be missed.
+  std::vector<uint64_t> quantiles(const std::vector<double>& qs) const;
+
+  // Returns the upper bounds, inclusive, of the cumulative buckets exported to
+  // Prometheus: 2^k - 1 at each power of two from 16 up. These fall exactly on
+  // bucket boundaries, and the last is the highest value counted.
+  static const std::vector<uint64_t>& cumulativeBounds();
+
+  // Returns how many values are at most each of cumulativeBounds(), so the
+  // last is the count of every bucket. Records which race with this may be
+  // missed.
+  std::vector<uint64_t> cumulativeCounts() const;
+
+ private:
+  static constexpr int sub_bucket_bits = 4;
+  static constexpr uint64_t sub_buckets = 1 << sub_bucket_bits;
+  static constexpr int max_value_bits = 40;
+  static constexpr size_t num_buckets =
+      (max_value_bits - sub_bucket_bits + 1) * sub_buckets;
+
+  static size_t bucketIndex(uint64_t value);
+  // Returns the highest value counted in the bucket.
+  static uint64_t bucketMax(size_t index);
+
+  std::atomic<uint64_t> buckets_[num_buckets]{};
+  std::atomic<uint64_t> count_ = 0;
+  std::atomic<uint64_t> sum_ = 0;
+};
+}  // namespace delivery
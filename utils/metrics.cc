@@ -0,0 +1,105 @@
+#include "utils/metrics.h"
+
+#include "absl/strings/str_cat.h"
+
+namespace delivery {
+namespace {
+void appendEscaped(std::string& out, std::string_view value) {
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out += c;
+    }
+  }
+}
+
+// Appends `name{labels}`, with `extra` as a last label if it's set.
+void appendSeries(std::string& out, std::string_view name,
+                  std::string_view labels, std::string_view extra = "") {
+  out += name;
+  if (labels.empty() && extra.empty()) {
+    return;
+  }
+  out += '{';
+  out += labels;
+  if (!labels.empty() && !extra.empty()) {
+    out += ',';
+  }
+  out += extra;
+  out += '}';
+}
+}  // namespace
+
+std::string renderMetricLabels(const MetricLabels& labels) {
+  std::string ret;
+  for (const auto& [name, value] : labels) {
+    if (!ret.empty()) {
+      ret += ',';
+    }
+    absl::StrAppend(&ret, name, "=\"");
+    appendEscaped(ret, value);
+    ret += '"';
+  }
+  return ret;
+}
+
+Histogram& MetricsRegistry::histogram(std::string_view name,
+                                      const MetricLabels& labels) {
+  std::string rendered_labels = renderMetricLabels(labels);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& histogram = histograms_[std::string(name)][std::move(rendered_labels)];
+  if (histogram == nullptr) {
+    histogram = std::make_unique<Histogram>();
+  }
+  return *histogram;
+}
+
+void MetricsRegistry::write(std::string& out) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& [name, series] : histograms_) {
+    absl::StrAppend(&out, "# TYPE ", name, " histogram\n");
+    const std::string bucket_name = absl::StrCat(name, "_bucket");
+    for (const auto& [labels, histogram] : series) {
+      const auto& bounds = Histogram::cumulativeBounds();
+      auto counts = histogram->cumulativeCounts();
+      for (size_t i = 0; i < bounds.size(); ++i) {
+        appendSeries(out, bucket_name, labels,
+                     absl::StrCat("le=\"", bounds[i], "\""));
+        absl::StrAppend(&out, " ", counts[i], "\n");
+      }
+      // Every value is at most the last bound. Its count is used for the
+      // total, rather than count(), so that the buckets stay consistent.
+      const uint64_t total = counts.back();
+      appendSeries(out, bucket_name, labels, "le=\"+Inf\"");
+      absl::StrAppend(&out, " ", total, "\n");
+      appendSeries(out, absl::StrCat(name, "_sum"), labels);
+      absl::StrAppend(&out, " ", histogram->sum(), "\n");
+      appendSeries(out, absl::StrCat(name, "_count"), labels);
+      absl::StrAppend(&out, " ", total, "\n");
+    }
+  }
+}
+
+LabeledHistograms::LabeledHistograms(MetricsRegistry& metrics,
+                                     std::string name, std::string label)
+    : metrics_(metrics), name_(std::move(name)), label_(std::move(label)) {}
+
+Histogram& LabeledHistograms::get(std::string_view value) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = histograms_.find(value);
+    if (it != histograms_.end()) {
+      return *it->second;
+    }
+  }
+  Histogram& histogram =
+      metrics_.histogram(name_, {{label_, std::string(value)}});
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  histograms_.try_emplace(value, &histogram);
+  return histogram;
+}
+}  // namespace delivery
@@ -0,0 +1,68 @@
+// A registry of histograms, which are exported in the Prometheus text format.
+// For example, a stage duration histogram with `{{"stage", "Init"}}` as its
+// labels is written out as:
+//   # TYPE delivery_stage_duration_micros histogram
+//   delivery_stage_duration_micros_bucket{stage="Init",le="15"} 0
+//   delivery_stage_duration_micros_bucket{stage="Init",le="31"} 22
+//   ...
+//   delivery_stage_duration_micros_bucket{stage="Init",le="+Inf"} 40
+//   delivery_stage_duration_micros_sum{stage="Init"} 1402
+//   delivery_stage_duration_micros_count{stage="Init"} 40
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "utils/histogram.h"
+
+namespace delivery {
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+class MetricsRegistry {
+ public:
+  // Returns the histogram of the series, creating it if needed. Histograms are
+  // never removed, so the reference can be kept. This renders the labels and
+  // locks, so look histograms up once rather than on every request.
+  Histogram& histogram(std::string_view name, const MetricLabels& labels = {});
+
+  // Appends every histogram as cumulative buckets, a sum and a count.
+  void write(std::string& out) const;
+
+ private:
+  mutable std::mutex mutex_;
+  // Keyed by name, then by rendered labels.
+  std::map<std::string, std::map<std::string, std::unique_ptr<Histogram>>>
+      histograms_;
+};
+
+// The histograms of one metric by the value of a single label, such as the
+// stage. Each value's histogram is looked up in the registry once, so request
+// paths only pay for a hash lookup.
+class LabeledHistograms {
+ public:
+  LabeledHistograms(MetricsRegistry& metrics, std::string name,
+                    std::string label);
+
+  Histogram& get(std::string_view value);
+
+ private:
+  MetricsRegistry& metrics_;
+  const std::string name_;
+  const std::string label_;
+  std::shared_mutex mutex_;
+  absl::flat_hash_map<std::string, Histogram*> histograms_;
+};
+
+// Renders labels like `stage="Init"`, escaped as Prometheus requires.
+std::string renderMetricLabels(const MetricLabels& labels);
+}  // namespace delivery
@@ -0,0 +1,48 @@
+#include "utils/sharded_counters.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace delivery {
+namespace {
+// Threads are assigned shards in the order they first add to any counters, so
+// up to `num_shards` of them never share one.
+size_t currentThreadIndex() {
+  static std::atomic<size_t> next_index = 0;
+  thread_local const size_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+}  // namespace
+
+ShardedCounters::ShardedCounters(size_t num_counters, size_t num_shards)
+    : num_counters_(num_counters),
+      num_shards_(num_shards > 0
+                      ? num_shards
+                      : std::max<size_t>(std::thread::hardware_concurrency(),
+                                         1)),
+      lines_per_shard_((num_counters + counters_per_line - 1) /
+                       counters_per_line),
+      lines_(num_shards_ * lines_per_shard_) {}
+
+void ShardedCounters::add(size_t counter, int64_t value) {
+  const size_t shard = currentThreadIndex() % num_shards_;
+  Line& line = lines_[shard * lines_per_shard_ + counter / counters_per_line];
+  line.counts[counter % counters_per_line].fetch_add(
+      value, std::memory_order_relaxed);
+}
+
+std::vector<int64_t> ShardedCounters::collect() {
+  std::vector<int64_t> ret(num_counters_);
+  for (size_t shard = 0; shard < num_shards_; ++shard) {
+    for (size_t counter = 0; counter < num_counters_; ++counter) {
+      Line& line =
+          lines_[shard * lines_per_shard_ + counter / counters_per_line];
+      // Adds which race with this are collected next time.
+      ret[counter] += line.counts[counter % counters_per_line].exchange(
+          0, std::memory_order_relaxed);
+    }
+  }
+  return ret;
+}
+}  // namespace delivery
@@ -0,0 +1,41 @@
+// Counters which many threads add to without contending with each other. Each
+// thread adds to its own shard, and a single reader collects the totals
+// across shards.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+namespace delivery {
+class ShardedCounters {
+ public:
+  // By default, there's a shard per hardware thread.
+  explicit ShardedCounters(size_t num_counters, size_t num_shards = 0);
+
+  void add(size_t counter, int64_t value);
+
+  // Returns the totals added to each counter since the last collect().
+  std::vector<int64_t> collect();
+
+  size_t size() const { return num_counters_; }
+
+ private:
+  static constexpr size_t cache_line_bytes = 64;
+  static constexpr size_t counters_per_line =
+      cache_line_bytes / sizeof(std::atomic<int64_t>);
+
+  // Shards never share cache lines.
+  struct alignas(cache_line_bytes) Line {
+    std::atomic<int64_t> counts[counters_per_line]{};
+  };
+
+  size_t num_counters_;
+  size_t num_shards_;
+  size_t lines_per_shard_;
+  std::vector<Line> lines_;
+};
+}  // namespace delivery
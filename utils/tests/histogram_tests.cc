@@ -0,0 +1,92 @@
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "utils/histogram.h"
+
+namespace delivery {
+TEST(HistogramTest, Empty) {
+  Histogram histogram;
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.sum(), 0);
+  EXPECT_THAT(histogram.quantiles({0.5, 0.99}), testing::ElementsAre(0, 0));
+}
+
+TEST(HistogramTest, SmallValuesAreExact) {
+  Histogram histogram;
+  for (uint64_t i = 0; i < 16; ++i) {
+    histogram.record(i);
+  }
+  EXPECT_EQ(histogram.count(), 16);
+  EXPECT_EQ(histogram.sum(), 120);
+  EXPECT_THAT(histogram.quantiles({0, 0.5, 1}), testing::ElementsAre(0, 7, 15));
+}
+
+TEST(HistogramTest, Quantiles) {
+  Histogram histogram;
+  for (uint64_t i = 1; i <= 10'000; ++i) {
+    histogram.record(i);
+  }
+  auto quantiles = histogram.quantiles({0.5, 0.9, 0.99, 1});
+  ASSERT_EQ(quantiles.size(), 4);
+  // Values are at most a bucket width of 1/16 over.
+  EXPECT_GE(quantiles[0], 5'000);
+  EXPECT_LE(quantiles[0], 5'000 * 17 / 16);
+  EXPECT_GE(quantiles[1], 9'000);
+  EXPECT_LE(quantiles[1], 9'000 * 17 / 16);
+  EXPECT_GE(quantiles[2], 9'900);
+  EXPECT_LE(quantiles[2], 9'900 * 17 / 16);
+  EXPECT_GE(quantiles[3], 10'000);
+  EXPECT_LE(quantiles[3], 10'000 * 17 / 16);
+}
+
+TEST(HistogramTest, LargeValues) {
+  Histogram histogram;
+  histogram.record(uint64_t{1} << 50);
+  EXPECT_THAT(histogram.quantiles({1}),
+              testing::ElementsAre((uint64_t{1} << 40) - 1));
+}
+
+TEST(HistogramTest, CumulativeCounts) {
+  EXPECT_THAT(Histogram::cumulativeBounds(),
+              testing::AllOf(testing::SizeIs(37), testing::Contains(15),
+                             testing::Contains(31),
+                             testing::Contains((uint64_t{1} << 40) - 1)));
+  Histogram histogram;
+  EXPECT_THAT(histogram.cumulativeCounts(),
+              testing::AllOf(testing::SizeIs(37), testing::Each(0)));
+
+  histogram.record(15);
+  histogram.record(16);
+  histogram.record(31);
+  histogram.record(uint64_t{1} << 50);
+  auto counts = histogram.cumulativeCounts();
+  ASSERT_EQ(counts.size(), 37);
+  // Bounds are inclusive, and values over the last are counted under it.
+  EXPECT_EQ(counts[0], 1);
+  EXPECT_EQ(counts[1], 3);
+  EXPECT_EQ(counts[35], 3);
+  EXPECT_EQ(counts[36], 4);
+}
+
+TEST(HistogramTest, ConcurrentRecords) {
+  Histogram histogram;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&histogram]() {
+      for (int j = 0; j < 10'000; ++j) {
+        histogram.record(3);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(histogram.count(), 80'000);
+  EXPECT_EQ(histogram.sum(), 240'000);
+  EXPECT_THAT(histogram.quantiles({0.5}), testing::ElementsAre(3));
+}
+}  // namespace delivery
@@ -0,0 +1,67 @@
+#include <stdint.h>
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "utils/histogram.h"
+#include "utils/metrics.h"
+
+namespace delivery {
+TEST(MetricsTest, Histogram) {
+  MetricsRegistry registry;
+  Histogram& histogram = registry.histogram("latency", {{"stage", "A"}});
+  EXPECT_EQ(&registry.histogram("latency", {{"stage", "A"}}), &histogram);
+  EXPECT_NE(&registry.histogram("latency", {{"stage", "B"}}), &histogram);
+  EXPECT_NE(&registry.histogram("latency"), &histogram);
+
+  // Series of other registries are distinct.
+  MetricsRegistry other_registry;
+  EXPECT_NE(&other_registry.histogram("latency", {{"stage", "A"}}),
+            &histogram);
+}
+
+TEST(MetricsTest, Write) {
+  MetricsRegistry registry;
+  registry.histogram("latency", {{"stage", "A"}}).record(3);
+  registry.histogram("latency", {{"stage", "A"}}).record(20);
+  registry.histogram("size").record(7);
+
+  std::string out;
+  registry.write(out);
+  // Buckets are cumulative, with one at each power of two.
+  std::string expected = "# TYPE latency histogram\n";
+  for (uint64_t bound : Histogram::cumulativeBounds()) {
+    absl::StrAppend(&expected, "latency_bucket{stage=\"A\",le=\"", bound,
+                    "\"} ", bound < 20 ? 1 : 2, "\n");
+  }
+  absl::StrAppend(&expected,
+                  "latency_bucket{stage=\"A\",le=\"+Inf\"} 2\n"
+                  "latency_sum{stage=\"A\"} 23\n"
+                  "latency_count{stage=\"A\"} 2\n"
+                  "# TYPE size histogram\n");
+  for (uint64_t bound : Histogram::cumulativeBounds()) {
+    absl::StrAppend(&expected, "size_bucket{le=\"", bound, "\"} 1\n");
+  }
+  absl::StrAppend(&expected,
+                  "size_bucket{le=\"+Inf\"} 1\n"
+                  "size_sum 7\n"
+                  "size_count 1\n");
+  EXPECT_EQ(out, expected);
+}
+
+TEST(MetricsTest, LabeledHistograms) {
+  MetricsRegistry registry;
+  LabeledHistograms histograms(registry, "latency", "stage");
+  Histogram& histogram = histograms.get("A");
+  EXPECT_EQ(&histograms.get("A"), &histogram);
+  EXPECT_EQ(&registry.histogram("latency", {{"stage", "A"}}), &histogram);
+  EXPECT_NE(&histograms.get("B"), &histogram);
+}
+
+TEST(MetricsTest, RenderMetricLabels) {
+  EXPECT_EQ(renderMetricLabels({}), "");
+  EXPECT_EQ(renderMetricLabels({{"a", "b"}, {"c", "\"d\\\n"}}),
+            R"(a="b",c="\"d\\\n")");
+}
+}  // namespace delivery
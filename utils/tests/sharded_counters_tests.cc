@@ -0,0 +1,39 @@
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "utils/sharded_counters.h"
+
+namespace delivery {
+TEST(ShardedCountersTest, Collect) {
+  ShardedCounters counters(10, 2);
+  EXPECT_EQ(counters.size(), 10);
+  counters.add(0, 1);
+  counters.add(9, 2);
+  counters.add(9, 3);
+  EXPECT_THAT(counters.collect(),
+              testing::ElementsAre(1, 0, 0, 0, 0, 0, 0, 0, 0, 5));
+  // Collecting resets the counters.
+  EXPECT_THAT(counters.collect(), testing::Each(0));
+}
+
+TEST(ShardedCountersTest, ConcurrentAdds) {
+  ShardedCounters counters(2, 3);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&counters]() {
+      for (int j = 0; j < 10'000; ++j) {
+        counters.add(0, 1);
+        counters.add(1, 2);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(counters.collect(), testing::ElementsAre(80'000, 160'000));
+}
+}  // namespace delivery
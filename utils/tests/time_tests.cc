@@ -22,9 +22,10 @@ TEST(TimeTest, MillisForDuration) {
   EXPECT_LT(ms, 1669529611000);
 }
 
-TEST(TimeTest, MakeTimedKey) {
-  EXPECT_EQ(makeTimedKey("base", 0),
-            makeTimedKey("base", millis_in_15_min - 1));
-  EXPECT_NE(makeTimedKey("base", 0), makeTimedKey("base", millis_in_15_min));
+TEST(TimeTest, MicrosForDuration) {
+  uint64_t ms = millisForDuration();
+  uint64_t us = microsForDuration();
+  EXPECT_GE(us / 1'000, ms);
+  EXPECT_LT(us / 1'000, ms + 1'000);
 }
 }  // namespace delivery
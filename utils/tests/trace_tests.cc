@@ -0,0 +1,50 @@
+#include <json/value.h>
+
+#include <memory>
+#include <thread>
+
+#include "utils/trace.h"
+#include "gtest/gtest.h"
+
+namespace delivery {
+TEST(TraceTest, SampleTrace) {
+  EXPECT_FALSE(sampleTrace(0));
+  EXPECT_TRUE(sampleTrace(1));
+}
+
+TEST(TraceTest, ChromeTrace) {
+  auto trace = std::make_shared<Trace>("request");
+  trace->addSpan("Init", "run", 10, 15);
+  std::thread thread([&trace]() {
+    trace->addSpan("FeatureStore", "backend", 20, 50, {{"table", "items"}});
+  });
+  thread.join();
+  trace->setName("a");
+
+  TraceBuffer buffer(1);
+  buffer.add(std::make_shared<Trace>("dropped"));
+  buffer.add(trace);
+  Json::Value chrome_trace = buffer.toChromeTrace();
+
+  const Json::Value& events = chrome_trace["traceEvents"];
+  ASSERT_EQ(events.size(), 3);
+  EXPECT_EQ(events[0]["ph"], "M");
+  EXPECT_EQ(events[0]["pid"].asUInt64(), 1);
+  EXPECT_EQ(events[0]["args"]["name"], "a");
+
+  EXPECT_EQ(events[1]["name"], "Init");
+  EXPECT_EQ(events[1]["cat"], "run");
+  EXPECT_EQ(events[1]["ph"], "X");
+  EXPECT_EQ(events[1]["ts"].asUInt64(), 10);
+  EXPECT_EQ(events[1]["dur"].asUInt64(), 5);
+  EXPECT_EQ(events[1]["pid"].asUInt64(), 1);
+  EXPECT_FALSE(events[1].isMember("args"));
+
+  EXPECT_EQ(events[2]["name"], "FeatureStore");
+  EXPECT_EQ(events[2]["ts"].asUInt64(), 20);
+  EXPECT_EQ(events[2]["dur"].asUInt64(), 30);
+  EXPECT_EQ(events[2]["args"]["table"], "items");
+  // Spans are attributed to the threads which recorded them.
+  EXPECT_NE(events[2]["tid"], events[1]["tid"]);
+}
+}  // namespace delivery
@@ -3,8 +3,6 @@
 #include <chrono>
 #include <type_traits>
 
-#include "absl/strings/str_cat.h"
-
 namespace delivery {
 uint64_t millisSinceEpoch() {
   return std::chrono::time_point_cast<std::chrono::milliseconds>(
@@ -20,7 +18,10 @@ uint64_t millisForDuration() {
       .count();
 }
 
-std::string makeTimedKey(std::string_view key, uint64_t millis) {
-  return absl::StrCat(key, millis / millis_in_15_min);
+uint64_t microsForDuration() {
+  return std::chrono::time_point_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now())
+      .time_since_epoch()
+      .count();
 }
 }  // namespace delivery
@@ -6,14 +6,11 @@
 
 #include <stdint.h>
 
-#include <string>
-#include <string_view>
-
 namespace delivery {
 const int millis_in_15_min = 1'000 * 60 * 15;
 
 uint64_t millisSinceEpoch();
 uint64_t millisForDuration();
-
-std::string makeTimedKey(std::string_view key, uint64_t millis);
+// For durations too short to measure in millis.
+uint64_t microsForDuration();
 }  // namespace delivery
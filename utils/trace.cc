@@ -0,0 +1,101 @@
+#include "utils/trace.h"
+
+#include <json/value.h>
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+
+namespace delivery {
+namespace {
+// Threads are numbered in the order they first record a span, which reads
+// better in trace viewers than their system IDs.
+uint64_t currentThreadId() {
+  static std::atomic<uint64_t> next_id = 1;
+  thread_local const uint64_t id =
+      next_id.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+}  // namespace
+
+bool sampleTrace(double sample_rate) {
+  if (sample_rate <= 0) {
+    return false;
+  }
+  thread_local std::minstd_rand engine(std::random_device{}());
+  return std::uniform_real_distribution<double>(0, 1)(engine) < sample_rate;
+}
+
+void Trace::setName(std::string name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  name_ = std::move(name);
+}
+
+void Trace::addSpan(std::string name, std::string category,
+                    uint64_t start_micros, uint64_t end_micros, Args args) {
+  Span span{.name = std::move(name),
+            .category = std::move(category),
+            .start_micros = start_micros,
+            .end_micros = std::max(start_micros, end_micros),
+            .thread_id = currentThreadId(),
+            .args = std::move(args)};
+  std::lock_guard<std::mutex> lock(mutex_);
+  spans_.emplace_back(std::move(span));
+}
+
+void Trace::appendEvents(Json::Value& events, uint64_t pid) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Json::Value process_name(Json::objectValue);
+  process_name["name"] = "process_name";
+  process_name["ph"] = "M";
+  process_name["pid"] = static_cast<Json::UInt64>(pid);
+  process_name["args"]["name"] = name_;
+  events.append(std::move(process_name));
+
+  for (const auto& span : spans_) {
+    Json::Value event(Json::objectValue);
+    event["name"] = span.name;
+    event["cat"] = span.category;
+    // Complete events have both their start and duration.
+    event["ph"] = "X";
+    event["ts"] = static_cast<Json::UInt64>(span.start_micros);
+    event["dur"] = static_cast<Json::UInt64>(span.end_micros -
+                                             span.start_micros);
+    event["pid"] = static_cast<Json::UInt64>(pid);
+    event["tid"] = static_cast<Json::UInt64>(span.thread_id);
+    if (!span.args.empty()) {
+      Json::Value args(Json::objectValue);
+      for (const auto& [key, value] : span.args) {
+        args[key] = value;
+      }
+      event["args"] = std::move(args);
+    }
+    events.append(std::move(event));
+  }
+}
+
+void TraceBuffer::add(std::shared_ptr<const Trace> trace) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  traces_.emplace_back(std::move(trace));
+  while (traces_.size() > max_traces_) {
+    traces_.pop_front();
+  }
+}
+
+Json::Value TraceBuffer::toChromeTrace() const {
+  std::deque<std::shared_ptr<const Trace>> traces;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    traces = traces_;
+  }
+  Json::Value events(Json::arrayValue);
+  uint64_t pid = 1;
+  for (const auto& trace : traces) {
+    trace->appendEvents(events, pid++);
+  }
+  Json::Value ret(Json::objectValue);
+  ret["traceEvents"] = std::move(events);
+  ret["displayTimeUnit"] = "ms";
+  return ret;
+}
+}  // namespace delivery
@@ -0,0 +1,80 @@
+// A timeline of a sampled request's execution, exported in the Chrome trace
+// event format, which chrome://tracing and Perfetto open. Spans are recorded
+// from whichever threads run the request, and are tagged with those threads.
+//
+// Executors record per-stage spans in these categories:
+// - "queue": Waiting on the event loop to start running
+// - "run": Running synchronously on the event loop
+// - "async": Waiting on asynchronous work, like backend calls
+// Backend clients add "backend" spans for each call.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Json {
+class Value;
+}
+
+namespace delivery {
+// Returns true for about `sample_rate` [0, 1] of calls.
+bool sampleTrace(double sample_rate);
+
+class Trace {
+ public:
+  using Args = std::vector<std::pair<std::string, std::string>>;
+
+  explicit Trace(std::string name) : name_(std::move(name)) {}
+
+  // Such as once the request is assigned its ID.
+  void setName(std::string name);
+
+  // Times are in micros, as from microsForDuration(). The span is attributed
+  // to the calling thread.
+  void addSpan(std::string name, std::string category, uint64_t start_micros,
+               uint64_t end_micros, Args args = {});
+
+  // Appends a trace event for each span, and one naming the process `pid`
+  // after this trace.
+  void appendEvents(Json::Value& events, uint64_t pid) const;
+
+ private:
+  struct Span {
+    std::string name;
+    std::string category;
+    uint64_t start_micros = 0;
+    uint64_t end_micros = 0;
+    uint64_t thread_id = 0;
+    Args args;
+  };
+
+  mutable std::mutex mutex_;
+  std::string name_;
+  std::vector<Span> spans_;
+};
+
+// Keeps the last traces which were added, including those still being
+// recorded.
+class TraceBuffer {
+ public:
+  explicit TraceBuffer(size_t max_traces) : max_traces_(max_traces) {}
+
+  void add(std::shared_ptr<const Trace> trace);
+
+  // Returns a Chrome trace JSON object with a process per trace.
+  Json::Value toChromeTrace() const;
+
+ private:
+  size_t max_traces_;
+  mutable std::mutex mutex_;
+  std::deque<std::shared_ptr<const Trace>> traces_;
+};
+}  // namespace delivery